@@ -0,0 +1,10 @@
+-- Runs the physics benchmarks. Boot with "--boot-dir benchmark" to step
+-- the physics on a single thread or with "--boot-dir benchmark/threaded" to
+-- use multiple threads.
+
+require "core/lua/benchmark"
+require "benchmark/sleeping"
+require "benchmark/stack"
+require "benchmark/statics"
+
+Benchmark.run()
@@ -0,0 +1,53 @@
+-- Measures the time taken by World.update() with 20k bodies resting on the
+-- ground, most of which are asleep.
+
+require "core/lua/benchmark"
+
+local NUM_BODIES = 20000
+local ROW_SIZE = 150
+
+local world = nil
+local pw = nil
+local actors = {}
+
+local function setup()
+	world = Device.create_world()
+	pw = World.physics_world(world)
+
+	World.spawn_unit(world, "plane")
+
+	-- Recycle the temporary vectors, there are not enough for all the bodies.
+	local nv, nq, nm = Device.temp_count()
+	for i = 0, NUM_BODIES - 1 do
+		local x = (i % ROW_SIZE - ROW_SIZE/2) * 2.5
+		local z = (math.floor(i / ROW_SIZE) - NUM_BODIES/ROW_SIZE/2) * 2.5
+		local unit = World.spawn_unit(world, "cube", Vector3(x, 1, z))
+		actors[i + 1] = PhysicsWorld.actor_instances(pw, unit)
+		Device.set_temp_count(nv, nq, nm)
+	end
+end
+
+local function teardown(times)
+	Device.destroy_world(world)
+	world = nil
+	actors = {}
+end
+
+-- Returns a function that keeps @a num bodies awake.
+local function keep_awake(num)
+	return function(frame)
+		for i = 1, num do
+			PhysicsWorld.actor_wake_up(pw, actors[i])
+		end
+	end
+end
+
+local function update(dt)
+	World.update(world, dt)
+end
+
+-- Bodies fall asleep after resting for 2 seconds, warm up for longer.
+Benchmark.add({
+	{ name = "20k bodies, 5% awake",   setup = setup, prepare = keep_awake(NUM_BODIES/20), update = update, teardown = teardown, warmup = 180 },
+	{ name = "20k bodies, all awake",  setup = setup, prepare = keep_awake(NUM_BODIES),    update = update, teardown = teardown, warmup = 180 },
+})
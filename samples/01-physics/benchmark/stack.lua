@@ -0,0 +1,99 @@
+-- Measures the time taken by World.update() with 10k bodies stacked in
+-- columns, on a single thread and then on all the physics threads. Boot
+-- with "--boot-dir benchmark/threaded" to get more than one.
+--
+-- The bodies must end up in exactly the same positions in both runs,
+-- whatever the number of threads.
+
+require "core/lua/benchmark"
+
+local NUM_COLUMNS = 20 -- Along each axis.
+local COLUMN_HEIGHT = 25
+local NUM_THREADS = Device.physics_threads()
+
+local world = nil
+local pw = nil
+local actors = {}
+local positions = nil
+
+local function spawn()
+	world = Device.create_world()
+	pw = World.physics_world(world)
+
+	World.spawn_unit(world, "plane")
+
+	-- Recycle the temporary vectors, there are not enough for all the bodies.
+	local nv, nq, nm = Device.temp_count()
+	for i = 0, NUM_COLUMNS*NUM_COLUMNS - 1 do
+		local x = (i % NUM_COLUMNS - NUM_COLUMNS/2) * 3
+		local z = (math.floor(i / NUM_COLUMNS) - NUM_COLUMNS/2) * 3
+		for j = 0, COLUMN_HEIGHT - 1 do
+			local unit = World.spawn_unit(world, "cube", Vector3(x, 1 + j*2, z))
+			actors[#actors + 1] = PhysicsWorld.actor_instances(pw, unit)
+			Device.set_temp_count(nv, nq, nm)
+		end
+	end
+end
+
+-- Returns a function that spawns the bodies and steps them on
+-- @a num_threads threads.
+local function setup(num_threads)
+	return function()
+		Device.set_physics_threads(num_threads)
+		spawn()
+	end
+end
+
+-- Returns the positions of all the bodies, 3 numbers per body.
+local function actor_positions()
+	local pos = {}
+	local nv, nq, nm = Device.temp_count()
+	for i = 1, #actors do
+		local p = PhysicsWorld.actor_world_position(pw, actors[i])
+		pos[#pos + 1] = p.x
+		pos[#pos + 1] = p.y
+		pos[#pos + 1] = p.z
+		Device.set_temp_count(nv, nq, nm)
+	end
+	return pos
+end
+
+local function destroy()
+	Device.destroy_world(world)
+	world = nil
+	actors = {}
+end
+
+local function update(dt)
+	World.update(world, dt)
+end
+
+Benchmark.add({
+	{
+		name = "10k-body stack, 1 thread",
+		setup = setup(1),
+		update = update,
+		teardown = function(times)
+			positions = actor_positions()
+			destroy()
+		end
+	},
+	{
+		name = string.format("10k-body stack, %d threads", NUM_THREADS),
+		setup = setup(NUM_THREADS),
+		update = update,
+		teardown = function(times)
+			local again = actor_positions()
+			destroy()
+
+			local mismatches = 0
+			for i = 1, #positions, 3 do
+				if positions[i] ~= again[i] or positions[i+1] ~= again[i+1] or positions[i+2] ~= again[i+2] then
+					mismatches = mismatches + 1
+				end
+			end
+			assert(mismatches == 0, string.format("benchmark: 10k-body stack differs with %d threads, %d bodies differ", NUM_THREADS, mismatches))
+			print(string.format("benchmark: 10k-body stack is the same with 1 and %d threads", NUM_THREADS))
+		end
+	},
+})
@@ -0,0 +1,62 @@
+-- Measures the time taken by World.update() with 1k awake bodies and an
+-- increasing number of static bodies, which should not add to the cost of
+-- the step.
+
+require "core/lua/benchmark"
+
+local NUM_BODIES = 1000
+local ROW_SIZE = 32
+
+local world = nil
+local pw = nil
+local actors = {}
+
+-- Returns a function that spawns the bodies on the ground and @a num_statics
+-- static bodies under it, out of their reach.
+local function setup(num_statics)
+	return function()
+		world = Device.create_world()
+		pw = World.physics_world(world)
+
+		World.spawn_unit(world, "plane")
+
+		-- Recycle the temporary vectors, there are not enough for all the bodies.
+		local nv, nq, nm = Device.temp_count()
+		for i = 0, NUM_BODIES - 1 do
+			local x = (i % ROW_SIZE - ROW_SIZE/2) * 2.5
+			local z = (math.floor(i / ROW_SIZE) - NUM_BODIES/ROW_SIZE/2) * 2.5
+			local unit = World.spawn_unit(world, "cube", Vector3(x, 1, z))
+			actors[i + 1] = PhysicsWorld.actor_instances(pw, unit)
+			Device.set_temp_count(nv, nq, nm)
+		end
+
+		for i = 0, num_statics - 1 do
+			local x = (i % 200 - 100) * 2.5
+			local z = (math.floor(i / 200) - 100) * 2.5
+			World.spawn_unit(world, "benchmark/static_cube", Vector3(x, -5, z))
+			Device.set_temp_count(nv, nq, nm)
+		end
+	end
+end
+
+local function teardown(times)
+	Device.destroy_world(world)
+	world = nil
+	actors = {}
+end
+
+local function prepare(frame)
+	for i = 1, NUM_BODIES do
+		PhysicsWorld.actor_wake_up(pw, actors[i])
+	end
+end
+
+local function update(dt)
+	World.update(world, dt)
+end
+
+Benchmark.add({
+	{ name = "1k bodies, no statics",  setup = setup(0),     prepare = prepare, update = update, teardown = teardown },
+	{ name = "1k bodies, 10k statics", setup = setup(10000), prepare = prepare, update = update, teardown = teardown },
+	{ name = "1k bodies, 40k statics", setup = setup(40000), prepare = prepare, update = update, teardown = teardown },
+})
@@ -0,0 +1,65 @@
+-- Measures the time taken by World.update_animations() to evaluate common
+-- blend expressions for 10k sprites whose variables change every frame.
+-- See blend.state_machine for the expressions of each state.
+
+require "core/lua/benchmark"
+
+local NUM_SPRITES = 10000
+
+local world = nil
+local sm = nil
+local units = {}
+local x = nil
+local y = nil
+local speed = nil
+
+-- Returns a function that spawns the sprites and sends each of them to one
+-- of the @a states in turn.
+local function setup(states)
+	return function()
+		world = Device.create_world()
+		sm = World.animation_state_machine(world)
+
+		-- Recycle the temporary vectors, there are not enough for all the sprites.
+		local nv, nq, nm = Device.temp_count()
+		for i = 1, NUM_SPRITES do
+			units[i] = World.spawn_unit(world, "benchmark/blend", Vector3(i % 100, 0, math.floor(i / 100)))
+			AnimationStateMachine.trigger(sm, units[i], states[i % #states + 1])
+			Device.set_temp_count(nv, nq, nm)
+		end
+
+		x     = AnimationStateMachine.variable_id(sm, units[1], "x")
+		y     = AnimationStateMachine.variable_id(sm, units[1], "y")
+		speed = AnimationStateMachine.variable_id(sm, units[1], "speed")
+	end
+end
+
+local function teardown(times)
+	Device.destroy_world(world)
+	world = nil
+	units = {}
+end
+
+local function prepare(frame)
+	-- Consume the events of the previous update.
+	World.update_scene(world, Benchmark.DT)
+
+	local t = frame * Benchmark.DT
+	for i = 1, NUM_SPRITES do
+		local a = t + i * 0.01
+		AnimationStateMachine.set_variable(sm, units[i], x, math.cos(a))
+		AnimationStateMachine.set_variable(sm, units[i], y, math.sin(a))
+		AnimationStateMachine.set_variable(sm, units[i], speed, 1 + 0.5*math.sin(a))
+	end
+end
+
+local function update(dt)
+	World.update_animations(world, dt)
+end
+
+Benchmark.add({
+	{ name = "10k sprites, match()",      setup = setup({ "match" }),                             prepare = prepare, update = update, teardown = teardown },
+	{ name = "10k sprites, match_2d()",   setup = setup({ "match_2d" }),                          prepare = prepare, update = update, teardown = teardown },
+	{ name = "10k sprites, arithmetic",   setup = setup({ "arithmetic" }),                        prepare = prepare, update = update, teardown = teardown },
+	{ name = "10k sprites, mixed states", setup = setup({ "match", "match_2d", "arithmetic" }),   prepare = prepare, update = update, teardown = teardown },
+})
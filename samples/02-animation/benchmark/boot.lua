@@ -0,0 +1,9 @@
+-- Runs the animation benchmarks. Boot with "--boot-dir benchmark" to
+-- evaluate the state machines on a single thread or with
+-- "--boot-dir benchmark/threaded" to use multiple threads.
+
+require "core/lua/benchmark"
+require "benchmark/sprites"
+require "benchmark/blend"
+
+Benchmark.run()
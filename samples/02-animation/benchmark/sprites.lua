@@ -0,0 +1,61 @@
+-- Measures the time taken by World.update_animations() with 10k animated
+-- sprites.
+
+require "core/lua/benchmark"
+
+local NUM_SPRITES = 10000
+
+local world = nil
+local sm = nil
+local units = {}
+local speed_x = nil
+local speed_y = nil
+
+local function setup()
+	world = Device.create_world()
+	sm = World.animation_state_machine(world)
+
+	-- Recycle the temporary vectors, there are not enough for all the sprites.
+	local nv, nq, nm = Device.temp_count()
+	for i = 1, NUM_SPRITES do
+		local pos = Vector3(i % 100, 0, math.floor(i / 100))
+		units[i] = World.spawn_unit(world, i % 2 == 0 and "units/soldier" or "units/princess", pos)
+		AnimationStateMachine.trigger(sm, units[i], "run")
+		Device.set_temp_count(nv, nq, nm)
+	end
+
+	speed_x = AnimationStateMachine.variable_id(sm, units[1], "speed_x")
+	speed_y = AnimationStateMachine.variable_id(sm, units[1], "speed_y")
+end
+
+local function teardown(times)
+	Device.destroy_world(world)
+	world = nil
+	units = {}
+end
+
+-- Returns a function that changes the direction of @a num sprites each
+-- frame, so that their expressions must be evaluated again.
+local function change(num)
+	return function(frame)
+		-- Consume the events of the previous update.
+		World.update_scene(world, Benchmark.DT)
+
+		local dir = frame % 2 == 0 and 1 or -1
+		for i = 1, num do
+			local unit = units[(frame*num + i) % NUM_SPRITES + 1]
+			AnimationStateMachine.set_variable(sm, unit, speed_x, dir)
+			AnimationStateMachine.set_variable(sm, unit, speed_y, -dir)
+		end
+	end
+end
+
+local function update(dt)
+	World.update_animations(world, dt)
+end
+
+Benchmark.add({
+	{ name = "10k sprites, none changing", setup = setup, prepare = change(0),           update = update, teardown = teardown },
+	{ name = "10k sprites, 10% changing",  setup = setup, prepare = change(1000),        update = update, teardown = teardown },
+	{ name = "10k sprites, all changing",  setup = setup, prepare = change(NUM_SPRITES), update = update, teardown = teardown },
+})
@@ -0,0 +1,115 @@
+-- Runs benchmark cases, one after the other, and prints the time taken by
+-- their update() in each frame. The engine quits after the last case.
+--
+-- Benchmark scripts add their cases with Benchmark.add() and the boot script
+-- calls Benchmark.run() once all of them have been added.
+--
+-- Each case is a table with the following fields:
+--   name     Printed in the report.
+--   setup    function() called before the first frame. Optional.
+--   prepare  function(frame) called before update(), not measured. Optional.
+--   update   function(dt, frame) measured.
+--   teardown function(times) called after the last frame with the measured
+--            times in milliseconds. Optional.
+--   warmup   Frames run before measuring. Defaults to Benchmark.WARMUP.
+--   frames   Frames measured. Defaults to Benchmark.FRAMES.
+--
+-- update() always receives Benchmark.DT, so that the results do not depend
+-- on the frame rate.
+
+Benchmark = Benchmark or {}
+
+Benchmark.WARMUP = 30
+Benchmark.FRAMES = 300
+Benchmark.DT     = 1/60
+
+Benchmark.cases = Benchmark.cases or {}
+
+local function report(name, times)
+	local sorted = {}
+	local total = 0
+	for i = 1, #times do
+		sorted[i] = times[i]
+		total = total + times[i]
+	end
+	table.sort(sorted)
+
+	print(string.format("benchmark: %-40s median %8.3f ms  min %8.3f ms  max %8.3f ms  mean %8.3f ms  (%d frames)"
+		, name
+		, sorted[math.floor((#sorted + 1)/2)]
+		, sorted[1]
+		, sorted[#sorted]
+		, total / #sorted
+		, #sorted
+		))
+end
+
+-- Adds the @a cases to the ones to run.
+function Benchmark.add(cases)
+	for i = 1, #cases do
+		Benchmark.cases[#Benchmark.cases + 1] = cases[i]
+	end
+end
+
+-- Sets the engine's init(), update(), render() and shutdown() to run the
+-- cases added so far.
+function Benchmark.run()
+	local cases = Benchmark.cases
+	local current = 0
+	local case = nil
+	local frame = 0
+	local times = {}
+
+	local function next_case()
+		if case and case.teardown then
+			case.teardown(times)
+		end
+
+		current = current + 1
+		case = cases[current]
+		frame = 0
+		times = {}
+
+		if case and case.setup then
+			case.setup()
+		end
+	end
+
+	init = function()
+		next_case()
+	end
+
+	update = function(dt)
+		if not case then
+			Device.quit()
+			return
+		end
+
+		local warmup = case.warmup or Benchmark.WARMUP
+		local frames = case.frames or Benchmark.FRAMES
+
+		if case.prepare then
+			case.prepare(frame)
+		end
+
+		local t0 = Device.time()
+		case.update(Benchmark.DT, frame)
+		local t1 = Device.time()
+
+		if frame >= warmup then
+			times[#times + 1] = (t1 - t0) * 1000
+		end
+
+		frame = frame + 1
+		if frame == warmup + frames then
+			report(case.name, times)
+			next_case()
+		end
+	end
+
+	render = function(dt)
+	end
+
+	shutdown = function()
+	end
+end
@@ -11,6 +11,7 @@ function crown_project(_name, _kind, _defines)
 		includedirs {
 			CROWN_DIR .. "src",
 			CROWN_DIR .. "3rdparty/bgfx/include",
+			CROWN_DIR .. "3rdparty/bimg/include",
 			CROWN_DIR .. "3rdparty/bx/include",
 			CROWN_DIR .. "3rdparty/stb",
 			CROWN_DIR .. "3rdparty/bullet3/src",
@@ -19,6 +20,7 @@ function crown_project(_name, _kind, _defines)
 
 		defines {
 			_defines,
+			"BT_THREADSAFE=1", -- Must match scripts/bullet.lua
 		}
 
 		links {
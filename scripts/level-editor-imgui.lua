@@ -12,6 +12,7 @@ project "level-editor-imgui"
 		CROWN_DIR .. "tools-imgui",
 		CROWN_DIR .. "3rdparty",
 		CROWN_DIR .. "3rdparty/bgfx/include",
+		CROWN_DIR .. "3rdparty/bimg/include",
 		CROWN_DIR .. "3rdparty/bx/include",
 		CROWN_DIR .. "3rdparty/stb",
 		CROWN_DIR .. "3rdparty/luajit/src",
@@ -87,6 +87,62 @@
 	#define CROWN_DEFAULT_WINDOW_HEIGHT 720
 #endif // CROWN_DEFAULT_WINDOW_HEIGHT
 
+#ifndef CROWN_DEFAULT_TEXTURE_MEMORY_BUDGET
+	#define CROWN_DEFAULT_TEXTURE_MEMORY_BUDGET (512*1024*1024)
+#endif // CROWN_DEFAULT_TEXTURE_MEMORY_BUDGET
+
+#ifndef CROWN_TEXTURE_STREAMING_MIP_SIZE
+	#define CROWN_TEXTURE_STREAMING_MIP_SIZE 128
+#endif // CROWN_TEXTURE_STREAMING_MIP_SIZE
+
+#ifndef CROWN_ANIMATION_MAX_THREADS
+	#define CROWN_ANIMATION_MAX_THREADS 16
+#endif // CROWN_ANIMATION_MAX_THREADS
+
+#ifndef CROWN_ANIMATION_GRAIN_SIZE
+	#define CROWN_ANIMATION_GRAIN_SIZE 256
+#endif // CROWN_ANIMATION_GRAIN_SIZE
+
+#ifndef CROWN_ANIMATION_BATCH_SIZE
+	#define CROWN_ANIMATION_BATCH_SIZE 32
+#endif // CROWN_ANIMATION_BATCH_SIZE
+
+#ifndef CROWN_PHYSICS_QUERY_GRAIN_SIZE
+	#define CROWN_PHYSICS_QUERY_GRAIN_SIZE 64
+#endif // CROWN_PHYSICS_QUERY_GRAIN_SIZE
+
+#ifndef CROWN_SOUND_STREAMING_SIZE
+	#define CROWN_SOUND_STREAMING_SIZE (512*1024)
+#endif // CROWN_SOUND_STREAMING_SIZE
+
+#ifndef CROWN_SOUND_STREAMING_CHUNK_SIZE
+	#define CROWN_SOUND_STREAMING_CHUNK_SIZE (64*1024)
+#endif // CROWN_SOUND_STREAMING_CHUNK_SIZE
+
+#ifndef CROWN_SOUND_STREAMING_BUFFERS
+	#define CROWN_SOUND_STREAMING_BUFFERS 4
+#endif // CROWN_SOUND_STREAMING_BUFFERS
+
+#ifndef CROWN_SOUND_MAX_VOICES
+	#define CROWN_SOUND_MAX_VOICES 32
+#endif // CROWN_SOUND_MAX_VOICES
+
+#ifndef CROWN_SOUND_MIN_AUDIBILITY
+	#define CROWN_SOUND_MIN_AUDIBILITY 0.001f
+#endif // CROWN_SOUND_MIN_AUDIBILITY
+
+#ifndef CROWN_SOUND_ADPCM_BLOCK_SIZE
+	#define CROWN_SOUND_ADPCM_BLOCK_SIZE 512 // Per channel.
+#endif // CROWN_SOUND_ADPCM_BLOCK_SIZE
+
+#ifndef CROWN_DEFAULT_COMPILE_JOBS
+	#define CROWN_DEFAULT_COMPILE_JOBS 4
+#endif // CROWN_DEFAULT_COMPILE_JOBS
+
+#ifndef CROWN_MAX_COMPILE_JOBS
+	#define CROWN_MAX_COMPILE_JOBS 64
+#endif // CROWN_MAX_COMPILE_JOBS
+
 #ifndef CROWN_DEFAULT_CONSOLE_PORT
 	#define CROWN_DEFAULT_CONSOLE_PORT 10001
 #endif // CROWN_DEFAULT_CONSOLE_PORT
@@ -107,6 +163,14 @@
 	#define CROWN_TEMP_DIRECTORY "temp"
 #endif // CROWN_TEMP_DIRECTORY
 
+#ifndef CROWN_CACHE_DIRECTORY
+	#define CROWN_CACHE_DIRECTORY "cache"
+#endif // CROWN_CACHE_DIRECTORY
+
+#ifndef CROWN_CACHE_MAX_SIZE
+	#define CROWN_CACHE_MAX_SIZE (1024*1024*1024) // In bytes.
+#endif // CROWN_CACHE_MAX_SIZE
+
 #ifndef CROWN_DATAIGNORE
 	#define CROWN_DATAIGNORE ".dataignore"
 #endif // CROWN_DATAIGNORE
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2012-2020 Daniele Bartolini and individual contributors.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#include "core/adpcm.h"
+#include "core/error/error.inl"
+
+namespace crown
+{
+namespace adpcm_internal
+{
+	static const s16 step_table[89] =
+	{
+		7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+		19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+		50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+		130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+		337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+		876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+		2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+		5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+		15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+	};
+
+	static const s8 index_table[16] =
+	{
+		-1, -1, -1, -1, 2, 4, 6, 8,
+		-1, -1, -1, -1, 2, 4, 6, 8
+	};
+
+	struct Channel
+	{
+		s32 predictor;
+		s32 index;
+	};
+
+	static inline s32 clamp(s32 val, s32 lo, s32 hi)
+	{
+		return val < lo ? lo : (val > hi ? hi : val);
+	}
+
+	/// Updates the channel state @a ch with the @a nibble and returns the new sample.
+	static inline s16 decode_nibble(Channel& ch, u8 nibble)
+	{
+		const s32 step = step_table[ch.index];
+
+		s32 diff = step >> 3;
+		if (nibble & 4) diff += step;
+		if (nibble & 2) diff += step >> 1;
+		if (nibble & 1) diff += step >> 2;
+
+		ch.predictor = clamp(nibble & 8 ? ch.predictor - diff : ch.predictor + diff, -32768, 32767);
+		ch.index     = clamp(ch.index + index_table[nibble], 0, 88);
+		return (s16)ch.predictor;
+	}
+
+	/// Returns the nibble that best encodes @a sample and updates the channel
+	/// state @a ch exactly as the decoder would.
+	static inline u8 encode_nibble(Channel& ch, s16 sample)
+	{
+		const s32 step = step_table[ch.index];
+
+		s32 diff = s32(sample) - ch.predictor;
+		u8 nibble = 0;
+		if (diff < 0)
+		{
+			nibble = 8;
+			diff = -diff;
+		}
+
+		if (diff >= step)        { nibble |= 4; diff -= step; }
+		if (diff >= (step >> 1)) { nibble |= 2; diff -= step >> 1; }
+		if (diff >= (step >> 2)) { nibble |= 1; }
+
+		decode_nibble(ch, nibble);
+		return nibble;
+	}
+
+	static inline s16 read_s16(const u8* p)
+	{
+		return (s16)(u16(p[0]) | (u16(p[1]) << 8));
+	}
+
+	static inline void write_s16(u8* p, s16 val)
+	{
+		p[0] = u8(u16(val) & 0xff);
+		p[1] = u8(u16(val) >> 8);
+	}
+
+} // namespace adpcm_internal
+
+namespace adpcm
+{
+	u32 frames_per_block(u32 block_size, u32 channels)
+	{
+		CE_ASSERT(block_size > 4*channels && (block_size - 4*channels) % (4*channels) == 0, "Invalid block size");
+		return (block_size - 4*channels) * 2 / channels + 1;
+	}
+
+	u32 encoded_size(u32 num_frames, u32 channels, u32 block_size)
+	{
+		const u32 fpb = frames_per_block(block_size, channels);
+		return (num_frames + fpb - 1) / fpb * block_size;
+	}
+
+	void encode(u8* dst, const s16* pcm, u32 num_frames, u32 channels, u32 block_size)
+	{
+		using namespace adpcm_internal;
+
+		const u32 fpb = frames_per_block(block_size, channels);
+
+		Channel state[8];
+		CE_ENSURE(channels <= countof(state));
+		for (u32 c = 0; c < channels; ++c)
+		{
+			// Start from the step closest to the first difference to avoid a
+			// long adaptation at the beginning of the stream.
+			const s32 diff = num_frames > 1 ? s32(pcm[channels + c]) - s32(pcm[c]) : 0;
+			const s32 abs_diff = diff < 0 ? -diff : diff;
+			state[c].index = 0;
+			while (state[c].index < 88 && step_table[state[c].index] < abs_diff)
+				++state[c].index;
+		}
+
+		for (u32 first = 0; first < num_frames; first += fpb)
+		{
+			u8* block = dst;
+			dst += block_size;
+
+			// Header: the first frame of the block is stored as is.
+			for (u32 c = 0; c < channels; ++c)
+			{
+				state[c].predictor = pcm[first*channels + c];
+				write_s16(&block[c*4], s16(state[c].predictor));
+				block[c*4 + 2] = u8(state[c].index);
+				block[c*4 + 3] = 0;
+			}
+			block += 4*channels;
+
+			// Groups of 8 frames, 4 bytes per channel.
+			for (u32 f = first + 1; f < first + fpb; f += 8)
+			{
+				for (u32 c = 0; c < channels; ++c)
+				{
+					for (u32 i = 0; i < 8; ++i)
+					{
+						const u32 frame = f + i;
+						const s16 sample = frame < num_frames ? pcm[frame*channels + c] : 0;
+						const u8 nibble = encode_nibble(state[c], sample);
+
+						if (i % 2 == 0)
+							block[i/2] = nibble;
+						else
+							block[i/2] |= nibble << 4;
+					}
+					block += 4;
+				}
+			}
+		}
+	}
+
+	void decode(s16* pcm, const u8* src, u32 num_frames, u32 channels, u32 block_size)
+	{
+		using namespace adpcm_internal;
+
+		const u32 fpb = frames_per_block(block_size, channels);
+
+		Channel state[8];
+		CE_ENSURE(channels <= countof(state));
+
+		for (u32 first = 0; first < num_frames; first += fpb)
+		{
+			const u8* block = src;
+			src += block_size;
+
+			for (u32 c = 0; c < channels; ++c)
+			{
+				state[c].predictor = read_s16(&block[c*4]);
+				state[c].index     = clamp(block[c*4 + 2], 0, 88);
+				pcm[first*channels + c] = s16(state[c].predictor);
+			}
+			block += 4*channels;
+
+			const u32 last = first + fpb < num_frames ? first + fpb : num_frames;
+			for (u32 f = first + 1; f < last; f += 8)
+			{
+				for (u32 c = 0; c < channels; ++c)
+				{
+					for (u32 i = 0; i < 8; ++i)
+					{
+						const u8 nibble = (block[i/2] >> (i % 2 ? 4 : 0)) & 0xf;
+						const s16 sample = decode_nibble(state[c], nibble);
+
+						const u32 frame = f + i;
+						if (frame < last)
+							pcm[frame*channels + c] = sample;
+					}
+					block += 4;
+				}
+			}
+		}
+	}
+
+} // namespace adpcm
+
+} // namespace crown
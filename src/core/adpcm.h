@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2012-2020 Daniele Bartolini and individual contributors.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#pragma once
+
+#include "core/types.h"
+
+namespace crown
+{
+/// IMA ADPCM codec.
+///
+/// Encodes 16-bit PCM samples to 4 bits each, in blocks laid out as in
+/// IMA ADPCM WAV files: a 4-byte header per channel holding the first
+/// frame of the block followed by groups of 8 frames, interleaved in 4
+/// bytes per channel.
+///
+/// @ingroup Core
+namespace adpcm
+{
+	/// Returns the number of frames encoded in a block of @a block_size bytes
+	/// with @a channels channels.
+	u32 frames_per_block(u32 block_size, u32 channels);
+
+	/// Returns the size in bytes of @a num_frames frames encoded in blocks of
+	/// @a block_size bytes with @a channels channels.
+	u32 encoded_size(u32 num_frames, u32 channels, u32 block_size);
+
+	/// Encodes @a num_frames frames of interleaved @a pcm samples with @a channels
+	/// channels to @a dst in blocks of @a block_size bytes. The last block is padded
+	/// with silence.
+	void encode(u8* dst, const s16* pcm, u32 num_frames, u32 channels, u32 block_size);
+
+	/// Decodes @a num_frames frames from the blocks of @a block_size bytes in
+	/// @a src to interleaved @a pcm samples with @a channels channels.
+	void decode(s16* pcm, const u8* src, u32 num_frames, u32 channels, u32 block_size);
+
+} // namespace adpcm
+
+} // namespace crown
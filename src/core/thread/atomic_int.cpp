@@ -37,4 +37,13 @@ void AtomicInt::store(s32 val)
 #endif
 }
 
+s32 AtomicInt::fetch_add(s32 val)
+{
+#if CROWN_PLATFORM_POSIX && (CROWN_COMPILER_GCC || CROWN_COMPILER_CLANG)
+	return __sync_fetch_and_add(&_val, val);
+#elif CROWN_PLATFORM_WINDOWS
+	return InterlockedExchangeAdd((LONG*)&_val, val);
+#endif
+}
+
 } // namespace crown
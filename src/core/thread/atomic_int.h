@@ -24,6 +24,9 @@ struct AtomicInt
 
 	///
 	void store(s32 val);
+
+	/// Adds @a val and returns the previous value.
+	s32 fetch_add(s32 val);
 };
 
 } // namespace crown
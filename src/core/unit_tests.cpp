@@ -7,11 +7,14 @@
 
 #if CROWN_BUILD_UNIT_TESTS
 
+#include "core/adpcm.h"
 #include "core/command_line.h"
 #include "core/containers/array.inl"
 #include "core/containers/hash_map.inl"
 #include "core/containers/hash_set.inl"
 #include "core/containers/vector.inl"
+#include "core/filesystem/file.h"
+#include "core/filesystem/filesystem_disk.h"
 #include "core/filesystem/path.h"
 #include "core/guid.h"
 #include "core/json/json.h"
@@ -35,9 +38,21 @@
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string.inl"
 #include "core/strings/string_id.inl"
+#include "core/thread/atomic_int.h"
 #include "core/thread/thread.h"
 #include "core/time.h"
+#include "resource/expression_language.h"
+#include "resource/physics_resource.h"
+#include "resource/resource_id.h"
+#include "resource/resource_loader.h"
+#include "resource/resource_manager.h"
+#include "world/types.h"
 #include <stdlib.h> // EXIT_SUCCESS, EXIT_FAILURE
+#include <string.h> // memset
+#if CROWN_PHYSICS_BULLET
+	#include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
+	#include <BulletCollision/NarrowPhaseCollision/btRaycastCallback.h>
+#endif
 
 #define ENSURE(condition)                                \
 	do                                                   \
@@ -869,6 +884,307 @@ static void test_murmur()
 	ENSURE(n == 0x90631502d1a3432bu);
 }
 
+static void test_adpcm()
+{
+	const u32 channels = 2;
+	const u32 block_size = 256*channels;
+	const u32 num_frames = 2000; // Not a multiple of the frames per block.
+
+	const u32 fpb = adpcm::frames_per_block(block_size, channels);
+	ENSURE(fpb == 505);
+	ENSURE(adpcm::encoded_size(num_frames, channels, block_size) == 4*block_size);
+
+	static s16 pcm[num_frames*channels];
+	static u8 enc[4*block_size];
+	static s16 dec[num_frames*channels];
+	for (u32 i = 0; i < num_frames; ++i)
+	{
+		pcm[i*channels + 0] = s16(16000.0f*fsin(f32(i)*0.05f));
+		pcm[i*channels + 1] = s16(8000.0f*fcos(f32(i)*0.01f));
+	}
+
+	adpcm::encode(enc, pcm, num_frames, channels, block_size);
+	adpcm::decode(dec, enc, num_frames, channels, block_size);
+
+	// The first frame of each block is stored verbatim.
+	for (u32 f = 0; f < num_frames; f += fpb)
+	{
+		ENSURE(dec[f*channels + 0] == pcm[f*channels + 0]);
+		ENSURE(dec[f*channels + 1] == pcm[f*channels + 1]);
+	}
+
+	f32 err = 0.0f;
+	s32 max_err = 0;
+	for (u32 i = 0; i < num_frames*channels; ++i)
+	{
+		const s32 d = s32(dec[i]) - s32(pcm[i]);
+		err += f32(d)*f32(d);
+		max_err = max(max_err, d < 0 ? -d : d);
+	}
+	err = fsqrt(err / f32(num_frames*channels));
+	ENSURE(err < 48.0f);
+	ENSURE(max_err < 256);
+}
+
+static void test_expression_language()
+{
+#if CROWN_CAN_COMPILE
+	using namespace skinny::expression_language;
+
+	const char* names[] = { "a", "b", "c" };
+	const char* sources[] =
+	{
+		"a + b",
+		"a - b",
+		"a * b",
+		"a / (b + 2)",
+		"match(a, 0.5)",
+		"match_2d(a, 0.5, b, 0.25) * c"
+	};
+
+	const u32 num = 37; // Not a multiple of any vector width.
+	f32 columns[countof(names)*num];
+	for (u32 j = 0; j < num; ++j)
+	{
+		columns[0*num + j] = f32(j)/f32(num);
+		columns[1*num + j] = 1.0f - f32(j)*0.03f;
+		columns[2*num + j] = f32(j % 5) - 2.0f;
+	}
+
+	for (u32 i = 0; i < countof(sources); ++i)
+	{
+		u32 byte_code[64];
+		const u32 size = compile(sources[i], countof(names), names, 0, NULL, NULL, byte_code, countof(byte_code));
+		ENSURE(size <= countof(byte_code));
+
+		f32 batch_data[32*num];
+		Stack batch_stack(batch_data, countof(batch_data));
+		ENSURE(run(byte_code, columns, num, num, batch_stack));
+		ENSURE(batch_stack.size == num);
+
+		for (u32 j = 0; j < num; ++j)
+		{
+			const f32 vars[] = { columns[0*num + j], columns[1*num + j], columns[2*num + j] };
+
+			f32 data[32];
+			Stack stack(data, countof(data));
+			ENSURE(run(byte_code, vars, stack));
+			ENSURE(stack.size == 1);
+			ENSURE(fequal(batch_data[j], data[0]));
+		}
+	}
+
+	// Additions and subtractions of zero and multiplications and divisions
+	// by one compile to the same byte code as their other operand.
+	const char* identities[][2] =
+	{
+		{ "a + 0",               "a"         },
+		{ "a - 0",               "a"         },
+		{ "a * 1",               "a"         },
+		{ "a / 1",               "a"         },
+		{ "0 + a",               "a"         },
+		{ "1 * a",               "a"         },
+		{ "(b * 1 + 0) * c",     "b * c"     },
+		{ "1 * (a + b) / 1 - 0", "a + b"     }
+	};
+
+	for (u32 i = 0; i < countof(identities); ++i)
+	{
+		u32 byte_code[64];
+		const u32 size = compile(identities[i][0], countof(names), names, 0, NULL, NULL, byte_code, countof(byte_code));
+		ENSURE(size <= countof(byte_code));
+
+		u32 expected[64];
+		const u32 expected_size = compile(identities[i][1], countof(names), names, 0, NULL, NULL, expected, countof(expected));
+		ENSURE(size == expected_size);
+		ENSURE(memcmp(byte_code, expected, size*sizeof(u32)) == 0);
+
+		for (u32 j = 0; j < num; ++j)
+		{
+			const f32 vars[] = { columns[0*num + j], columns[1*num + j], columns[2*num + j] };
+
+			f32 data[32];
+			Stack stack(data, countof(data));
+			ENSURE(run(byte_code, vars, stack));
+			ENSURE(stack.size == 1);
+
+			f32 expected_data[32];
+			Stack expected_stack(expected_data, countof(expected_data));
+			ENSURE(run(expected, vars, expected_stack));
+			ENSURE(expected_stack.size == 1);
+			ENSURE(fequal(data[0], expected_data[0]));
+		}
+	}
+
+	// Subtractions from zero and divisions of one are kept.
+	const char* non_identities[] = { "0 - a", "1 / a" };
+	for (u32 i = 0; i < countof(non_identities); ++i)
+	{
+		u32 byte_code[64];
+		u32 a[64];
+		const u32 size = compile(non_identities[i], countof(names), names, 0, NULL, NULL, byte_code, countof(byte_code));
+		const u32 a_size = compile("a", countof(names), names, 0, NULL, NULL, a, countof(a));
+		ENSURE(size != a_size);
+	}
+#endif // CROWN_CAN_COMPILE
+}
+
+static void test_heightfield()
+{
+#if CROWN_CAN_COMPILE
+	memory_globals::init();
+	{
+		const u32 size = 1025;
+		const Vector3 position = { 0.0f, 3.0f, 0.0f };
+
+		Array<f32> heights(default_allocator());
+		array::resize(heights, size*size);
+		for (u32 z = 0; z < size; ++z)
+		{
+			for (u32 x = 0; x < size; ++x)
+				heights[z*size + x] = 20.0f*fsin(f32(x)*0.02f)*fcos(f32(z)*0.03f) - 5.0f;
+		}
+
+		ColliderDesc cd;
+		memset((void*)&cd, 0, sizeof(cd));
+		cd.local_tm = from_translation(position);
+
+		Array<s16> samples(default_allocator());
+		physics_resource_internal::compile_heightfield(samples, heights, cd);
+		const HeightfieldShape& hf = cd.heightfield;
+		ENSURE(array::size(samples) == size*size);
+
+		// Every sample is within half a step from its height.
+		for (u32 i = 0; i < size*size; ++i)
+		{
+			const f32 h = hf.height_min + f32(s32(samples[i]) + 32768)*hf.height_scale;
+			ENSURE(fabs(h - heights[i]) <= hf.height_scale*0.5f + 0.0001f);
+		}
+
+#if CROWN_PHYSICS_BULLET
+		// Rays cast straight down hit the heights at the samples.
+		btHeightfieldTerrainShape terrain(size
+			, size
+			, array::begin(samples)
+			, hf.height_scale
+			, -32768.0f*hf.height_scale
+			, 32767.0f*hf.height_scale
+			, 1
+			, PHY_SHORT
+			, false
+			);
+		terrain.buildAccelerator();
+
+		struct ClosestHit : public btTriangleRaycastCallback
+		{
+			ClosestHit(const btVector3& from, const btVector3& to)
+				: btTriangleRaycastCallback(from, to)
+			{
+			}
+
+			virtual btScalar reportHit(const btVector3& /*normal*/, btScalar fraction, int /*part*/, int /*triangle*/)
+			{
+				return fraction;
+			}
+		};
+
+		const u32 coords[] = { 0, 1, 300, 511, 512, 513, 777, 1022, 1023 };
+		for (u32 i = 0; i < countof(coords); ++i)
+		{
+			for (u32 j = 0; j < countof(coords); ++j)
+			{
+				const u32 x = coords[i];
+				const u32 z = coords[j];
+				const btVector3 from(f32(x) - 512.0f,  100.0f, f32(z) - 512.0f);
+				const btVector3 to  (f32(x) - 512.0f, -100.0f, f32(z) - 512.0f);
+
+				ClosestHit cb(from, to);
+				terrain.performRaycast(&cb, from, to);
+				ENSURE(cb.m_hitFraction < 1.0f);
+
+				// Bullet centers the heightfield between its lowest and
+				// highest heights, the world moves it back at runtime.
+				const f32 offset = (hf.height_min + hf.height_max) * 0.5f;
+				const f32 h = 100.0f - 200.0f*cb.m_hitFraction + offset + cd.local_tm.t.y;
+				ENSURE(fabs(h - (heights[z*size + x] + position.y)) <= hf.height_scale + 0.001f);
+			}
+		}
+#endif // CROWN_PHYSICS_BULLET
+	}
+	memory_globals::shutdown();
+#endif // CROWN_CAN_COMPILE
+}
+
+static void* test_resource_load(File& file, Allocator& a)
+{
+	u32* data = (u32*)a.allocate(sizeof(u32));
+	file.read(data, sizeof(u32));
+	return data;
+}
+
+static void test_resource_manager()
+{
+#if CROWN_PLATFORM_POSIX
+	memory_globals::init();
+	{
+		const StringId64 type("unit_test");
+		const StringId64 name("resource");
+		const StringId64 fallback("fallback");
+
+		os::create_directory("/tmp/crown");
+		FilesystemDisk fs(default_allocator());
+		fs.set_prefix("/tmp/crown");
+		fs.create_directory(CROWN_DATA_DIRECTORY);
+
+		// Write the resource and its fallback.
+		DynamicString resource_path(default_allocator());
+		DynamicString fallback_path(default_allocator());
+		destination_path(resource_path, resource_id(type, name));
+		destination_path(fallback_path, resource_id(type, fallback));
+		{
+			const u32 data = 1;
+			File* file = fs.open(resource_path.c_str(), FileOpenMode::WRITE);
+			file->write(&data, sizeof(data));
+			fs.close(*file);
+		}
+		{
+			const u32 data = 2;
+			File* file = fs.open(fallback_path.c_str(), FileOpenMode::WRITE);
+			file->write(&data, sizeof(data));
+			fs.close(*file);
+		}
+
+		{
+			ResourceLoader rl(fs);
+			rl.register_fallback(type, fallback);
+			ResourceManager rm(rl);
+			rm.register_type(type, 0, test_resource_load, NULL, NULL, NULL);
+
+			// Loads over budget are served with the fallback.
+			rm.set_budget(type, 0, true);
+			rm.load(type, name);
+			rm.flush();
+			ENSURE(*(u32*)rm.get(type, name) == 2);
+
+			// Release the resource while its fallback is being replaced.
+			rm.set_budget(type, UINT32_MAX, true);
+			rm.complete_requests();
+			rm.unload(type, name);
+			rm.flush();
+			ENSURE(!rm.can_get(type, name));
+			ENSURE(rm.resident(type) == 0);
+			ENSURE(rm._num_fallbacks == 0);
+		}
+
+		fs.delete_file(resource_path.c_str());
+		fs.delete_file(fallback_path.c_str());
+		fs.delete_directory(CROWN_DATA_DIRECTORY);
+		os::delete_directory("/tmp/crown");
+	}
+	memory_globals::shutdown();
+#endif // CROWN_PLATFORM_POSIX
+}
+
 static void test_string_id()
 {
 	memory_globals::init();
@@ -1354,6 +1670,24 @@ static void test_thread()
 	thread.start([](void*) { return 0xbadc0d3; }, NULL);
 	thread.stop();
 	ENSURE(thread.exit_code() == 0xbadc0d3);
+	{
+		AtomicInt counter(0);
+		Thread threads[4];
+
+		for (u32 i = 0; i < countof(threads); ++i)
+		{
+			threads[i].start([](void* data) {
+					for (u32 j = 0; j < 1000; ++j)
+						((AtomicInt*)data)->fetch_add(1);
+					return 0;
+				}, &counter);
+		}
+		for (u32 i = 0; i < countof(threads); ++i)
+			threads[i].stop();
+
+		ENSURE(counter.fetch_add(0) == 4000);
+		ENSURE(counter.load() == 4000);
+	}
 }
 
 static void test_process()
@@ -1425,6 +1759,10 @@ int main_unit_tests()
 	RUN_TEST(test_aabb);
 	RUN_TEST(test_sphere);
 	RUN_TEST(test_murmur);
+	RUN_TEST(test_adpcm);
+	RUN_TEST(test_expression_language);
+	RUN_TEST(test_heightfield);
+	RUN_TEST(test_resource_manager);
 	RUN_TEST(test_string_id);
 	RUN_TEST(test_dynamic_string);
 	RUN_TEST(test_guid);
@@ -22,6 +22,9 @@ BootConfig::BootConfig(Allocator& a)
 	, aspect_ratio(-1.0f)
 	, vsync(true)
 	, fullscreen(false)
+	, texture_memory_budget(CROWN_DEFAULT_TEXTURE_MEMORY_BUDGET)
+	, physics_threads(1)
+	, animation_threads(1)
 {
 }
 
@@ -62,6 +65,31 @@ bool BootConfig::parse(const char* json)
 				vsync = sjson::parse_bool(renderer["vsync"]);
 			if (json_object::has(renderer, "fullscreen"))
 				fullscreen = sjson::parse_bool(renderer["fullscreen"]);
+			if (json_object::has(renderer, "texture_memory_budget"))
+			{
+				// Clamp to the largest whole number of MiB that fits in 32 bits.
+				const s32 budget_mb = sjson::parse_int(renderer["texture_memory_budget"]);
+				const u64 budget = u64(clamp(budget_mb, 0, 4095)) * 1024 * 1024;
+				texture_memory_budget = u32(budget);
+			}
+		}
+
+		if (json_object::has(platform, "physics"))
+		{
+			JsonObject physics(ta);
+			sjson::parse(physics, platform["physics"]);
+
+			if (json_object::has(physics, "threads"))
+				physics_threads = max(1, sjson::parse_int(physics["threads"]));
+		}
+
+		if (json_object::has(platform, "animation"))
+		{
+			JsonObject animation(ta);
+			sjson::parse(animation, platform["animation"]);
+
+			if (json_object::has(animation, "threads"))
+				animation_threads = max(1, sjson::parse_int(animation["threads"]));
 		}
 	}
 
@@ -24,6 +24,9 @@ struct BootConfig
 	float aspect_ratio;
 	bool vsync;
 	bool fullscreen;
+	u32 texture_memory_budget;
+	u32 physics_threads;
+	u32 animation_threads;
 
 	BootConfig(Allocator& a);
 	bool parse(const char* json);
@@ -53,10 +53,12 @@
 #include "resource/state_machine_resource.h"
 #include "resource/texture_resource.h"
 #include "resource/unit_resource.h"
+#include "world/animation.h"
 #include "world/audio.h"
 #include "world/material_manager.h"
 #include "world/physics.h"
 #include "world/shader_manager.h"
+#include "world/texture_manager.h"
 #include "world/unit_manager.h"
 #include "world/world.h"
 #include <bgfx/bgfx.h>
@@ -210,6 +212,22 @@ static void console_command(ConsoleServer& cs, TCPSocket client, const char* jso
 
 		((Device*)user_data)->reload(ResourceId(type.c_str()), ResourceId(name.c_str()));
 	}
+	else if (cmd == "resources")
+	{
+		u32 num = 10;
+		if (array::size(args) == 2)
+		{
+			DynamicString count(ta);
+			sjson::parse_string(count, args[1]);
+			if (sscanf(count.c_str(), "%u", &num) != 1)
+			{
+				cs.error(client, "Usage: resources [count]");
+				return;
+			}
+		}
+
+		((Device*)user_data)->_resource_manager->log_resident(num);
+	}
 }
 
 Device::Device(const DeviceOptions& opts, ConsoleServer& cs)
@@ -225,6 +243,7 @@ Device::Device(const DeviceOptions& opts, ConsoleServer& cs)
 	, _bgfx_callback(NULL)
 	, _shader_manager(NULL)
 	, _material_manager(NULL)
+	, _texture_manager(NULL)
 	, _input_manager(NULL)
 	, _unit_manager(NULL)
 	, _lua_environment(NULL)
@@ -347,19 +366,19 @@ void Device::run()
 	_resource_manager = CE_NEW(_allocator, ResourceManager)(*_resource_loader);
 	_resource_manager->register_type(RESOURCE_TYPE_CONFIG,           RESOURCE_VERSION_CONFIG,           cor::load, cor::unload, NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_FONT,             RESOURCE_VERSION_FONT,             NULL,      NULL,        NULL,        NULL        );
-	_resource_manager->register_type(RESOURCE_TYPE_LEVEL,            RESOURCE_VERSION_LEVEL,            NULL,      NULL,        NULL,        NULL        );
+	_resource_manager->register_type(RESOURCE_TYPE_LEVEL,            RESOURCE_VERSION_LEVEL,            NULL,      NULL,        NULL,        lvr::offline);
 	_resource_manager->register_type(RESOURCE_TYPE_MATERIAL,         RESOURCE_VERSION_MATERIAL,         mtr::load, mtr::unload, mtr::online, mtr::offline);
 	_resource_manager->register_type(RESOURCE_TYPE_MESH,             RESOURCE_VERSION_MESH,             mhr::load, mhr::unload, mhr::online, mhr::offline);
 	_resource_manager->register_type(RESOURCE_TYPE_PACKAGE,          RESOURCE_VERSION_PACKAGE,          pkr::load, pkr::unload, NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_PHYSICS_CONFIG,   RESOURCE_VERSION_PHYSICS_CONFIG,   NULL,      NULL,        NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_SCRIPT,           RESOURCE_VERSION_SCRIPT,           NULL,      NULL,        NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_SHADER,           RESOURCE_VERSION_SHADER,           shr::load, shr::unload, shr::online, shr::offline);
-	_resource_manager->register_type(RESOURCE_TYPE_SOUND,            RESOURCE_VERSION_SOUND,            NULL,      NULL,        NULL,        NULL        );
+	_resource_manager->register_type(RESOURCE_TYPE_SOUND,            RESOURCE_VERSION_SOUND,            sdr::load, sdr::unload, sdr::online, sdr::offline);
 	_resource_manager->register_type(RESOURCE_TYPE_SPRITE,           RESOURCE_VERSION_SPRITE,           NULL,      NULL,        NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_SPRITE_ANIMATION, RESOURCE_VERSION_SPRITE_ANIMATION, NULL,      NULL,        NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_STATE_MACHINE,    RESOURCE_VERSION_STATE_MACHINE,    NULL,      NULL,        NULL,        NULL        );
 	_resource_manager->register_type(RESOURCE_TYPE_TEXTURE,          RESOURCE_VERSION_TEXTURE,          txr::load, txr::unload, txr::online, txr::offline);
-	_resource_manager->register_type(RESOURCE_TYPE_UNIT,             RESOURCE_VERSION_UNIT,             NULL,      NULL,        NULL,        NULL        );
+	_resource_manager->register_type(RESOURCE_TYPE_UNIT,             RESOURCE_VERSION_UNIT,             NULL,      NULL,        NULL,        utr::offline);
 
 	// Read config
 	{
@@ -419,13 +438,16 @@ void Device::run()
 
 	_shader_manager   = CE_NEW(_allocator, ShaderManager)(default_allocator());
 	_material_manager = CE_NEW(_allocator, MaterialManager)(default_allocator(), *_resource_manager);
+	_texture_manager  = CE_NEW(_allocator, TextureManager)(default_allocator(), *_data_filesystem);
+	_texture_manager->set_budget(_boot_config.texture_memory_budget);
 	_input_manager    = CE_NEW(_allocator, InputManager)(default_allocator());
 	_unit_manager     = CE_NEW(_allocator, UnitManager)(default_allocator());
 	_lua_environment  = CE_NEW(_allocator, LuaEnvironment)();
 	_lua_environment->register_console_commands(*_console_server);
 
-	audio_globals::init();
-	physics_globals::init(_allocator);
+	audio_globals::init(*_data_filesystem);
+	physics_globals::init(_allocator, _boot_config.physics_threads);
+	animation_globals::init(_allocator, _boot_config.animation_threads);
 
 	ResourcePackage* boot_package = create_resource_package(_boot_config.boot_package_name);
 	boot_package->load();
@@ -472,6 +494,7 @@ void Device::run()
 		if (!_paused)
 		{
 			_resource_manager->complete_requests();
+			_texture_manager->update(*_material_manager);
 
 			{
 				const s64 t0 = time::now();
@@ -514,6 +537,10 @@ void Device::run()
 	boot_package->unload();
 	destroy_resource_package(*boot_package);
 
+	// Release unloaded resources while their managers are still alive.
+	_resource_manager->flush();
+
+	animation_globals::shutdown(_allocator);
 	physics_globals::shutdown(_allocator);
 	audio_globals::shutdown();
 
@@ -526,6 +553,7 @@ void Device::run()
 	CE_DELETE(_allocator, _shader_manager);
 	CE_DELETE(_allocator, _resource_manager);
 	CE_DELETE(_allocator, _resource_loader);
+	CE_DELETE(_allocator, _texture_manager);
 
 	bgfx::shutdown();
 	CE_DELETE(_allocator, _bgfx_callback);
@@ -49,6 +49,7 @@ struct Device
 	BgfxCallback* _bgfx_callback;
 	ShaderManager* _shader_manager;
 	MaterialManager* _material_manager;
+	TextureManager* _texture_manager;
 	InputManager* _input_manager;
 	UnitManager* _unit_manager;
 	LuaEnvironment* _lua_environment;
@@ -35,6 +35,7 @@ static void help(const char* msg = NULL)
 		"      windows\n"
 		"      android\n"
 		"  --continue                      Run the engine after the data has been compiled.\n"
+		"  --jobs <n>                      Compile up to <n> resources concurrently.\n"
 		"  --console-port <port>           Set port of the console server.\n"
 		"  --wait-console                  Wait for a console connection before booting the engine.\n"
 		"  --parent-window <handle>        Set the parent window <handle> of the main window.\n"
@@ -61,6 +62,7 @@ DeviceOptions::DeviceOptions(Allocator& a, int argc, const char** argv)
 	, _do_compile(false)
 	, _do_continue(false)
 	, _server(false)
+	, _num_jobs(CROWN_DEFAULT_COMPILE_JOBS)
 	, _parent_window(0)
 	, _console_port(CROWN_DEFAULT_CONSOLE_PORT)
 	, _window_x(0)
@@ -218,6 +220,16 @@ int DeviceOptions::parse(bool* quit)
 		}
 	}
 
+	const char* jobs = cl.get_parameter(0, "jobs");
+	if (jobs)
+	{
+		if (sscanf(jobs, "%u", &_num_jobs) != 1 || _num_jobs == 0)
+		{
+			help("Number of jobs is invalid.");
+			return EXIT_FAILURE;
+		}
+	}
+
 	const char* ls = cl.get_parameter(0, "lua-string");
 	if (ls)
 		_lua_string = ls;
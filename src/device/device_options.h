@@ -29,6 +29,7 @@ struct DeviceOptions
 	bool _do_compile;
 	bool _do_continue;
 	bool _server;
+	u32 _num_jobs;
 	u32 _parent_window;
 	u16 _console_port;
 	u16 _window_x;
@@ -17,6 +17,7 @@
 #include "core/memory/temp_allocator.inl"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_stream.inl"
+#include "core/time.h"
 #include "device/console_server.h"
 #include "device/device.h"
 #include "device/input_device.h"
@@ -31,6 +32,7 @@
 #include "world/debug_line.h"
 #include "world/gui.h"
 #include "world/material.h"
+#include "world/physics.h"
 #include "world/physics_world.h"
 #include "world/render_world.h"
 #include "world/scene_graph.h"
@@ -489,6 +491,85 @@ static void lua_dump_table(lua_State* L, int i, StringStream& json)
 	json << "}";
 }
 
+/// Returns the number at index @a i of the table at index @a table.
+static f32 raw_float(lua_State* L, int table, int i)
+{
+	lua_rawgeti(L, table, i);
+	const f32 val = (f32)lua_tonumber(L, -1);
+	lua_pop(L, 1);
+	return val;
+}
+
+static void raw_set_float(lua_State* L, int table, int i, f32 val)
+{
+	lua_pushnumber(L, val);
+	lua_rawseti(L, table, i);
+}
+
+/// Writes @a num hits to the table at index @a table, 9 values per hit:
+/// time, position (x, y, z), normal (x, y, z), unit and actor. Only the time
+/// (-1) is written for queries that did not hit anything.
+static void raw_set_raycast_hits(LuaStack& stack, int table, const RaycastHit* hits, u32 num)
+{
+	lua_State* L = stack.L;
+
+	for (u32 i = 0; i < num; ++i)
+	{
+		const RaycastHit& hit = hits[i];
+		const int base = i*9;
+
+		raw_set_float(L, table, base + 1, hit.time);
+		if (hit.time < 0.0f)
+			continue;
+
+		raw_set_float(L, table, base + 2, hit.position.x);
+		raw_set_float(L, table, base + 3, hit.position.y);
+		raw_set_float(L, table, base + 4, hit.position.z);
+		raw_set_float(L, table, base + 5, hit.normal.x);
+		raw_set_float(L, table, base + 6, hit.normal.y);
+		raw_set_float(L, table, base + 7, hit.normal.z);
+		stack.push_unit(hit.unit);
+		lua_rawseti(L, table, base + 8);
+		stack.push_actor(hit.actor);
+		lua_rawseti(L, table, base + 9);
+	}
+}
+
+static void raw_set_overlap_hits(LuaStack& stack, int table, const OverlapHit* hits, u32 num)
+{
+	lua_State* L = stack.L;
+
+	for (u32 i = 0; i < num; ++i)
+	{
+		stack.push_unit(hits[i].unit);
+		lua_rawseti(L, table, i*2 + 1);
+		stack.push_actor(hits[i].actor);
+		lua_rawseti(L, table, i*2 + 2);
+	}
+}
+
+// Returns the maximum number of overlap hits requested by the optional
+// argument @a i.
+static u32 overlap_max(LuaStack& stack, int i)
+{
+	if (stack.num_args() < i)
+		return 128;
+
+	const s32 max = stack.get_int(i);
+	LUA_ASSERT(max >= 0, stack, "Invalid maximum number of hits: %d", max);
+	return (u32)max;
+}
+
+// Fills @a table with up to @a max of the @a num @a hits and pushes their
+// number, followed by whether some hits have been left out.
+static int push_overlap_hits(LuaStack& stack, int table, const OverlapHit* hits, u32 num, u32 max)
+{
+	raw_set_overlap_hits(stack, table, hits, min(num, max));
+	stack.push_int(min(num, max));
+	stack.push_bool(num > max);
+	return 2;
+}
+
 void load_api(LuaEnvironment& env)
 {
 	env.add_module_function("Math", "ray_plane_intersection", [](lua_State* L)
@@ -1607,6 +1688,8 @@ void load_api(LuaEnvironment& env)
 			const f32 volume      = nargs > 3 ? stack.get_float(4)   : 1.0f;
 			const Vector3& pos    = nargs > 4 ? stack.get_vector3(5) : VECTOR3_ZERO;
 			const f32 range       = nargs > 5 ? stack.get_float(6)   : 1000.0f;
+			const s32 priority    = nargs > 6 ? stack.get_int(7)     : 128;
+			LUA_ASSERT(priority >= 0 && priority <= 255, stack, "Priority must be in [0; 255]: %d", priority);
 
 			char name_str[RESOURCE_ID_BUF_LEN];
 			LUA_ASSERT(device()->_resource_manager->can_get(RESOURCE_TYPE_SOUND, name)
@@ -1616,7 +1699,7 @@ void load_api(LuaEnvironment& env)
 				);
 			CE_UNUSED(name_str);
 
-			stack.push_sound_instance_id(world->play_sound(name, loop, volume, pos, range));
+			stack.push_sound_instance_id(world->play_sound(name, loop, volume, pos, range, (u8)priority));
 			return 1;
 		});
 	env.add_module_function("World", "stop_sound", [](lua_State* L)
@@ -2571,6 +2654,230 @@ void load_api(LuaEnvironment& env)
 			stack.push_bool(false);
 			return 1;
 		});
+	env.add_module_function("PhysicsWorld", "cast_ray_batch", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			LUA_ASSERT(stack.is_table(2), stack, "Table expected");
+			LUA_ASSERT(stack.is_table(3), stack, "Table expected");
+
+			const u32 num = (u32)lua_objlen(L, 2) / 7;
+
+			TempAllocator4096 ta;
+			Array<RaycastQuery> queries(ta);
+			Array<RaycastHit> hits(ta);
+			array::resize(queries, num);
+			array::resize(hits, num);
+
+			for (u32 i = 0; i < num; ++i)
+			{
+				const int base = i*7;
+				queries[i].from = vector3(raw_float(L, 2, base + 1), raw_float(L, 2, base + 2), raw_float(L, 2, base + 3));
+				queries[i].dir  = vector3(raw_float(L, 2, base + 4), raw_float(L, 2, base + 5), raw_float(L, 2, base + 6));
+				queries[i].len  = raw_float(L, 2, base + 7);
+			}
+
+			const u32 num_hits = stack.get_physics_world(1)->cast_ray_batch(array::begin(hits)
+				, array::begin(queries)
+				, num
+				);
+
+			raw_set_raycast_hits(stack, 3, array::begin(hits), num);
+			stack.push_int(num_hits);
+			return 1;
+		});
+	env.add_module_function("PhysicsWorld", "sweep_batch", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			const char* shape = stack.get_string(2);
+			LUA_ASSERT(stack.is_table(3), stack, "Table expected");
+			LUA_ASSERT(stack.is_table(4), stack, "Table expected");
+
+			const bool is_sphere = strcmp(shape, "sphere") == 0;
+			LUA_ASSERT(is_sphere || strcmp(shape, "box") == 0, stack, "Unknown shape: '%s'", shape);
+
+			const u32 stride = is_sphere ? 8 : 10;
+			const u32 num = (u32)lua_objlen(L, 3) / stride;
+
+			TempAllocator4096 ta;
+			Array<SweepQuery> queries(ta);
+			Array<RaycastHit> hits(ta);
+			array::resize(queries, num);
+			array::resize(hits, num);
+
+			for (u32 i = 0; i < num; ++i)
+			{
+				int base = i*stride;
+				SweepQuery& q = queries[i];
+				q.type = is_sphere ? ColliderType::SPHERE : ColliderType::BOX;
+				q.from = vector3(raw_float(L, 3, base + 1), raw_float(L, 3, base + 2), raw_float(L, 3, base + 3));
+				base += 3;
+
+				if (is_sphere)
+				{
+					q.half_extents = vector3(raw_float(L, 3, base + 1), 0.0f, 0.0f);
+					base += 1;
+				}
+				else
+				{
+					q.half_extents = vector3(raw_float(L, 3, base + 1), raw_float(L, 3, base + 2), raw_float(L, 3, base + 3));
+					base += 3;
+				}
+
+				q.dir = vector3(raw_float(L, 3, base + 1), raw_float(L, 3, base + 2), raw_float(L, 3, base + 3));
+				q.len = raw_float(L, 3, base + 4);
+			}
+
+			const u32 num_hits = stack.get_physics_world(1)->sweep_batch(array::begin(hits)
+				, array::begin(queries)
+				, num
+				);
+
+			raw_set_raycast_hits(stack, 4, array::begin(hits), num);
+			stack.push_int(num_hits);
+			return 1;
+		});
+	env.add_module_function("PhysicsWorld", "overlap_sphere", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			LUA_ASSERT(stack.is_table(5), stack, "Table expected");
+			const u32 max = overlap_max(stack, 6);
+
+			// Look for one more hit to tell whether some are left out.
+			TempAllocator4096 ta;
+			Array<OverlapHit> hits(ta);
+			array::resize(hits, max + 1);
+
+			const u32 num = stack.get_physics_world(1)->overlap_sphere(array::begin(hits)
+				, max + 1
+				, stack.get_vector3(2)
+				, stack.get_float(3)
+				, stack.get_bool(4)
+				);
+
+			return push_overlap_hits(stack, 5, array::begin(hits), num, max);
+		});
+	env.add_module_function("PhysicsWorld", "overlap_box", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			LUA_ASSERT(stack.is_table(6), stack, "Table expected");
+			const u32 max = overlap_max(stack, 7);
+
+			TempAllocator4096 ta;
+			Array<OverlapHit> hits(ta);
+			array::resize(hits, max + 1);
+
+			const u32 num = stack.get_physics_world(1)->overlap_box(array::begin(hits)
+				, max + 1
+				, stack.get_vector3(2)
+				, stack.get_quaternion(3)
+				, stack.get_vector3(4)
+				, stack.get_bool(5)
+				);
+
+			return push_overlap_hits(stack, 6, array::begin(hits), num, max);
+		});
+	env.add_module_function("PhysicsWorld", "overlap_aabb", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			LUA_ASSERT(stack.is_table(4), stack, "Table expected");
+			const u32 max = overlap_max(stack, 5);
+
+			AABB aabb;
+			aabb.min = stack.get_vector3(2);
+			aabb.max = stack.get_vector3(3);
+
+			TempAllocator4096 ta;
+			Array<OverlapHit> hits(ta);
+			array::resize(hits, max + 1);
+
+			const u32 num = stack.get_physics_world(1)->overlap_aabb(array::begin(hits)
+				, max + 1
+				, aabb
+				);
+
+			return push_overlap_hits(stack, 4, array::begin(hits), num, max);
+		});
+	env.add_module_function("PhysicsWorld", "overlap_batch", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			const char* shape = stack.get_string(2);
+			const bool exact = stack.get_bool(3);
+			LUA_ASSERT(stack.is_table(4), stack, "Table expected");
+			LUA_ASSERT(stack.is_table(5), stack, "Table expected");
+			LUA_ASSERT(stack.is_table(6), stack, "Table expected");
+			const u32 max = overlap_max(stack, 7);
+
+			const bool is_sphere = strcmp(shape, "sphere") == 0;
+			LUA_ASSERT(is_sphere || strcmp(shape, "box") == 0, stack, "Unknown shape: '%s'", shape);
+
+			const u32 stride = is_sphere ? 4 : 10;
+			const u32 num = (u32)lua_objlen(L, 4) / stride;
+
+			TempAllocator4096 ta;
+			Array<OverlapQuery> queries(ta);
+			Array<OverlapHit> hits(ta);
+			Array<u32> num_hits(ta);
+			array::resize(queries, num);
+			array::resize(hits, max + 1);
+			array::resize(num_hits, num);
+
+			for (u32 i = 0; i < num; ++i)
+			{
+				int base = i*stride;
+				OverlapQuery& q = queries[i];
+				q.type = is_sphere ? ColliderType::SPHERE : ColliderType::BOX;
+				q.center = vector3(raw_float(L, 4, base + 1), raw_float(L, 4, base + 2), raw_float(L, 4, base + 3));
+				q.rotation = QUATERNION_IDENTITY;
+				q.exact = exact;
+				base += 3;
+
+				if (is_sphere)
+				{
+					q.half_extents = vector3(raw_float(L, 4, base + 1), 0.0f, 0.0f);
+				}
+				else
+				{
+					q.rotation = from_elements(raw_float(L, 4, base + 1), raw_float(L, 4, base + 2), raw_float(L, 4, base + 3), raw_float(L, 4, base + 4));
+					q.half_extents = vector3(raw_float(L, 4, base + 5), raw_float(L, 4, base + 6), raw_float(L, 4, base + 7));
+				}
+			}
+
+			const u32 total = stack.get_physics_world(1)->overlap_batch(array::begin(hits)
+				, max + 1
+				, array::begin(num_hits)
+				, array::begin(queries)
+				, num
+				);
+
+			// The extra hit belongs to the last query that got any.
+			if (total > max)
+			{
+				u32 i = num;
+				while (num_hits[--i] == 0)
+					;
+				--num_hits[i];
+			}
+
+			for (u32 i = 0; i < num; ++i)
+			{
+				stack.push_int(num_hits[i]);
+				lua_rawseti(L, 6, i + 1);
+			}
+
+			return push_overlap_hits(stack, 5, array::begin(hits), total, max);
+		});
+	env.add_module_function("PhysicsWorld", "num_substeps", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			stack.push_int(stack.get_physics_world(1)->num_substeps());
+			return 1;
+		});
+	env.add_module_function("PhysicsWorld", "dropped_time", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			stack.push_float(stack.get_physics_world(1)->dropped_time());
+			return 1;
+		});
 	env.add_module_function("PhysicsWorld", "enable_debug_drawing", [](lua_State* L)
 		{
 			LuaStack stack(L);
@@ -2691,6 +2998,11 @@ void load_api(LuaEnvironment& env)
 			device()->quit();
 			return 0;
 		});
+	env.add_module_function("Device", "time", [](lua_State* L)
+		{
+			lua_pushnumber(L, time::seconds(time::now()));
+			return 1;
+		});
 	env.add_module_function("Device", "resolution", [](lua_State* L)
 		{
 			LuaStack stack(L);
@@ -2755,6 +3067,32 @@ void load_api(LuaEnvironment& env)
 			device()->_resource_manager->enable_autoload(stack.get_bool(1));
 			return 0;
 		});
+	env.add_module_function("Device", "set_resource_budget", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			const StringId64 type(stack.get_string(1));
+			device()->_resource_manager->set_budget(type, stack.get_int(2), stack.get_bool(3));
+			return 0;
+		});
+	env.add_module_function("Device", "resource_memory", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			const StringId64 type(stack.get_string(1));
+			stack.push_int(device()->_resource_manager->resident(type));
+			return 1;
+		});
+	env.add_module_function("Device", "physics_threads", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			stack.push_int(physics_globals::num_threads());
+			return 1;
+		});
+	env.add_module_function("Device", "set_physics_threads", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			physics_globals::set_num_threads(stack.get_int(1));
+			return 0;
+		});
 	env.add_module_function("Device", "temp_count", [](lua_State* L)
 		{
 			LuaStack stack(L);
@@ -2959,6 +3297,15 @@ void load_api(LuaEnvironment& env)
 			stack.push_bool(stack.get_resource_package(1)->has_loaded());
 			return 1;
 		});
+	env.add_module_function("ResourcePackage", "progress", [](lua_State* L)
+		{
+			LuaStack stack(L);
+			ResourcePackage* package = stack.get_resource_package(1);
+			stack.push_int(package->num_loaded());
+			stack.push_int(package->num_resources());
+			stack.push_int(package->bytes_loaded());
+			return 3;
+		});
 	env.add_module_metafunction("ResourcePackage", "__tostring", [](lua_State* L)
 		{
 			LuaStack stack(L);
@@ -17,10 +17,14 @@
 #include "core/json/sjson.h"
 #include "core/memory/allocator.h"
 #include "core/memory/temp_allocator.inl"
+#include "core/murmur.h"
 #include "core/os.h"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_id.inl"
 #include "core/strings/string_stream.inl"
+#include "core/thread/atomic_int.h"
+#include "core/thread/scoped_mutex.h"
+#include "core/thread/thread.h"
 #include "core/time.h"
 #include "device/console_server.h"
 #include "device/device_options.h"
@@ -53,7 +57,8 @@ LOG_SYSTEM(DATA_COMPILER, "data_compiler")
 
 #define CROWN_DATA_VERSIONS "data_versions.sjson"
 #define CROWN_DATA_INDEX "data_index.sjson"
-#define CROWN_DATA_MTIMES "data_mtimes.sjson"
+#define CROWN_DATA_KEYS "data_keys.sjson"
+#define CROWN_DATA_HASHES "data_hashes.sjson"
 #define CROWN_DATA_DEPENDENCIES "data_dependencies.sjson"
 
 namespace crown
@@ -210,6 +215,44 @@ static void console_command_compile(ConsoleServer& cs, TCPSocket client, const c
 	}
 }
 
+// Writes @a str to @a ss as a JSON string.
+static void write_json_string(StringStream& ss, const char* str)
+{
+	ss << "\"";
+	for (; *str; ++str)
+	{
+		if (*str == '"' || *str == '\\')
+			ss << "\\";
+		ss << *str;
+	}
+	ss << "\"";
+}
+
+static void console_command_rebuilds(ConsoleServer& cs, TCPSocket client, const char* json, void* user_data)
+{
+	TempAllocator4096 ta;
+	JsonObject obj(ta);
+	DynamicString path(ta);
+
+	sjson::parse(obj, json);
+	sjson::parse_string(path, obj["path"]);
+
+	Vector<DynamicString> paths(default_allocator());
+	((DataCompiler*)user_data)->rebuilds(paths, path.c_str());
+
+	StringStream ss(default_allocator());
+	ss << "{\"type\":\"rebuilds\",\"path\":";
+	write_json_string(ss, path.c_str());
+	ss << ",\"resources\":[";
+	for (u32 i = 0; i < vector::size(paths); ++i)
+	{
+		ss << (i > 0 ? "," : "");
+		write_json_string(ss, paths[i].c_str());
+	}
+	ss << "]}";
+	cs.send(client, string_stream::c_str(ss));
+}
+
 static void console_command_quit(ConsoleServer& /*cs*/, TCPSocket /*client*/, const char* /*json*/, void* /*user_data*/)
 {
 	_quit = true;
@@ -288,7 +331,7 @@ static void read_data_index(HashMap<StringId64, DynamicString>& index, Filesyste
 	}
 }
 
-static void read_data_mtimes(HashMap<StringId64, u64>& mtimes, FilesystemDisk& data_fs, const char* filename)
+static void read_data_keys(HashMap<StringId64, u64>& keys, FilesystemDisk& data_fs, const char* filename)
 {
 	Buffer json = read(data_fs, filename);
 
@@ -304,14 +347,46 @@ static void read_data_mtimes(HashMap<StringId64, u64>& mtimes, FilesystemDisk& d
 
 		TempAllocator64 ta;
 		StringId64 dst_name;
-		DynamicString mtime_json(ta);
+		DynamicString key_json(ta);
 
 		dst_name.parse(cur->first.data());
-		sjson::parse_string(mtime_json, cur->second);
+		sjson::parse_string(key_json, cur->second);
 
-		u64 mtime;
-		sscanf(mtime_json.c_str(), "%" SCNu64, &mtime);
-		hash_map::set(mtimes, dst_name, mtime);
+		u64 key;
+		sscanf(key_json.c_str(), "%" SCNu64, &key);
+		hash_map::set(keys, dst_name, key);
+	}
+}
+
+static void read_data_hashes(HashMap<DynamicString, DataCompiler::SourceHash>& hashes, FilesystemDisk& data_fs, const char* filename)
+{
+	Buffer json = read(data_fs, filename);
+
+	TempAllocator1024 ta;
+	JsonObject obj(ta);
+	sjson::parse(obj, json);
+
+	auto cur = json_object::begin(obj);
+	auto end = json_object::end(obj);
+	for (; cur != end; ++cur)
+	{
+		JSON_OBJECT_SKIP_HOLE(obj, cur);
+
+		TempAllocator512 ta;
+		DynamicString path(ta);
+		path.set(cur->first.data(), cur->first.length());
+
+		JsonObject hash_obj(ta);
+		sjson::parse_object(hash_obj, cur->second);
+		DynamicString mtime_json(ta);
+		sjson::parse_string(mtime_json, hash_obj["mtime"]);
+		DynamicString hash_json(ta);
+		sjson::parse_string(hash_json, hash_obj["hash"]);
+
+		DataCompiler::SourceHash sh;
+		sscanf(mtime_json.c_str(), "%" SCNu64, &sh.mtime);
+		sscanf(hash_json.c_str(), "%" SCNu64, &sh.hash);
+		hash_map::set(hashes, path, sh);
 	}
 }
 
@@ -401,7 +476,7 @@ static void write_data_versions(FilesystemDisk& data_fs, const char* filename, c
 }
 
 
-static void write_data_mtimes(FilesystemDisk& data_fs, const char* filename, const HashMap<StringId64, u64>& mtimes)
+static void write_data_keys(FilesystemDisk& data_fs, const char* filename, const HashMap<StringId64, u64>& keys)
 {
 	StringStream ss(default_allocator());
 
@@ -409,11 +484,11 @@ static void write_data_mtimes(FilesystemDisk& data_fs, const char* filename, con
 	if (file)
 	{
 
-		auto cur = hash_map::begin(mtimes);
-		auto end = hash_map::end(mtimes);
+		auto cur = hash_map::begin(keys);
+		auto end = hash_map::end(keys);
 		for (; cur != end; ++cur)
 		{
-			HASH_MAP_SKIP_HOLE(mtimes, cur);
+			HASH_MAP_SKIP_HOLE(keys, cur);
 
 			TempAllocator64 ta;
 			DynamicString key(ta);
@@ -426,6 +501,27 @@ static void write_data_mtimes(FilesystemDisk& data_fs, const char* filename, con
 	}
 }
 
+static void write_data_hashes(FilesystemDisk& data_fs, const char* filename, const HashMap<DynamicString, DataCompiler::SourceHash>& hashes)
+{
+	StringStream ss(default_allocator());
+
+	File* file = data_fs.open(filename, FileOpenMode::WRITE);
+	if (file)
+	{
+		auto cur = hash_map::begin(hashes);
+		auto end = hash_map::end(hashes);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(hashes, cur);
+
+			ss << "\"" << cur->first.c_str() << "\" = { mtime = \"" << cur->second.mtime << "\" hash = \"" << cur->second.hash << "\" }\n";
+		}
+
+		file->write(string_stream::c_str(ss), strlen32(string_stream::c_str(ss)));
+		data_fs.close(*file);
+	}
+}
+
 static void write_data_dependencies(FilesystemDisk& data_fs, const char* filename, const HashMap<StringId64, DynamicString>& index, const HashMap<StringId64, HashMap<DynamicString, u32> >& dependencies, const HashMap<StringId64, HashMap<DynamicString, u32> >& requirements)
 {
 	StringStream ss(default_allocator());
@@ -489,13 +585,20 @@ DataCompiler::DataCompiler(const DeviceOptions& opts, ConsoleServer& cs)
 	, _compilers(default_allocator())
 	, _globs(default_allocator())
 	, _data_index(default_allocator())
-	, _data_mtimes(default_allocator())
+	, _data_keys(default_allocator())
+	, _source_hashes(default_allocator())
+	, _keys(default_allocator())
+	, _data_dependents(default_allocator())
+	, _data_requirers(default_allocator())
+	, _dependents_changed(true)
 	, _data_dependencies(default_allocator())
 	, _data_requirements(default_allocator())
 	, _data_versions(default_allocator())
 	, _file_monitor(default_allocator())
+	, _num_jobs(max(1u, min(opts._num_jobs, (u32)CROWN_MAX_COMPILE_JOBS)))
 {
 	cs.register_command("compile", console_command_compile, this);
+	cs.register_command("rebuilds", console_command_rebuilds, this);
 	cs.register_command("quit", console_command_quit, this);
 }
 
@@ -662,7 +765,8 @@ void DataCompiler::scan_and_restore(const char* data_dir)
 
 	read_data_versions(_data_versions, data_fs, CROWN_DATA_VERSIONS);
 	read_data_index(_data_index, data_fs, CROWN_DATA_INDEX);
-	read_data_mtimes(_data_mtimes, data_fs, CROWN_DATA_MTIMES);
+	read_data_keys(_data_keys, data_fs, CROWN_DATA_KEYS);
+	read_data_hashes(_source_hashes, data_fs, CROWN_DATA_HASHES);
 	read_data_dependencies(*this, data_fs, CROWN_DATA_DEPENDENCIES);
 	logi(DATA_COMPILER, "Restored state in %.2fs", time::seconds(time::now() - time_start));
 
@@ -693,46 +797,238 @@ void DataCompiler::save(const char* data_dir)
 
 	write_data_index(data_fs, CROWN_DATA_INDEX, _data_index);
 	write_data_versions(data_fs, CROWN_DATA_VERSIONS, _data_versions);
-	write_data_mtimes(data_fs, CROWN_DATA_MTIMES, _data_mtimes);
+	write_data_keys(data_fs, CROWN_DATA_KEYS, _data_keys);
+	write_data_hashes(data_fs, CROWN_DATA_HASHES, _source_hashes);
 	write_data_dependencies(data_fs, CROWN_DATA_DEPENDENCIES, _data_index, _data_dependencies, _data_requirements);
 	logi(DATA_COMPILER, "Saved state in %.2fs", time::seconds(time::now() - time_start));
 }
 
-bool DataCompiler::dependency_changed(const DynamicString& src_path, ResourceId id, u64 dst_mtime)
+static void add_dependents(HashMap<DynamicString, Array<StringId64> >& dependents, const HashMap<StringId64, HashMap<DynamicString, u32> >& dependencies)
 {
-	TempAllocator1024 ta;
-	DynamicString path(ta);
-	destination_path(path, id);
+	auto cur = hash_map::begin(dependencies);
+	auto end = hash_map::end(dependencies);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(dependencies, cur);
 
-	Stat src_stat;
-	src_stat = hash_map::get(_source_index._paths, src_path, src_stat);
-	if (src_stat.mtime > dst_mtime)
-		return true;
+		auto dep_cur = hash_map::begin(cur->second);
+		auto dep_end = hash_map::end(cur->second);
+		for (; dep_cur != dep_end; ++dep_cur)
+		{
+			HASH_MAP_SKIP_HOLE(cur->second, dep_cur);
 
-	HashMap<DynamicString, u32> deffault(default_allocator());
-	HashMap<DynamicString, u32>& deps = hash_map::get(_data_dependencies, id, deffault);
-	auto cur = hash_map::begin(deps);
-	auto end = hash_map::end(deps);
+			if (!hash_map::has(dependents, dep_cur->first))
+			{
+				Array<StringId64> ids(default_allocator());
+				hash_map::set(dependents, dep_cur->first, ids);
+			}
+
+			Array<StringId64> deffault(default_allocator());
+			array::push_back(hash_map::get(dependents, dep_cur->first, deffault), cur->first);
+		}
+	}
+}
+
+void DataCompiler::update_dependents()
+{
+	if (!_dependents_changed)
+		return;
+
+	hash_map::clear(_data_dependents);
+	hash_map::clear(_data_requirers);
+	add_dependents(_data_dependents, _data_dependencies);
+	add_dependents(_data_requirers, _data_requirements);
+	_dependents_changed = false;
+}
+
+void DataCompiler::changed_sources(Vector<DynamicString>& changed)
+{
+	// Added and modified sources.
+	auto cur = hash_map::begin(_source_index._paths);
+	auto end = hash_map::end(_source_index._paths);
 	for (; cur != end; ++cur)
 	{
-		HASH_MAP_SKIP_HOLE(deps, cur);
+		HASH_MAP_SKIP_HOLE(_source_index._paths, cur);
 
-		if (src_path == cur->first)
+		SourceHash sh;
+		sh.mtime = 0;
+		sh.hash = 0;
+		const bool hashed = hash_map::has(_source_hashes, cur->first);
+		sh = hash_map::get(_source_hashes, cur->first, sh);
+		if (hashed && sh.mtime == cur->second.mtime)
 			continue;
 
-		if (dependency_changed(cur->first, resource_id(cur->first.c_str()), dst_mtime))
-			return true;
+		if (!hashed || source_hash(cur->first) != sh.hash)
+			vector::push_back(changed, cur->first);
 	}
 
-	return false;
+	// Removed sources.
+	Vector<DynamicString> removed(default_allocator());
+	auto hash_cur = hash_map::begin(_source_hashes);
+	auto hash_end = hash_map::end(_source_hashes);
+	for (; hash_cur != hash_end; ++hash_cur)
+	{
+		HASH_MAP_SKIP_HOLE(_source_hashes, hash_cur);
+
+		if (!hash_map::has(_source_index._paths, hash_cur->first))
+			vector::push_back(removed, hash_cur->first);
+	}
+
+	for (u32 i = 0; i < vector::size(removed); ++i)
+	{
+		hash_map::remove(_source_hashes, removed[i]);
+		vector::push_back(changed, removed[i]);
+	}
+
+	// Sources whose compiler changed.
+	auto index_cur = hash_map::begin(_data_index);
+	auto index_end = hash_map::end(_data_index);
+	for (; index_cur != index_end; ++index_cur)
+	{
+		HASH_MAP_SKIP_HOLE(_data_index, index_cur);
+
+		const char* type = path::extension(index_cur->second.c_str());
+		if (data_version_stored(type) != data_version(type))
+			vector::push_back(changed, index_cur->second);
+	}
 }
 
-bool DataCompiler::version_changed(const DynamicString& src_path, ResourceId id)
+void DataCompiler::invalidated(HashMap<StringId64, u32>& rebuilt, const Vector<DynamicString>& changed)
 {
-	const char* type = path::extension(src_path.c_str());
+	update_dependents();
+
+	// A change to the key of a file changes the keys of the resources that
+	// depend on it. A change to the requirements of a file changes the keys
+	// of the packages that depend on it. Both propagate to the resources that
+	// require the file. Each file is queued at most once for each kind.
+	HashMap<DynamicString, u32> key_changed(default_allocator());
+	HashMap<DynamicString, u32> requirements_changed(default_allocator());
+	Vector<DynamicString> key_queue(default_allocator());
+	Vector<DynamicString> requirements_queue(default_allocator());
+
+	for (u32 i = 0; i < vector::size(changed); ++i)
+	{
+		if (!hash_map::has(key_changed, changed[i]))
+		{
+			hash_map::set(key_changed, changed[i], 0u);
+			vector::push_back(key_queue, changed[i]);
+		}
+	}
 
-	if (data_version_stored(type) != data_version(type))
-		return true;
+	u32 key_head = 0;
+	u32 requirements_head = 0;
+	while (key_head < vector::size(key_queue) || requirements_head < vector::size(requirements_queue))
+	{
+		const bool is_key = key_head < vector::size(key_queue);
+		const DynamicString path = is_key ? key_queue[key_head++] : requirements_queue[requirements_head++];
+
+		const char* type = path::extension(path.c_str());
+		if (is_key && type != NULL && can_compile(type))
+			hash_map::set(rebuilt, resource_id(path.c_str()), 0u);
+
+		Array<StringId64> deffault(default_allocator());
+		const Array<StringId64>& dependents = hash_map::get(_data_dependents, path, deffault);
+		for (u32 i = 0; i < array::size(dependents); ++i)
+		{
+			DynamicString dependent(default_allocator());
+			dependent = hash_map::get(_data_index, dependents[i], dependent);
+			if (dependent.empty() || hash_map::has(key_changed, dependent))
+				continue;
+
+			if (is_key || dependent.has_suffix(".package"))
+			{
+				hash_map::set(key_changed, dependent, 0u);
+				vector::push_back(key_queue, dependent);
+			}
+		}
+
+		const Array<StringId64>& requirers = hash_map::get(_data_requirers, path, deffault);
+		for (u32 i = 0; i < array::size(requirers); ++i)
+		{
+			DynamicString requirer(default_allocator());
+			requirer = hash_map::get(_data_index, requirers[i], requirer);
+			if (requirer.empty() || hash_map::has(requirements_changed, requirer))
+				continue;
+
+			hash_map::set(requirements_changed, requirer, 0u);
+			vector::push_back(requirements_queue, requirer);
+		}
+	}
+}
+
+void DataCompiler::rebuilds(Vector<DynamicString>& paths, const char* path)
+{
+	Vector<DynamicString> changed(default_allocator());
+	DynamicString path_ds(default_allocator());
+	path_ds = path;
+	vector::push_back(changed, path_ds);
+
+	HashMap<StringId64, u32> rebuilt(default_allocator());
+	invalidated(rebuilt, changed);
+
+	auto cur = hash_map::begin(rebuilt);
+	auto end = hash_map::end(rebuilt);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(rebuilt, cur);
+
+		DynamicString src_path(default_allocator());
+		src_path = hash_map::get(_data_index, cur->first, src_path);
+		if (!src_path.empty())
+			vector::push_back(paths, src_path);
+	}
+
+	std::sort(vector::begin(paths), vector::end(paths));
+}
+
+u64 DataCompiler::source_hash(const DynamicString& path)
+{
+	Stat stat;
+	stat.file_type = Stat::NO_ENTRY;
+	stat.size = 0;
+	stat.mtime = 0;
+	stat = hash_map::get(_source_index._paths, path, stat);
+	if (stat.file_type == Stat::NO_ENTRY)
+		return 0;
+
+	SourceHash sh;
+	sh.mtime = 0;
+	sh.hash = 0;
+	sh = hash_map::get(_source_hashes, path, sh);
+	if (sh.mtime == stat.mtime && hash_map::has(_source_hashes, path))
+		return sh.hash;
+
+	TempAllocator256 ta;
+	DynamicString source_dir(ta);
+	this->source_dir(path.c_str(), source_dir);
+
+	FilesystemDisk source_fs(ta);
+	source_fs.set_prefix(source_dir.c_str());
+
+	Buffer data = read(source_fs, path.c_str());
+	sh.mtime = stat.mtime;
+	sh.hash = murmur64(array::begin(data), array::size(data), 0);
+	hash_map::set(_source_hashes, path, sh);
+	return sh.hash;
+}
+
+u64 DataCompiler::compile_key(const DynamicString& src_path, ResourceId id, const char* platform)
+{
+	u64 key = 0;
+	if (hash_map::has(_keys, id))
+		return hash_map::get(_keys, id, key);
+
+	// Guard against circular dependencies.
+	hash_map::set(_keys, id, key);
+
+	const u32 version = data_version(path::extension(src_path.c_str()));
+	key = murmur64(src_path.c_str(), src_path.length(), source_hash(src_path));
+	key = murmur64(&version, sizeof(version), key);
+	key = murmur64(platform, strlen32(platform), key);
+
+	// Dependencies are summed so that the key does not depend on the
+	// order in which they have been recorded.
+	u64 dependencies_key = 0;
 
 	HashMap<DynamicString, u32> deffault(default_allocator());
 	HashMap<DynamicString, u32>& deps = hash_map::get(_data_dependencies, id, deffault);
@@ -742,14 +1038,244 @@ bool DataCompiler::version_changed(const DynamicString& src_path, ResourceId id)
 	{
 		HASH_MAP_SKIP_HOLE(deps, cur);
 
-		if (src_path == cur->first)
+		const DynamicString& dep_path = cur->first;
+		if (src_path == dep_path)
 			continue;
 
-		if (version_changed(cur->first, resource_id(cur->first.c_str())))
-			return true;
+		const char* type = path::extension(dep_path.c_str());
+		if (type != NULL && can_compile(type))
+			dependencies_key += compile_key(dep_path, resource_id(dep_path.c_str()), platform);
+		else
+			dependencies_key += murmur64(dep_path.c_str(), dep_path.length(), source_hash(dep_path));
 	}
 
-	return false;
+	// Packages embed the requirements of their resources.
+	if (src_path.has_suffix(".package"))
+	{
+		HashMap<StringId64, u32> visited(default_allocator());
+
+		cur = hash_map::begin(deps);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(deps, cur);
+
+			const char* type = path::extension(cur->first.c_str());
+			if (!(src_path == cur->first) && type != NULL && can_compile(type))
+				dependencies_key += requirements_key(resource_id(cur->first.c_str()), visited, platform);
+		}
+	}
+
+	key = murmur64(&dependencies_key, sizeof(dependencies_key), key);
+	hash_map::set(_keys, id, key);
+	return key;
+}
+
+u64 DataCompiler::requirements_key(ResourceId id, HashMap<StringId64, u32>& visited, const char* platform)
+{
+	u64 key = 0;
+
+	HashMap<DynamicString, u32> deffault(default_allocator());
+	HashMap<DynamicString, u32>& reqs = hash_map::get(_data_requirements, id, deffault);
+	auto cur = hash_map::begin(reqs);
+	auto end = hash_map::end(reqs);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(reqs, cur);
+
+		const ResourceId req_id = resource_id(cur->first.c_str());
+		if (hash_map::has(visited, req_id))
+			continue;
+
+		hash_map::set(visited, req_id, 0u);
+		key += compile_key(cur->first, req_id, platform);
+		key += requirements_key(req_id, visited, platform);
+	}
+
+	return key;
+}
+
+static void cache_path(DynamicString& path, u64 key)
+{
+	char name[17];
+	snprintf(name, sizeof(name), "%.16" PRIx64, key);
+	path::join(path, CROWN_CACHE_DIRECTORY, name);
+}
+
+/// Appends the number of @a paths followed by each path to @a entry.
+static void write_paths(Buffer& entry, const HashMap<DynamicString, u32>& paths)
+{
+	const u32 num = hash_map::size(paths);
+	array::push(entry, (const char*)&num, sizeof(num));
+
+	auto cur = hash_map::begin(paths);
+	auto end = hash_map::end(paths);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(paths, cur);
+
+		const u32 len = cur->first.length();
+		array::push(entry, (const char*)&len, sizeof(len));
+		array::push(entry, cur->first.c_str(), len);
+	}
+}
+
+/// Reads the paths written by write_paths() from @a data, up to @a end, and
+/// adds each one to @a id with @a add. Returns the data past the paths or NULL
+/// if the entry is truncated.
+static const char* read_paths(const char* data, const char* end, DataCompiler& dc, ResourceId id, void (DataCompiler::*add)(ResourceId, const char*))
+{
+	u32 num;
+	if (end - data < (ptrdiff_t)sizeof(num))
+		return NULL;
+	memcpy(&num, data, sizeof(num));
+	data += sizeof(num);
+
+	for (u32 i = 0; i < num; ++i)
+	{
+		u32 len;
+		if (end - data < (ptrdiff_t)sizeof(len))
+			return NULL;
+		memcpy(&len, data, sizeof(len));
+		data += sizeof(len);
+
+		if (end - data < (ptrdiff_t)len)
+			return NULL;
+		TempAllocator256 ta;
+		DynamicString path(ta);
+		path.set(data, len);
+		(dc.*add)(id, path.c_str());
+		data += len;
+	}
+
+	return data;
+}
+
+bool DataCompiler::restore_from_cache(FilesystemDisk& data_fs, ResourceId id, u64 key)
+{
+	TempAllocator256 ta;
+	DynamicString path(ta);
+	cache_path(path, key);
+
+	Buffer entry = read(data_fs, path.c_str());
+	const char* data = array::begin(entry);
+	const char* end = array::end(entry);
+
+	u32 version;
+	if (end - data < (ptrdiff_t)sizeof(version))
+		return false;
+	memcpy(&version, data, sizeof(version));
+	data += sizeof(version);
+	if (version != CACHE_VERSION)
+		return false;
+
+	// Restore the dependencies and requirements.
+	HashMap<DynamicString, u32> dependencies_deffault(default_allocator());
+	hash_map::clear(hash_map::get(_data_dependencies, id, dependencies_deffault));
+	HashMap<DynamicString, u32> requirements_deffault(default_allocator());
+	hash_map::clear(hash_map::get(_data_requirements, id, requirements_deffault));
+	_dependents_changed = true;
+
+	data = read_paths(data, end, *this, id, &DataCompiler::add_dependency);
+	if (data != NULL)
+		data = read_paths(data, end, *this, id, &DataCompiler::add_requirement);
+	if (data == NULL)
+	{
+		logw(DATA_COMPILER, "Corrupted cache entry: %s", path.c_str());
+		data_fs.delete_file(path.c_str());
+		return false;
+	}
+
+	// Restore the compiled data.
+	DynamicString dst_path(ta);
+	destination_path(dst_path, id);
+
+	const u32 size = u32(end - data);
+	File* file = data_fs.open(dst_path.c_str(), FileOpenMode::WRITE);
+	const u32 written = file->write(data, size);
+	data_fs.close(*file);
+	return written == size;
+}
+
+void DataCompiler::store_to_cache(FilesystemDisk& data_fs, ResourceId id, u64 key)
+{
+	TempAllocator256 ta;
+	DynamicString dst_path(ta);
+	destination_path(dst_path, id);
+	Buffer data = read(data_fs, dst_path.c_str());
+
+	Buffer entry(default_allocator());
+
+	// Dependencies and requirements come first, followed by the compiled data.
+	const u32 version = CACHE_VERSION;
+	array::push(entry, (const char*)&version, sizeof(version));
+
+	HashMap<DynamicString, u32> deffault(default_allocator());
+	write_paths(entry, hash_map::get(_data_dependencies, id, deffault));
+	write_paths(entry, hash_map::get(_data_requirements, id, deffault));
+
+	array::push(entry, array::begin(data), array::size(data));
+
+	DynamicString path(ta);
+	cache_path(path, key);
+	File* file = data_fs.open(path.c_str(), FileOpenMode::WRITE);
+	file->write(array::begin(entry), array::size(entry));
+	data_fs.close(*file);
+}
+
+void DataCompiler::prune_cache(FilesystemDisk& data_fs, u64 max_size)
+{
+	struct Entry
+	{
+		u64 mtime;
+		u64 size;
+		u32 index;
+	};
+
+	Vector<DynamicString> names(default_allocator());
+	data_fs.list_files(CROWN_CACHE_DIRECTORY, names);
+
+	Array<Entry> entries(default_allocator());
+	u64 total_size = 0;
+	for (u32 i = 0; i < vector::size(names); ++i)
+	{
+		TempAllocator256 ta;
+		DynamicString path(ta);
+		path::join(path, CROWN_CACHE_DIRECTORY, names[i].c_str());
+
+		const Stat st = data_fs.stat(path.c_str());
+		if (st.file_type != Stat::REGULAR)
+			continue;
+
+		Entry e;
+		e.mtime = st.mtime;
+		e.size  = st.size;
+		e.index = i;
+		array::push_back(entries, e);
+		total_size += st.size;
+	}
+
+	if (total_size <= max_size)
+		return;
+
+	// Delete the oldest entries first.
+	std::sort(array::begin(entries), array::end(entries), [](const Entry& a, const Entry& b)
+		{
+			return a.mtime < b.mtime;
+		});
+
+	u32 num_deleted = 0;
+	for (u32 i = 0; i < array::size(entries) && total_size > max_size; ++i)
+	{
+		TempAllocator256 ta;
+		DynamicString path(ta);
+		path::join(path, CROWN_CACHE_DIRECTORY, names[entries[i].index].c_str());
+
+		data_fs.delete_file(path.c_str());
+		total_size -= entries[i].size;
+		++num_deleted;
+	}
+
+	logi(DATA_COMPILER, "Pruned %u entries from the cache", num_deleted);
 }
 
 bool DataCompiler::should_ignore(const char* path)
@@ -772,6 +1298,17 @@ bool DataCompiler::compile(const char* data_dir, const char* platform)
 	data_fs.create_directory("");
 	data_fs.create_directory(CROWN_DATA_DIRECTORY);
 	data_fs.create_directory(CROWN_TEMP_DIRECTORY);
+	data_fs.create_directory(CROWN_CACHE_DIRECTORY);
+
+	hash_map::clear(_keys);
+	u32 num_restored = 0;
+
+	// Find what changed since the last compilation and everything that
+	// depends on it.
+	Vector<DynamicString> changed(default_allocator());
+	changed_sources(changed);
+	HashMap<StringId64, u32> rebuilt(default_allocator());
+	invalidated(rebuilt, changed);
 
 	// Find the set of resources to be compiled
 	Vector<DynamicString> to_compile(default_allocator());
@@ -801,26 +1338,36 @@ bool DataCompiler::compile(const char* data_dir, const char* platform)
 		DynamicString path(ta);
 		destination_path(path, id);
 
-		u64 dst_mtime = 0;
-		dst_mtime = hash_map::get(_data_mtimes, id, dst_mtime);
-		Stat src_stat;
-		src_stat = hash_map::get(_source_index._paths, src_path, src_stat);
-
-		bool source_never_compiled_before    = hash_map::has(_data_index, id) == false;
-		bool source_has_been_changed         = src_stat.mtime > dst_mtime;
-		bool source_dependency_changed       = dependency_changed(src_path, id, dst_mtime);
-		bool data_version_changed            = data_version_stored(type) != data_version(type);
-		bool data_version_dependency_changed = version_changed(src_path, id);
-
-		if (source_never_compiled_before
-			|| source_has_been_changed
-			|| source_dependency_changed
-			|| data_version_changed
-			|| data_version_dependency_changed
-			)
+		bool source_never_compiled_before = hash_map::has(_data_index, id) == false;
+		bool source_key_missing           = hash_map::has(_data_keys, id) == false;
+		bool source_invalidated           = hash_map::has(rebuilt, id);
+		bool data_missing                 = !data_fs.exists(path.c_str());
+
+		if (!source_never_compiled_before && !source_key_missing && !source_invalidated && !data_missing)
+			continue;
+
+		// The key may match if the content went back to what was compiled last.
+		u64 stored_key = 0;
+		stored_key = hash_map::get(_data_keys, id, stored_key);
+		const u64 key = compile_key(src_path, id, platform);
+
+		if (!source_never_compiled_before && key == stored_key && !data_missing)
+			continue;
+
+		if (restore_from_cache(data_fs, id, key))
 		{
-			vector::push_back(to_compile, src_path);
+			logi(DATA_COMPILER, "%s (cached)", filename);
+
+			DynamicString type_str(ta);
+			type_str = type;
+			hash_map::set(_data_index, id, src_path);
+			hash_map::set(_data_versions, type_str, data_version(type));
+			hash_map::set(_data_keys, id, key);
+			++num_restored;
+			continue;
 		}
+
+		vector::push_back(to_compile, src_path);
 	}
 
 	// Sort to_compile so that ".package" resources get compiled last
@@ -835,78 +1382,188 @@ bool DataCompiler::compile(const char* data_dir, const char* platform)
 #undef PACKAGE
 		});
 
+	// Reset dependencies and requirements since data could not depend
+	// anymore on any of those.
+	for (u32 i = 0; i < vector::size(to_compile); ++i)
+	{
+		const ResourceId id = resource_id(to_compile[i].c_str());
+		HashMap<DynamicString, u32> dependencies_deffault(default_allocator());
+		hash_map::clear(hash_map::get(_data_dependencies, id, dependencies_deffault));
+		HashMap<DynamicString, u32> requirements_deffault(default_allocator());
+		hash_map::clear(hash_map::get(_data_requirements, id, requirements_deffault));
+		_dependents_changed = true;
+	}
+
+	// Packages read the requirements of their resources, so they are
+	// compiled in a second pass once all the other resources are done.
+	u32 num_resources = 0;
+	while (num_resources < vector::size(to_compile) && !to_compile[num_resources].has_suffix(".package"))
+		++num_resources;
+
+	Array<bool> results(default_allocator());
+	array::resize(results, vector::size(to_compile));
+	memset(array::begin(results), 0, array::size(results) * sizeof(bool));
+
+	compile_resources(vector::begin(to_compile), array::begin(results), num_resources, data_dir, platform);
+
 	bool success = true;
+	for (u32 i = 0; i < num_resources; ++i)
+		success = success && results[i];
+
+	if (success)
+	{
+		compile_resources(vector::begin(to_compile) + num_resources
+			, array::begin(results) + num_resources
+			, vector::size(to_compile) - num_resources
+			, data_dir
+			, platform
+			);
+	}
+
+	// Dependencies of the compiled resources may have changed.
+	hash_map::clear(_keys);
 
-	// Compile all changed resources
+	// Update the state in the same order regardless of the order in which
+	// the resources have been compiled.
 	for (u32 i = 0; i < vector::size(to_compile); ++i)
 	{
 		const DynamicString& src_path = to_compile[i];
-		const char* filename = src_path.c_str();
-		const char* type = path::extension(filename);
 
-		if (type == NULL)
+		if (!results[i])
+		{
+			// Compile it again next time even if nothing changes.
+			hash_map::remove(_data_keys, resource_id(src_path.c_str()));
+			success = false;
 			continue;
+		}
 
 		TempAllocator1024 ta;
 		DynamicString path(ta);
-
-		// Build destination file path
-		ResourceId id = resource_id(filename);
+		ResourceId id = resource_id(src_path.c_str());
 		destination_path(path, id);
 
-		logi(DATA_COMPILER, "%s", src_path.c_str());
+		DynamicString type_str(ta);
+		type_str = path::extension(src_path.c_str());
 
-		// Compile data
-		ResourceTypeData rtd;
-		rtd.version = 0;
-		rtd.compiler = NULL;
+		const u64 key = compile_key(src_path, id, platform);
+		hash_map::set(_data_index, id, src_path);
+		hash_map::set(_data_versions, type_str, data_version(type_str.c_str()));
+		hash_map::set(_data_keys, id, key);
+		store_to_cache(data_fs, id, key);
+	}
 
-		DynamicString type_str(ta);
-		type_str = type;
+	prune_cache(data_fs, u64(CROWN_CACHE_MAX_SIZE));
 
-		rtd = hash_map::get(_compilers, type_str, rtd);
-		{
-			// Reset dependencies and references since data could not depend
-			// anymore on any of those.
-			HashMap<DynamicString, u32> dependencies_deffault(default_allocator());
-			hash_map::clear(hash_map::get(_data_dependencies, id, dependencies_deffault));
-			HashMap<DynamicString, u32> requirements_deffault(default_allocator());
-			hash_map::clear(hash_map::get(_data_requirements, id, requirements_deffault));
-
-			// Compile data
-			Buffer output(default_allocator());
-			CompileOptions opts(*this, data_fs, id, src_path, output, platform);
-			success = rtd.compiler(opts) == 0;
-
-			if (success)
-			{
-				File* outf = data_fs.open(path.c_str(), FileOpenMode::WRITE);
-				u32 size = array::size(output);
-				u32 written = outf->write(array::begin(output), size);
-				data_fs.close(*outf);
-				success = size == written;
-			}
-		}
+	if (!success)
+		loge(DATA_COMPILER, "Failed to compile data");
 
-		if (success)
-		{
-			hash_map::set(_data_index, id, src_path);
-			hash_map::set(_data_versions, type_str, rtd.version);
-			hash_map::set(_data_mtimes, id, data_fs.last_modified_time(path.c_str()));
-		}
+	if (success)
+	{
+		if (vector::size(to_compile) || num_restored)
+			logi(DATA_COMPILER, "Compiled data in %.2fs (%u restored from cache)", time::seconds(time::now() - time_start), num_restored);
 		else
-		{
-			loge(DATA_COMPILER, "Failed to compile data");
+			logi(DATA_COMPILER, "Data is up to date");
+	}
+
+	return success;
+}
+
+struct CompileJobs
+{
+	DataCompiler* data_compiler;
+	const DynamicString* paths;
+	bool* results;
+	u32 num;
+	const char* data_dir;
+	const char* platform;
+	AtomicInt next;
+	AtomicInt failed;
+
+	CompileJobs()
+		: next(0)
+		, failed(0)
+	{
+	}
+};
+
+static s32 compile_jobs(void* user_data)
+{
+	CompileJobs* jobs = (CompileJobs*)user_data;
+
+	FilesystemDisk data_fs(default_allocator());
+	data_fs.set_prefix(jobs->data_dir);
+
+	// Stop picking new resources as soon as one fails to compile.
+	while (jobs->failed.load() == 0)
+	{
+		const s32 i = jobs->next.fetch_add(1);
+		if (i >= (s32)jobs->num)
 			break;
-		}
+
+		jobs->results[i] = jobs->data_compiler->compile_resource(data_fs, jobs->paths[i], jobs->platform);
+		if (!jobs->results[i])
+			jobs->failed.store(1);
 	}
 
+	return 0;
+}
+
+void DataCompiler::compile_resources(const DynamicString* paths, bool* results, u32 num, const char* data_dir, const char* platform)
+{
+	CompileJobs jobs;
+	jobs.data_compiler = this;
+	jobs.paths         = paths;
+	jobs.results       = results;
+	jobs.num           = num;
+	jobs.data_dir      = data_dir;
+	jobs.platform      = platform;
+
+	// The calling thread runs jobs too.
+	const u32 num_threads = min(num, _num_jobs) > 0 ? min(num, _num_jobs) - 1 : 0;
+	Thread threads[CROWN_MAX_COMPILE_JOBS];
+	for (u32 i = 0; i < num_threads; ++i)
+		threads[i].start(compile_jobs, &jobs);
+
+	compile_jobs(&jobs);
+
+	for (u32 i = 0; i < num_threads; ++i)
+		threads[i].stop();
+}
+
+bool DataCompiler::compile_resource(FilesystemDisk& data_fs, const DynamicString& src_path, const char* platform)
+{
+	const char* filename = src_path.c_str();
+	const char* type = path::extension(filename);
+
+	TempAllocator1024 ta;
+	DynamicString path(ta);
+
+	// Build destination file path
+	ResourceId id = resource_id(filename);
+	destination_path(path, id);
+
+	logi(DATA_COMPILER, "%s", filename);
+
+	DynamicString type_str(ta);
+	type_str = type;
+
+	ResourceTypeData rtd;
+	rtd.version = 0;
+	rtd.compiler = NULL;
+	rtd = hash_map::get(_compilers, type_str, rtd);
+
+	// Compile data
+	Buffer output(default_allocator());
+	CompileOptions opts(*this, data_fs, id, src_path, output, platform);
+	bool success = rtd.compiler(opts) == 0;
+
 	if (success)
 	{
-		if (vector::size(to_compile))
-			logi(DATA_COMPILER, "Compiled data in %.2fs", time::seconds(time::now() - time_start));
-		else
-			logi(DATA_COMPILER, "Data is up to date");
+		File* outf = data_fs.open(path.c_str(), FileOpenMode::WRITE);
+		u32 size = array::size(output);
+		u32 written = outf->write(array::begin(output), size);
+		data_fs.close(*outf);
+		success = size == written;
 	}
 
 	return success;
@@ -952,6 +1609,9 @@ u32 DataCompiler::data_version_stored(const char* type)
 
 void DataCompiler::add_dependency_internal(HashMap<StringId64, HashMap<DynamicString, u32> >& dependencies, ResourceId id, const char* dependency)
 {
+	ScopedMutex sm(_mutex);
+	_dependents_changed = true;
+
 	HashMap<DynamicString, u32> deps_deffault(default_allocator());
 	if (hash_map::has(dependencies, id))
 	{
@@ -8,6 +8,7 @@
 #include "core/containers/types.h"
 #include "core/filesystem/file_monitor.h"
 #include "core/filesystem/filesystem_disk.h"
+#include "core/thread/mutex.h"
 #include "device/console_server.h"
 #include "device/device_options.h"
 #include "resource/resource_id.h"
@@ -35,6 +36,12 @@ struct SourceIndex
 
 /// Compiles source data into binary.
 ///
+/// A resource is compiled again only when its compile key changes. The key
+/// hashes the content of the resource and of all its dependencies, the
+/// version of their compilers and the target platform. Compiled data is also
+/// kept in a local cache indexed by key, so that resources whose inputs match
+/// a previous compilation are copied from there instead of being compiled.
+///
 /// @ingroup Resource
 struct DataCompiler
 {
@@ -46,6 +53,12 @@ struct DataCompiler
 		CompileFunction compiler;
 	};
 
+	struct SourceHash
+	{
+		u64 mtime; ///< Modification time of the source when it was hashed.
+		u64 hash;
+	};
+
 	const DeviceOptions* _options;
 	ConsoleServer* _console_server;
 	FilesystemDisk _source_fs;
@@ -53,12 +66,19 @@ struct DataCompiler
 	HashMap<DynamicString, ResourceTypeData> _compilers;
 	Vector<DynamicString> _globs;
 	HashMap<StringId64, DynamicString> _data_index;
-	HashMap<StringId64, u64> _data_mtimes;
+	HashMap<StringId64, u64> _data_keys;
+	HashMap<DynamicString, SourceHash> _source_hashes;
+	HashMap<StringId64, u64> _keys; ///< Compile keys computed during the current compilation.
+	HashMap<DynamicString, Array<StringId64> > _data_dependents; ///< Resources that depend on each file.
+	HashMap<DynamicString, Array<StringId64> > _data_requirers;  ///< Resources that require each file.
+	bool _dependents_changed;                                   ///< Whether the maps above must be rebuilt.
 	HashMap<StringId64, HashMap<DynamicString, u32> > _data_dependencies;
 	HashMap<StringId64, HashMap<DynamicString, u32> > _data_requirements;
 	HashMap<DynamicString, u32> _data_versions;
 	FileMonitor _file_monitor;
 	SourceIndex _source_index;
+	u32 _num_jobs;
+	Mutex _mutex; ///< Guards the dependencies and requirements while compiling.
 
 	void add_file(const char* path);
 	void remove_file(const char* path);
@@ -94,6 +114,14 @@ struct DataCompiler
 	/// Returns true on success, false otherwise.
 	bool compile(const char* data_dir, const char* platform);
 
+	/// Compiles the resources @a paths [0 .. num) concurrently on up to _num_jobs
+	/// threads and stores whether each one succeeded in @a results.
+	void compile_resources(const DynamicString* paths, bool* results, u32 num, const char* data_dir, const char* platform);
+
+	/// Compiles the resource @a src_path and writes it in @a data_fs.
+	/// Returns true on success, false otherwise.
+	bool compile_resource(FilesystemDisk& data_fs, const DynamicString& src_path, const char* platform);
+
 	/// Registers the resource @a compiler for the given resource @a type and @a version.
 	void register_compiler(const char* type, u32 version, CompileFunction compiler);
 
@@ -116,11 +144,45 @@ struct DataCompiler
 	///
 	void add_requirement(ResourceId id, const char* requirement);
 
-	///
-	bool dependency_changed(const DynamicString& src_path, ResourceId id, u64 mtime);
+	/// Rebuilds the reverse dependency graph if dependencies or requirements
+	/// changed since the last time.
+	void update_dependents();
 
-	///
-	bool version_changed(const DynamicString& src_path, ResourceId id);
+	/// Appends to @a changed the source files that have been added, modified or
+	/// removed since the last call, plus the sources whose compiler version changed.
+	void changed_sources(Vector<DynamicString>& changed);
+
+	/// Fills @a rebuilt with the resources that must be compiled again when the
+	/// files @a changed change, visiting each resource at most once.
+	void invalidated(HashMap<StringId64, u32>& rebuilt, const Vector<DynamicString>& changed);
+
+	/// Fills @a paths with the source paths of the resources, sorted by name,
+	/// that a change to @a path will compile again.
+	void rebuilds(Vector<DynamicString>& paths, const char* path);
+
+	/// Returns the hash of the content of the source file @a path.
+	/// Files are hashed again only when their modification time changes.
+	u64 source_hash(const DynamicString& path);
+
+	/// Returns the compile key of the resource @a id whose source is @a src_path.
+	u64 compile_key(const DynamicString& src_path, ResourceId id, const char* platform);
+
+	/// Returns a key that changes whenever the requirements of @a id, or any of
+	/// their requirements, change.
+	u64 requirements_key(ResourceId id, HashMap<StringId64, u32>& visited, const char* platform);
+
+	/// Copies the data compiled with the given @a key from the cache to the
+	/// destination of @a id. Returns true on success, false if there is no
+	/// such data in the cache.
+	bool restore_from_cache(FilesystemDisk& data_fs, ResourceId id, u64 key);
+
+	/// Stores the compiled data of @a id, its dependencies and its requirements
+	/// in the cache.
+	void store_to_cache(FilesystemDisk& data_fs, ResourceId id, u64 key);
+
+	/// Deletes the oldest entries of the cache until it takes no more than
+	/// @a max_size bytes.
+	void prune_cache(FilesystemDisk& data_fs, u64 max_size);
 
 	/// Returns whether the @a path should be ignored because
 	/// it matches a pattern from the CROWN_DATAIGNORE file or
@@ -131,6 +193,7 @@ struct DataCompiler
 	void error(const char* msg, va_list args);
 
 	static const u32 COMPILER_NOT_FOUND = UINT32_MAX;
+	static const u32 CACHE_VERSION = 0x63650001; ///< Magic number and version of the layout of cache entries.
 };
 
 int main_data_compiler(const DeviceOptions& opts);
@@ -96,6 +96,35 @@ namespace expression_language
 		#undef PUSH
 	}
 
+	/// Computes the function specified by @a op_code on the columns of @a num
+	/// floats at the top of the @a stack.
+	static inline void compute_function(OpCode op_code, unsigned num, Stack &stack)
+	{
+		#define ARG(i) (stack.data + stack.size - (i)*num)
+		#define CHECK_ARITY(n) CE_ASSERT(stack.size >= (n)*num, "Stack underflow")
+
+		float *a, *b, *c, *d;
+
+		switch(op_code) {
+			case OP_ADD: CHECK_ARITY(2); b=ARG(1); a=ARG(2); for (unsigned k=0; k<num; ++k) a[k] += b[k]; stack.size -= num; break;
+			case OP_SUB: CHECK_ARITY(2); b=ARG(1); a=ARG(2); for (unsigned k=0; k<num; ++k) a[k] -= b[k]; stack.size -= num; break;
+			case OP_MUL: CHECK_ARITY(2); b=ARG(1); a=ARG(2); for (unsigned k=0; k<num; ++k) a[k] *= b[k]; stack.size -= num; break;
+			case OP_DIV: CHECK_ARITY(2); b=ARG(1); a=ARG(2); for (unsigned k=0; k<num; ++k) a[k] /= b[k]; stack.size -= num; break;
+			case OP_UNARY_MINUS: CHECK_ARITY(1); a=ARG(1); for (unsigned k=0; k<num; ++k) a[k] = -a[k]; break;
+			case OP_SIN: CHECK_ARITY(1); a=ARG(1); for (unsigned k=0; k<num; ++k) a[k] = fsin(a[k]); break;
+			case OP_COS: CHECK_ARITY(1); a=ARG(1); for (unsigned k=0; k<num; ++k) a[k] = fcos(a[k]); break;
+			case OP_ABS: CHECK_ARITY(1); a=ARG(1); for (unsigned k=0; k<num; ++k) a[k] = fabs(a[k]); break;
+			case OP_MATCH: CHECK_ARITY(2); b=ARG(1); a=ARG(2); for (unsigned k=0; k<num; ++k) a[k] = match(a[k], b[k]); stack.size -= num; break;
+			case OP_MATCH_2D: CHECK_ARITY(4); d=ARG(1); c=ARG(2); b=ARG(3); a=ARG(4); for (unsigned k=0; k<num; ++k) a[k] = match2d(a[k], b[k], c[k], d[k]); stack.size -= 3*num; break;
+			case OP_NOP: break;
+			default:
+				CE_FATAL("Unknown opcode");
+		}
+
+		#undef CHECK_ARITY
+		#undef ARG
+	}
+
 	/// Union to cast through to convert between float and unsigned.
 	union FloatAndUnsigned
 	{
@@ -131,6 +160,48 @@ namespace expression_language
 		}
 	}
 
+	bool run(const unsigned *byte_code, const float *variables, unsigned stride, unsigned num, Stack &stack)
+	{
+		const unsigned *p = byte_code;
+		while (true) {
+			unsigned bc = *p++;
+			unsigned op = bc_mask(bc);
+			unsigned id = id_mask(bc);
+			switch (op) {
+				case BC_PUSH_VAR:
+					if (stack.capacity - stack.size < num) return false;
+					memcpy(stack.data + stack.size, variables + id*stride, sizeof(float)*num);
+					stack.size += num;
+					break;
+				case BC_FUNCTION:
+					compute_function((OpCode)id, num, stack);
+					break;
+				case BC_END:
+					return true;
+				default: { // BC_PUSH_FLOAT
+					if (stack.capacity - stack.size < num) return false;
+					const float f = unsigned_to_float(bc);
+					for (unsigned k=0; k<num; ++k)
+						stack.data[stack.size + k] = f;
+					stack.size += num;
+					break;
+				}
+			}
+		}
+	}
+
+	unsigned variables_mask(const unsigned *byte_code)
+	{
+		unsigned mask = 0;
+		for (const unsigned *p = byte_code; *p != BC_END; ++p) {
+			if (bc_mask(*p) == BC_PUSH_VAR) {
+				const unsigned id = id_mask(*p);
+				mask |= 1u << (id < 31 ? id : 31);
+			}
+		}
+		return mask;
+	}
+
 } // namespace expression_language
 
 #if CROWN_CAN_COMPILE
@@ -290,10 +361,52 @@ namespace expression_language
 		return num_tokens + overflow_tokens;
 	}
 
+	/// Returns the index of the first token of the operand which ends with the
+	/// token at index @a last in the program @a rpl.
+	static unsigned operand_start(const Token *rpl, unsigned last, const CompileEnvironment &env)
+	{
+		int needed = 1;
+		unsigned i = last + 1;
+		while (needed > 0) {
+			CE_ASSERT(i > 0, "Too few arguments to function");
+			const Token &t = rpl[--i];
+			if (t.type == Token::FUNCTION) {
+				const Function &f = env.function_values[t.id];
+				needed += int(f.arity) - (f.op_code == OP_NOP ? 0 : 1);
+			} else {
+				--needed;
+			}
+		}
+		return i;
+	}
+
+	/// Returns whether @a t is the identity element of the binary operation @a op_code
+	/// when used as its right operand.
+	static bool is_identity(OpCode op_code, const Token &t)
+	{
+		if (t.type != Token::NUMBER)
+			return false;
+
+		switch (op_code) {
+			case OP_ADD: case OP_SUB: return t.value == 0.0f;
+			case OP_MUL: case OP_DIV: return t.value == 1.0f;
+			default: return false;
+		}
+	}
+
+	/// Removes the tokens at index @a a and @a b (with @a a < @a b) from the program @a rpl.
+	static void remove_tokens(Token *rpl, unsigned &num_tokens, unsigned a, unsigned b)
+	{
+		memmove(&rpl[a], &rpl[a+1], sizeof(Token)*(b-a-1));
+		memmove(&rpl[b-1], &rpl[b+1], sizeof(Token)*(num_tokens-b-1));
+		num_tokens -= 2;
+	}
+
 	/// Performs constant folding on the program represented by @a rpl which is a
 	/// sequence of tokens in reverse polish notation. Any function found in the
 	/// token stream which only takes constant arguments is replaced by the
-	/// result of evaluating the function over the constant arguments.
+	/// result of evaluating the function over the constant arguments. Additions
+	/// of zero and multiplications by one are removed.
 	static void fold_constants(Token *rpl, unsigned &num_tokens, CompileEnvironment &env)
 	{
 		static const int MAX_ARITY = 4;
@@ -314,8 +427,27 @@ namespace expression_language
 				constant_arguments = constant_arguments && rpl[i-j-1].type == Token::NUMBER;
 				stack.data[j] = rpl[arg_start+j].value;
 			}
-			if (!constant_arguments)
+			if (!constant_arguments) {
+				if (arity != 2)
+					continue;
+
+				// x op identity
+				if (is_identity(f.op_code, rpl[i-1])) {
+					remove_tokens(rpl, num_tokens, i-1, i);
+					i -= 2;
+					continue;
+				}
+
+				// identity op x, for commutative operations
+				if (f.op_code == OP_ADD || f.op_code == OP_MUL) {
+					const unsigned x = operand_start(rpl, i-1, env);
+					if (x > 0 && is_identity(f.op_code, rpl[x-1])) {
+						remove_tokens(rpl, num_tokens, x-1, i);
+						i -= 2;
+					}
+				}
 				continue;
+			}
 
 			stack.size = arity;
 			compute_function(f.op_code, stack);
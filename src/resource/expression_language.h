@@ -52,6 +52,17 @@ namespace expression_language
 	/// They should match the list of variable names supplied to the compile function.
 	bool run(const unsigned *byte_code, const float *variables, Stack &stack);
 
+	/// Runs the @a byte_code once for each of @a num instances in a single pass.
+	/// The variables are stored in columns: the value of variable i for instance j
+	/// is @a variables[i*stride + j]. Each element of the @a stack is a column of
+	/// @a num floats, so when the function returns, the results of the last
+	/// expression are in stack.data[stack.size - num ... stack.size - 1].
+	bool run(const unsigned *byte_code, const float *variables, unsigned stride, unsigned num, Stack &stack);
+
+	/// Returns a mask of the variables read by the @a byte_code: bit i is set if
+	/// the variable i is read. Variables from 31 upwards all map to bit 31.
+	unsigned variables_mask(const unsigned *byte_code);
+
 } // namespace expression_language
 
 #if CROWN_CAN_COMPILE
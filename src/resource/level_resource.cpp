@@ -13,7 +13,9 @@
 #include "core/strings/dynamic_string.inl"
 #include "resource/compile_options.h"
 #include "resource/level_resource.h"
+#include "resource/types.h"
 #include "resource/unit_compiler.h"
+#include "world/physics.h"
 
 namespace crown
 {
@@ -43,9 +45,14 @@ namespace level_resource
 
 } // namespace level_resource
 
-#if CROWN_CAN_COMPILE
 namespace level_resource_internal
 {
+	void offline(StringId64 id, ResourceManager& /*rm*/)
+	{
+		physics_globals::resource_offline(RESOURCE_TYPE_LEVEL, id);
+	}
+
+#if CROWN_CAN_COMPILE
 	s32 compile(CompileOptions& opts)
 	{
 		Buffer buf = opts.read();
@@ -122,8 +129,8 @@ namespace level_resource_internal
 
 		return 0;
 	}
+#endif // CROWN_CAN_COMPILE
 
 } // namespace level_resource_internal
-#endif // CROWN_CAN_COMPILE
 
 } // namespace crown
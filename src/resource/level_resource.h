@@ -39,6 +39,7 @@ struct LevelSound
 namespace level_resource_internal
 {
 	s32 compile(CompileOptions& opts);
+	void offline(StringId64 id, ResourceManager& rm);
 
 } // namespace level_resource_internal
 
@@ -14,6 +14,7 @@
 #include "core/math/constants.h"
 #include "core/math/quaternion.inl"
 #include "core/math/sphere.inl"
+#include "core/math/vector2.inl"
 #include "core/memory/temp_allocator.inl"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string.inl"
@@ -21,6 +22,14 @@
 #include "resource/compile_options.h"
 #include "resource/physics_resource.h"
 #include "world/types.h"
+#include <string.h> // memcpy
+#if CROWN_CAN_COMPILE && CROWN_PHYSICS_BULLET
+	#include <BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h>
+	#include <BulletCollision/CollisionShapes/btConvexHullShape.h>
+	#include <BulletCollision/CollisionShapes/btOptimizedBvh.h>
+	#include <BulletCollision/CollisionShapes/btShapeHull.h>
+	#include <BulletCollision/CollisionShapes/btTriangleIndexVertexArray.h>
+#endif
 
 namespace crown
 {
@@ -153,6 +162,124 @@ namespace physics_resource_internal
 		sd.box.half_size = (aabb.max - aabb.min) * 0.5f;
 	}
 
+	/// Replaces @a points with the vertices of their simplified convex hull.
+	void cook_convex_hull(Array<Vector3>& points)
+	{
+#if CROWN_PHYSICS_BULLET
+		btConvexHullShape shape((btScalar*)array::begin(points), (int)array::size(points), sizeof(Vector3));
+		// Sample the hull without margin: the runtime shape adds its own.
+		shape.setMargin(0.0f);
+		btShapeHull hull(&shape);
+		if (!hull.buildHull(0.0f))
+			return;
+
+		const btVector3* vertices = hull.getVertexPointer();
+		array::resize(points, (u32)hull.numVertices());
+		for (u32 i = 0; i < array::size(points); ++i)
+			points[i] = vector3(vertices[i].x(), vertices[i].y(), vertices[i].z());
+#else
+		CE_UNUSED(points);
+#endif // CROWN_PHYSICS_BULLET
+	}
+
+#if CROWN_PHYSICS_BULLET
+	/// Gives access to the quantization parameters of the BVH.
+	struct CookedBvh : public btOptimizedBvh
+	{
+		/// Writes the BVH to @a output as a MeshBvh.
+		void write(Array<char>& output) const
+		{
+			MeshBvh mb;
+			mb.aabb_min       = vector3(m_bvhAabbMin.x(), m_bvhAabbMin.y(), m_bvhAabbMin.z());
+			mb.aabb_max       = vector3(m_bvhAabbMax.x(), m_bvhAabbMax.y(), m_bvhAabbMax.z());
+			mb.quantization   = vector3(m_bvhQuantization.x(), m_bvhQuantization.y(), m_bvhQuantization.z());
+			mb.num_nodes      = (u32)m_quantizedContiguousNodes.size();
+			mb.num_subtrees   = (u32)m_SubtreeHeaders.size();
+			mb.cur_node_index = (u32)m_curNodeIndex;
+			mb.traversal_mode = (u32)m_traversalMode;
+			array::push(output, (char*)&mb, sizeof(mb));
+
+			for (int i = 0; i < m_quantizedContiguousNodes.size(); ++i)
+			{
+				const btQuantizedBvhNode& node = m_quantizedContiguousNodes[i];
+
+				btQuantizedBvhNodeData nd;
+				memcpy(nd.m_quantizedAabbMin, node.m_quantizedAabbMin, sizeof(nd.m_quantizedAabbMin));
+				memcpy(nd.m_quantizedAabbMax, node.m_quantizedAabbMax, sizeof(nd.m_quantizedAabbMax));
+				nd.m_escapeIndexOrTriangleIndex = node.m_escapeIndexOrTriangleIndex;
+				array::push(output, (char*)&nd, sizeof(nd));
+			}
+
+			for (int i = 0; i < m_SubtreeHeaders.size(); ++i)
+			{
+				const btBvhSubtreeInfo& subtree = m_SubtreeHeaders[i];
+
+				btBvhSubtreeInfoData info;
+				info.m_rootNodeIndex = subtree.m_rootNodeIndex;
+				info.m_subtreeSize   = subtree.m_subtreeSize;
+				memcpy(info.m_quantizedAabbMin, subtree.m_quantizedAabbMin, sizeof(info.m_quantizedAabbMin));
+				memcpy(info.m_quantizedAabbMax, subtree.m_quantizedAabbMax, sizeof(info.m_quantizedAabbMax));
+				array::push(output, (char*)&info, sizeof(info));
+			}
+		}
+	};
+#endif // CROWN_PHYSICS_BULLET
+
+	/// Builds the quantized BVH of the triangle mesh and writes it to @a bvh
+	/// as a MeshBvh. @a bvh is left empty if cooking is not available and the
+	/// runtime will build the BVH itself.
+	void cook_mesh(Array<char>& bvh, const Array<Vector3>& points, const Array<u16>& indices)
+	{
+#if CROWN_PHYSICS_BULLET
+		btIndexedMesh part;
+		part.m_vertexBase          = (const unsigned char*)array::begin(points);
+		part.m_vertexStride        = sizeof(Vector3);
+		part.m_numVertices         = array::size(points);
+		part.m_triangleIndexBase   = (const unsigned char*)array::begin(indices);
+		part.m_triangleIndexStride = sizeof(u16)*3;
+		part.m_numTriangles        = array::size(indices)/3;
+		part.m_indexType           = PHY_SHORT;
+
+		btTriangleIndexVertexArray vertex_array;
+		vertex_array.addIndexedMesh(part, PHY_SHORT);
+
+		// Build the BVH within the same bounds as btBvhTriangleMeshShape.
+		btBvhTriangleMeshShape shape(&vertex_array, true, false);
+		CookedBvh cooked;
+		cooked.build(&vertex_array, true, shape.getLocalAabbMin(), shape.getLocalAabbMax());
+		cooked.write(bvh);
+#else
+		CE_UNUSED(bvh);
+		CE_UNUSED(points);
+		CE_UNUSED(indices);
+#endif // CROWN_PHYSICS_BULLET
+	}
+
+	void compile_heightfield(Array<s16>& samples, const Array<f32>& heights, ColliderDesc& sd)
+	{
+		f32 height_min = heights[0];
+		f32 height_max = heights[0];
+		for (u32 i = 1; i < array::size(heights); ++i)
+		{
+			height_min = min(height_min, heights[i]);
+			height_max = max(height_max, heights[i]);
+		}
+
+		const f32 range = height_max - height_min;
+		const f32 step  = range > 0.0f ? range / 65535.0f : 1.0f;
+
+		array::resize(samples, array::size(heights));
+		for (u32 i = 0; i < array::size(heights); ++i)
+		{
+			const f32 q = (heights[i] - height_min) / step + 0.5f;
+			samples[i] = (s16)((s32)min(q, 65535.0f) - 32768);
+		}
+
+		sd.heightfield.height_scale = step;
+		sd.heightfield.height_min   = height_min;
+		sd.heightfield.height_max   = height_min + 65535.0f*step;
+	}
+
 	s32 compile_collider(Buffer& output, const char* json, CompileOptions& opts)
 	{
 		TempAllocator4096 ta;
@@ -239,26 +366,30 @@ namespace physics_resource_internal
 				array::push_back(point_indices, (u16)sjson::parse_int(position_indices[i]));
 			}
 
+			Array<char> bvh(default_allocator());
+
 			switch (cd.type)
 			{
 			case ColliderType::SPHERE:      compile_sphere(points, cd); break;
 			case ColliderType::CAPSULE:     compile_capsule(points, cd); break;
 			case ColliderType::BOX:         compile_box(points, cd); break;
-			case ColliderType::CONVEX_HULL: break;
-			case ColliderType::MESH:        break;
+			case ColliderType::CONVEX_HULL: cook_convex_hull(points); break;
+			case ColliderType::MESH:        cook_mesh(bvh, points, point_indices); break;
 			case ColliderType::HEIGHTFIELD:
-				DATA_COMPILER_ASSERT(false, opts, "Not implemented yet");
+				DATA_COMPILER_ASSERT(false, opts, "Heightfields must be specified with collider_data");
 				break;
 			}
 
 			const u32 num_points  = array::size(points);
 			const u32 num_indices = array::size(point_indices);
+			const u32 bvh_size    = array::size(bvh);
 
 			const bool needs_points = cd.type == ColliderType::CONVEX_HULL
 				|| cd.type == ColliderType::MESH;
 
 			cd.size += (needs_points ? sizeof(u32) + sizeof(Vector3)*array::size(points) : 0);
 			cd.size += (cd.type == ColliderType::MESH ? sizeof(u32) + sizeof(u16)*array::size(point_indices) : 0);
+			cd.size += (cd.type == ColliderType::MESH ? sizeof(u32) + bvh_size : 0);
 
 			array::push(output, (char*)&cd, sizeof(cd));
 
@@ -271,6 +402,8 @@ namespace physics_resource_internal
 			{
 				array::push(output, (char*)&num_indices, sizeof(num_indices));
 				array::push(output, (char*)array::begin(point_indices), sizeof(u16)*array::size(point_indices));
+				array::push(output, (char*)&bvh_size, sizeof(bvh_size));
+				array::push(output, array::begin(bvh), bvh_size);
 			}
 
 		} else {
@@ -295,6 +428,70 @@ namespace physics_resource_internal
 			} else if (cd.type == ColliderType::CAPSULE) {
 				cd.capsule.radius = sjson::parse_float(collider_data["radius"]);
 				cd.capsule.height = sjson::parse_float(collider_data["height"]);
+			} else if (cd.type == ColliderType::HEIGHTFIELD) {
+				const u32 width  = sjson::parse_int(collider_data["width"]);
+				const u32 length = sjson::parse_int(collider_data["length"]);
+				DATA_COMPILER_ASSERT(width > 1 && length > 1
+					, opts
+					, "Heightfield must have at least 2x2 samples"
+					);
+
+				Array<f32> heights(default_allocator());
+				if (json_object::has(collider_data, "heights"))
+				{
+					JsonArray samples(ta);
+					sjson::parse_array(samples, collider_data["heights"]);
+					for (u32 i = 0; i < array::size(samples); ++i)
+						array::push_back(heights, sjson::parse_float(samples[i]));
+				}
+				else
+				{
+					// Raw grid of 16-bit unsigned little-endian samples, as
+					// exported by most terrain editors.
+					DynamicString raw(ta);
+					sjson::parse_string(raw, collider_data["raw"]);
+					DATA_COMPILER_ASSERT_FILE_EXISTS(raw.c_str(), opts);
+
+					const f32 height_min = sjson::parse_float(collider_data["height_min"]);
+					const f32 height_max = sjson::parse_float(collider_data["height_max"]);
+
+					Buffer file = opts.read(raw.c_str());
+					const u8* data = (const u8*)array::begin(file);
+					for (u32 i = 0; i < array::size(file)/2; ++i)
+					{
+						const u16 sample = u16(data[i*2 + 0] | (data[i*2 + 1] << 8));
+						array::push_back(heights, height_min + (height_max - height_min) * (f32)sample / 65535.0f);
+					}
+				}
+
+				DATA_COMPILER_ASSERT(array::size(heights) == width*length
+					, opts
+					, "Heightfield must have %u samples, found %u"
+					, width*length
+					, array::size(heights)
+					);
+
+				Array<s16> samples(default_allocator());
+				compile_heightfield(samples, heights, cd);
+
+				cd.heightfield.width     = width;
+				cd.heightfield.length    = length;
+				cd.heightfield.cell_size = json_object::has(collider_data, "cell_size")
+					? sjson::parse_vector2(collider_data["cell_size"])
+					: vector2(1.0f, 1.0f)
+					;
+
+				const u32 samples_size = sizeof(s16)*array::size(samples);
+				cd.size = (samples_size + 3) & ~3;
+
+				array::push(output, (char*)&cd, sizeof(cd));
+				array::push(output, (char*)array::begin(samples), samples_size);
+				if (cd.size != samples_size)
+				{
+					const s16 pad = 0;
+					array::push(output, (char*)&pad, sizeof(pad));
+				}
+				return 0;
 			}
 
 			array::push(output, (char*)&cd, sizeof(cd));
@@ -322,6 +519,8 @@ namespace physics_resource_internal
 		ar.flags |= (json_object::has(obj, "lock_rotation_x") && sjson::parse_bool(obj["lock_rotation_x"])) ? ActorFlags::LOCK_ROTATION_X : 0;
 		ar.flags |= (json_object::has(obj, "lock_rotation_y") && sjson::parse_bool(obj["lock_rotation_y"])) ? ActorFlags::LOCK_ROTATION_Y : 0;
 		ar.flags |= (json_object::has(obj, "lock_rotation_z") && sjson::parse_bool(obj["lock_rotation_z"])) ? ActorFlags::LOCK_ROTATION_Z : 0;
+		ar.flags |= (json_object::has(obj, "report_collisions") && sjson::parse_bool(obj["report_collisions"])) ? ActorFlags::REPORT_COLLISIONS : 0;
+		ar.flags |= (json_object::has(obj, "report_contacts") && sjson::parse_bool(obj["report_contacts"])) ? ActorFlags::REPORT_CONTACTS | ActorFlags::REPORT_COLLISIONS : 0;
 
 		array::push(output, (char*)&ar, sizeof(ar));
 
@@ -420,11 +619,14 @@ namespace physics_config_resource_internal
 			pa.name = StringId32(key.data(), key.length());
 			pa.linear_damping  = 0.0f;
 			pa.angular_damping = 0.0f;
+			pa.max_linear_velocity = 0.0f;
 
 			if (json_object::has(actor, "linear_damping"))
 				pa.linear_damping = sjson::parse_float(actor["linear_damping"]);
 			if (json_object::has(actor, "angular_damping"))
 				pa.angular_damping = sjson::parse_float(actor["angular_damping"]);
+			if (json_object::has(actor, "max_linear_velocity"))
+				pa.max_linear_velocity = sjson::parse_float(actor["max_linear_velocity"]);
 
 			pa.flags = 0;
 			pa.flags |= (json_object::has(actor, "dynamic")         && sjson::parse_bool(actor["dynamic"])        ) ? PhysicsActor::DYNAMIC         : 0;
@@ -551,6 +753,40 @@ namespace physics_config_resource_internal
 		pcr.num_materials = array::size(materials);
 		pcr.num_actors    = array::size(actors);
 		pcr.num_filters   = array::size(cfc._filters);
+		pcr.step_time     = 1.0f/60.0f;
+		pcr.max_substeps  = 4;
+		pcr.max_lag       = 0.25f;
+		pcr.flags         = PhysicsConfigResource::INTERPOLATE;
+
+		// Parse simulation settings
+		if (json_object::has(obj, "simulation"))
+		{
+			JsonObject simulation(ta);
+			sjson::parse(simulation, obj["simulation"]);
+
+			if (json_object::has(simulation, "step_frequency"))
+			{
+				const f32 frequency = sjson::parse_float(simulation["step_frequency"]);
+				DATA_COMPILER_ASSERT(frequency > 0.0f
+					, opts
+					, "Step frequency must be positive"
+					);
+				pcr.step_time = 1.0f/frequency;
+			}
+			if (json_object::has(simulation, "max_substeps"))
+			{
+				const s32 max_substeps = sjson::parse_int(simulation["max_substeps"]);
+				DATA_COMPILER_ASSERT(max_substeps > 0
+					, opts
+					, "Max substeps must be positive"
+					);
+				pcr.max_substeps = (u32)max_substeps;
+			}
+			if (json_object::has(simulation, "max_lag"))
+				pcr.max_lag = sjson::parse_float(simulation["max_lag"]);
+			if (json_object::has(simulation, "interpolate") && !sjson::parse_bool(simulation["interpolate"]))
+				pcr.flags &= ~PhysicsConfigResource::INTERPOLATE;
+		}
 
 		u32 offt = sizeof(PhysicsConfigResource);
 		pcr.materials_offset = offt;
@@ -570,6 +806,10 @@ namespace physics_config_resource_internal
 		opts.write(pcr.actors_offset);
 		opts.write(pcr.num_filters);
 		opts.write(pcr.filters_offset);
+		opts.write(pcr.step_time);
+		opts.write(pcr.max_substeps);
+		opts.write(pcr.max_lag);
+		opts.write(pcr.flags);
 
 		// Write materials
 		for (u32 i = 0; i < pcr.num_materials; ++i)
@@ -586,6 +826,7 @@ namespace physics_config_resource_internal
 			opts.write(actors[i].name._id);
 			opts.write(actors[i].linear_damping);
 			opts.write(actors[i].angular_damping);
+			opts.write(actors[i].max_linear_velocity);
 			opts.write(actors[i].flags);
 		}
 
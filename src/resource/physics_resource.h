@@ -15,16 +15,26 @@
 
 namespace crown
 {
+struct ColliderDesc;
+
 namespace physics_resource_internal
 {
 	s32 compile_collider(Buffer& output, const char* json, CompileOptions& opts);
 	s32 compile_actor(Buffer& output, const char* json, CompileOptions& opts);
 	s32 compile_joint(Buffer& output, const char* json, CompileOptions& opts);
 
+	/// Quantizes @a heights to 16-bit @a samples spanning [height_min; height_max].
+	void compile_heightfield(Array<s16>& samples, const Array<f32>& heights, ColliderDesc& sd);
+
 } // namespace physics_resource_internal
 
 struct PhysicsConfigResource
 {
+	enum
+	{
+		INTERPOLATE = 1 << 0 ///< Interpolate published poses between the last two steps.
+	};
+
 	u32 version;
 	u32 num_materials;
 	u32 materials_offset;
@@ -32,6 +42,10 @@ struct PhysicsConfigResource
 	u32 actors_offset;
 	u32 num_filters;
 	u32 filters_offset;
+	f32 step_time;    ///< Duration of a simulation step in seconds.
+	u32 max_substeps; ///< Maximum number of steps taken by a single update.
+	f32 max_lag;      ///< Unsimulated time above this is dropped, in seconds.
+	u32 flags;
 };
 
 struct PhysicsMaterial
@@ -62,6 +76,7 @@ struct PhysicsActor
 	StringId32 name;
 	f32 linear_damping;
 	f32 angular_damping;
+	f32 max_linear_velocity; ///< 0 if the velocity is not limited.
 	u32 flags;
 };
 
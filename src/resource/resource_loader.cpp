@@ -29,6 +29,7 @@ ResourceLoader::ResourceLoader(Filesystem& data_filesystem)
 	, _requests(default_allocator())
 	, _loaded(default_allocator())
 	, _fallback(default_allocator())
+	, _num_loading(0)
 	, _exit(false)
 {
 	_thread.start([](void* thiz) { return ((ResourceLoader*)thiz)->run(); }, this);
@@ -48,6 +49,26 @@ void ResourceLoader::add_request(const ResourceRequest& rr)
 	_requests_condition.signal();
 }
 
+bool ResourceLoader::cancel_request(StringId64 type, StringId64 name)
+{
+	ScopedMutex sm(_mutex);
+
+	const u32 num = queue::size(_requests);
+	for (u32 i = 0; i < num; ++i)
+	{
+		if (_requests[i].type == type && _requests[i].name == name)
+		{
+			for (u32 j = i; j < num - 1; ++j)
+				_requests[j] = _requests[j + 1];
+
+			queue::pop_back(_requests);
+			return true;
+		}
+	}
+
+	return false;
+}
+
 void ResourceLoader::flush()
 {
 	while (num_requests()) {}
@@ -56,7 +77,7 @@ void ResourceLoader::flush()
 u32 ResourceLoader::num_requests()
 {
 	ScopedMutex sm(_mutex);
-	return queue::size(_requests);
+	return queue::size(_requests) + _num_loading;
 }
 
 void ResourceLoader::add_loaded(ResourceRequest rr)
@@ -84,6 +105,11 @@ void ResourceLoader::register_fallback(StringId64 type, StringId64 name)
 	hash_map::set(_fallback, type, name);
 }
 
+bool ResourceLoader::has_fallback(StringId64 type)
+{
+	return hash_map::has(_fallback, type);
+}
+
 s32 ResourceLoader::run()
 {
 	while (1)
@@ -96,6 +122,8 @@ s32 ResourceLoader::run()
 			break;
 
 		ResourceRequest rr = queue::front(_requests);
+		queue::pop_front(_requests);
+		++_num_loading;
 		_mutex.unlock();
 
 		ResourceId res_id = resource_id(rr.type, rr.name);
@@ -104,10 +132,13 @@ s32 ResourceLoader::run()
 		DynamicString path(ta);
 		destination_path(path, res_id);
 
-		File* file = _data_filesystem.open(path.c_str(), FileOpenMode::READ);
-		if (!file->is_open())
+		File* file = rr.fallback ? NULL : _data_filesystem.open(path.c_str(), FileOpenMode::READ);
+		if (file == NULL || !file->is_open())
 		{
-			logw(RESOURCE_LOADER, "Can't load resource: " RESOURCE_ID_FMT ". Falling back...", res_id._id);
+			if (file == NULL)
+				logw(RESOURCE_LOADER, "Budget exceeded for resource: " RESOURCE_ID_FMT ". Falling back...", res_id._id);
+			else
+				logw(RESOURCE_LOADER, "Can't load resource: " RESOURCE_ID_FMT ". Falling back...", res_id._id);
 
 			StringId64 fallback_name;
 			fallback_name = hash_map::get(_fallback, rr.type, fallback_name);
@@ -116,20 +147,22 @@ s32 ResourceLoader::run()
 			res_id = resource_id(rr.type, fallback_name);
 			destination_path(path, res_id);
 
-			_data_filesystem.close(*file);
+			if (file != NULL)
+				_data_filesystem.close(*file);
 			file = _data_filesystem.open(path.c_str(), FileOpenMode::READ);
 		}
 		CE_ASSERT(file->is_open(), "Can't load resource: " RESOURCE_ID_FMT, res_id._id);
 
+		rr.size = file->size();
+
 		if (rr.load_function)
 		{
 			rr.data = rr.load_function(*file, *rr.allocator);
 		}
 		else
 		{
-			const u32 size = file->size();
-			rr.data = rr.allocator->allocate(size);
-			file->read(rr.data, size);
+			rr.data = rr.allocator->allocate(rr.size);
+			file->read(rr.data, rr.size);
 			CE_ASSERT(*(u32*)rr.data == RESOURCE_HEADER(rr.version), "Wrong version");
 		}
 
@@ -137,7 +170,7 @@ s32 ResourceLoader::run()
 
 		add_loaded(rr);
 		_mutex.lock();
-		queue::pop_front(_requests);
+		--_num_loading;
 		_mutex.unlock();
 	}
 
@@ -25,6 +25,8 @@ struct ResourceRequest
 	LoadFunction load_function;
 	Allocator* allocator;
 	void* data;
+	u32 size; ///< Size of the compiled resource in bytes.
+	bool fallback; ///< Whether to load the fallback resource instead.
 };
 
 /// Loads resources in a background thread.
@@ -42,6 +44,7 @@ struct ResourceLoader
 	Mutex _mutex;
 	ConditionVariable _requests_condition;
 	Mutex _loaded_mutex;
+	u32 _num_loading;
 	bool _exit;
 
 	u32 num_requests();
@@ -59,6 +62,11 @@ struct ResourceLoader
 	/// Adds a request for loading the resource described by @a rr.
 	void add_request(const ResourceRequest& rr);
 
+	/// Removes the request for loading the resource @a type @a name if the
+	/// loader has not started processing it yet.
+	/// Returns true if the request has been cancelled, false otherwise.
+	bool cancel_request(StringId64 type, StringId64 name);
+
 	/// Blocks until all pending requests have been processed.
 	void flush();
 
@@ -67,6 +75,9 @@ struct ResourceLoader
 
 	/// Registers a fallback resource @a name for the given resource @a type.
 	void register_fallback(StringId64 type, StringId64 name);
+
+	/// Returns whether a fallback resource has been registered for the given resource @a type.
+	bool has_fallback(StringId64 type);
 };
 
 } // namespace crown
@@ -5,12 +5,19 @@
 
 #include "core/containers/array.inl"
 #include "core/containers/hash_map.inl"
+#include "core/containers/queue.inl"
 #include "core/memory/temp_allocator.inl"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_id.inl"
+#include "core/time.h"
+#include "device/log.h"
 #include "resource/resource_id.h"
 #include "resource/resource_loader.h"
 #include "resource/resource_manager.h"
+#include "resource/resource_package.h"
+#include <algorithm>
+
+LOG_SYSTEM(RESOURCE_MANAGER, "resource_manager")
 
 namespace crown
 {
@@ -35,7 +42,7 @@ bool operator==(const ResourceManager::ResourceEntry& a, const ResourceManager::
 		;
 }
 
-const ResourceManager::ResourceEntry ResourceManager::ResourceEntry::NOT_FOUND = { 0xffffffffu, NULL };
+const ResourceManager::ResourceEntry ResourceManager::ResourceEntry::NOT_FOUND = { 0xffffffffu, NULL, 0u, false };
 
 template<>
 struct hash<ResourceManager::ResourcePair>
@@ -50,13 +57,20 @@ ResourceManager::ResourceManager(ResourceLoader& rl)
 	: _resource_heap(default_allocator(), "resource")
 	, _loader(&rl)
 	, _type_data(default_allocator())
+	, _packages(default_allocator())
 	, _rm(default_allocator())
+	, _pending(default_allocator())
+	, _unloads(default_allocator())
+	, _unload_budget(0.001)
+	, _num_fallbacks(0)
 	, _autoload(false)
 {
 }
 
 ResourceManager::~ResourceManager()
 {
+	flush();
+
 	auto cur = hash_map::begin(_rm);
 	auto end = hash_map::end(_rm);
 	for (; cur != end; ++cur)
@@ -77,12 +91,27 @@ void ResourceManager::load(StringId64 type, StringId64 name)
 
 	if (entry == ResourceEntry::NOT_FOUND)
 	{
+		// The requesters become the entry's references once the request completes.
+		if (hash_map::has(_pending, id))
+		{
+			// Coalesce with the request already in flight.
+			const u32 requesters = hash_map::get(_pending, id, 0u);
+			hash_map::set(_pending, id, requesters + 1);
+			return;
+		}
+
+		hash_map::set(_pending, id, 1u);
+
 		ResourceTypeData rtd;
 		rtd.version = UINT32_MAX;
 		rtd.load = NULL;
 		rtd.online = NULL;
 		rtd.offline = NULL;
 		rtd.unload = NULL;
+		rtd.resident = 0;
+		rtd.budget = UINT32_MAX;
+		rtd.refuse = false;
+		rtd.replacing = StringId64();
 		rtd = hash_map::get(_type_data, type, rtd);
 
 		ResourceRequest rr;
@@ -92,6 +121,7 @@ void ResourceManager::load(StringId64 type, StringId64 name)
 		rr.load_function = rtd.load;
 		rr.allocator = &_resource_heap;
 		rr.data = NULL;
+		rr.fallback = rtd.refuse && rtd.resident >= rtd.budget && _loader->has_fallback(type);
 
 		_loader->add_request(rr);
 		return;
@@ -102,17 +132,32 @@ void ResourceManager::load(StringId64 type, StringId64 name)
 
 void ResourceManager::unload(StringId64 type, StringId64 name)
 {
-	flush();
-
 	ResourcePair id = { type, name };
 	ResourceEntry& entry = hash_map::get(_rm, id, ResourceEntry::NOT_FOUND);
 
-	if (--entry.references == 0)
+	if (entry == ResourceEntry::NOT_FOUND)
 	{
-		on_offline(type, name);
-		on_unload(type, entry.data);
+		// The resource is still being loaded: drop one of its requesters.
+		const u32 requesters = hash_map::get(_pending, id, 0u);
+		CE_ASSERT(requesters > 0, "Resource not loaded: " RESOURCE_ID_FMT, resource_id(type, name)._id);
+
+		// Cancel the request if nobody needs it anymore and the loader did
+		// not start it yet. Otherwise, its data is released on completion.
+		if (requesters == 1 && _loader->cancel_request(type, name))
+			hash_map::remove(_pending, id);
+		else
+			hash_map::set(_pending, id, requesters - 1);
+		return;
+	}
 
-		hash_map::remove(_rm, id);
+	CE_ASSERT(entry.references > 0, "Resource not loaded: " RESOURCE_ID_FMT, resource_id(type, name)._id);
+	if (--entry.references == 0)
+	{
+		UnloadRequest ur;
+		ur.id = id;
+		ur.data = entry.data;
+		ur.online = true;
+		queue::push_back(_unloads, ur);
 	}
 }
 
@@ -122,7 +167,12 @@ void ResourceManager::reload(StringId64 type, StringId64 name)
 	const ResourceEntry& entry = hash_map::get(_rm, id, ResourceEntry::NOT_FOUND);
 	const u32 old_refs = entry.references;
 
-	unload(type, name);
+	on_offline(type, name);
+	on_unload(type, entry.data);
+	on_released(type, entry.size);
+	_num_fallbacks -= u32(entry.fallback);
+	hash_map::remove(_rm, id);
+
 	load(type, name);
 	flush();
 
@@ -136,6 +186,12 @@ bool ResourceManager::can_get(StringId64 type, StringId64 name)
 	return _autoload ? true : hash_map::has(_rm, id);
 }
 
+u32 ResourceManager::num_requesters(StringId64 type, StringId64 name)
+{
+	const ResourcePair id = { type, name };
+	return hash_map::get(_pending, id, 0u);
+}
+
 const void* ResourceManager::get(StringId64 type, StringId64 name)
 {
 	const ResourcePair id = { type, name };
@@ -154,6 +210,12 @@ const void* ResourceManager::get(StringId64 type, StringId64 name)
 	return entry.data;
 }
 
+u32 ResourceManager::size(StringId64 type, StringId64 name)
+{
+	const ResourcePair id = { type, name };
+	return hash_map::get(_rm, id, ResourceEntry::NOT_FOUND).size;
+}
+
 void ResourceManager::enable_autoload(bool enable)
 {
 	_autoload = enable;
@@ -161,8 +223,15 @@ void ResourceManager::enable_autoload(bool enable)
 
 void ResourceManager::flush()
 {
-	_loader->flush();
-	complete_requests();
+	// Completing requests might issue new ones (e.g. package contents).
+	do
+	{
+		_loader->flush();
+		complete_requests();
+	}
+	while (_loader->num_requests() != 0);
+
+	while (complete_unload()) {}
 }
 
 void ResourceManager::complete_requests()
@@ -172,22 +241,293 @@ void ResourceManager::complete_requests()
 	_loader->get_loaded(loaded);
 
 	for (u32 i = 0; i < array::size(loaded); ++i)
-		complete_request(loaded[i].type, loaded[i].name, loaded[i].data);
+		complete_request(loaded[i].type, loaded[i].name, loaded[i].data, loaded[i].size, loaded[i].fallback);
+
+	// Chain the loading of packages' contents to the completion of their manifests.
+	for (u32 i = 0; i < array::size(_packages); ++i)
+	{
+		if (_packages[i]->_loading)
+			_packages[i]->update();
+	}
+
+	const s64 t0 = time::now();
+	while (complete_unload() && time::seconds(time::now() - t0) < _unload_budget) {}
+
+	if (_num_fallbacks != 0)
+		replace_fallbacks();
 }
 
-void ResourceManager::complete_request(StringId64 type, StringId64 name, void* data)
+void ResourceManager::complete_request(StringId64 type, StringId64 name, void* data, u32 size, bool fallback)
 {
+	ResourcePair id = { type, name };
+
+	if (hash_map::has(_type_data, type))
+	{
+		ResourceTypeData& rtd = hash_map::get(_type_data, type, ResourceTypeData());
+		if (rtd.replacing == name)
+		{
+			rtd.replacing = StringId64();
+			complete_replace(type, name, data, size, fallback);
+			return;
+		}
+	}
+
+	const u32 requesters = hash_map::get(_pending, id, 0u);
+	hash_map::remove(_pending, id);
+	CE_ASSERT(!hash_map::has(_rm, id), "Resource already loaded: " RESOURCE_ID_FMT, resource_id(type, name)._id);
+
+	if (requesters == 0)
+	{
+		// All the requesters dropped the resource while it was loading.
+		UnloadRequest ur;
+		ur.id = id;
+		ur.data = data;
+		ur.online = false;
+		queue::push_back(_unloads, ur);
+		return;
+	}
+
 	ResourceEntry entry;
-	entry.references = 1;
+	entry.references = requesters;
 	entry.data = data;
+	entry.size = size;
+	entry.fallback = fallback;
+	hash_map::set(_rm, id, entry);
+	on_resident(type, size);
+	_num_fallbacks += u32(fallback);
 
+	on_online(type, name);
+}
+
+void ResourceManager::complete_replace(StringId64 type, StringId64 name, void* data, u32 size, bool fallback)
+{
 	ResourcePair id = { type, name };
+	ResourceEntry& entry = hash_map::get(_rm, id, ResourceEntry::NOT_FOUND);
 
-	hash_map::set(_rm, id, entry);
+	// Drop the data if the resource has been unloaded or reloaded in the
+	// meantime. If it has been released, its pending unload takes care of
+	// the fallback.
+	if (entry == ResourceEntry::NOT_FOUND || entry.references == 0 || !entry.fallback || fallback)
+	{
+		UnloadRequest ur;
+		ur.id = id;
+		ur.data = data;
+		ur.online = false;
+		queue::push_back(_unloads, ur);
+		return;
+	}
+
+	on_offline(type, name);
+	on_released(type, entry.size);
+
+	UnloadRequest ur;
+	ur.id = id;
+	ur.data = entry.data;
+	ur.online = false;
+	queue::push_back(_unloads, ur);
+
+	entry.data = data;
+	entry.size = size;
+	entry.fallback = false;
+	on_resident(type, size);
+	--_num_fallbacks;
 
 	on_online(type, name);
 }
 
+void ResourceManager::replace_fallbacks()
+{
+	auto cur = hash_map::begin(_rm);
+	auto end = hash_map::end(_rm);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(_rm, cur);
+
+		if (!cur->second.fallback)
+			continue;
+
+		const StringId64 type = cur->first.type;
+		ResourceTypeData& rtd = hash_map::get(_type_data, type, ResourceTypeData());
+		if (rtd.replacing._id != 0 || rtd.resident >= rtd.budget)
+			continue;
+
+		// Load the resource under its own name; complete_replace() swaps it
+		// with the fallback once loaded.
+		ResourceRequest rr;
+		rr.type = type;
+		rr.name = cur->first.name;
+		rr.version = rtd.version;
+		rr.load_function = rtd.load;
+		rr.allocator = &_resource_heap;
+		rr.data = NULL;
+		rr.fallback = false;
+
+		_loader->add_request(rr);
+		rtd.replacing = cur->first.name;
+	}
+}
+
+bool ResourceManager::complete_unload()
+{
+	if (queue::empty(_unloads))
+		return false;
+
+	const UnloadRequest ur = queue::front(_unloads);
+	queue::pop_front(_unloads);
+
+	if (ur.online)
+	{
+		const ResourceEntry& entry = hash_map::get(_rm, ur.id, ResourceEntry::NOT_FOUND);
+
+		// Skip if the resource has been loaded again or already released.
+		if (entry.references != 0 || entry.data != ur.data)
+			return true;
+
+		on_offline(ur.id.type, ur.id.name);
+		on_released(ur.id.type, entry.size);
+		_num_fallbacks -= u32(entry.fallback);
+		hash_map::remove(_rm, ur.id);
+	}
+
+	on_unload(ur.id.type, ur.data);
+	return true;
+}
+
+void ResourceManager::set_unload_budget(f64 seconds)
+{
+	_unload_budget = seconds;
+}
+
+void ResourceManager::add_package(ResourcePackage& package)
+{
+	array::push_back(_packages, &package);
+}
+
+void ResourceManager::remove_package(ResourcePackage& package)
+{
+	for (u32 i = 0; i < array::size(_packages); ++i)
+	{
+		if (_packages[i] == &package)
+		{
+			_packages[i] = array::back(_packages);
+			array::pop_back(_packages);
+			return;
+		}
+	}
+}
+
+void ResourceManager::set_budget(StringId64 type, u32 bytes, bool refuse)
+{
+	CE_ASSERT(hash_map::has(_type_data, type), "Unknown type");
+	ResourceTypeData& rtd = hash_map::get(_type_data, type, ResourceTypeData());
+	rtd.budget = bytes;
+	rtd.refuse = refuse;
+}
+
+u32 ResourceManager::resident(StringId64 type)
+{
+	ResourceTypeData rtd;
+	rtd.resident = 0;
+	return hash_map::get(_type_data, type, rtd).resident;
+}
+
+void ResourceManager::log_resident(u32 num)
+{
+	logi(RESOURCE_MANAGER, "Resident memory by type:");
+	{
+		auto cur = hash_map::begin(_type_data);
+		auto end = hash_map::end(_type_data);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(_type_data, cur);
+
+			if (cur->second.budget == UINT32_MAX)
+			{
+				logi(RESOURCE_MANAGER, "  " RESOURCE_ID_FMT ": %u bytes"
+					, cur->first._id
+					, cur->second.resident
+					);
+			}
+			else
+			{
+				logi(RESOURCE_MANAGER, "  " RESOURCE_ID_FMT ": %u / %u bytes"
+					, cur->first._id
+					, cur->second.resident
+					, cur->second.budget
+					);
+			}
+		}
+	}
+
+	logi(RESOURCE_MANAGER, "Resident memory by package:");
+	for (u32 i = 0; i < array::size(_packages); ++i)
+	{
+		const ResourcePackage* pkg = _packages[i];
+		logi(RESOURCE_MANAGER, "  " RESOURCE_ID_FMT ": %u bytes (%u/%u resources)"
+			, pkg->_package_id._id
+			, pkg->bytes_loaded()
+			, pkg->num_loaded()
+			, pkg->num_resources()
+			);
+	}
+
+	Array<const ResourceMap::Entry*> entries(default_allocator());
+	array::reserve(entries, hash_map::size(_rm));
+	{
+		auto cur = hash_map::begin(_rm);
+		auto end = hash_map::end(_rm);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(_rm, cur);
+
+			array::push_back(entries, cur);
+		}
+	}
+
+	num = min(num, array::size(entries));
+	std::partial_sort(array::begin(entries), array::begin(entries) + num, array::end(entries), [](const ResourceMap::Entry* a, const ResourceMap::Entry* b)
+		{
+			return a->second.size > b->second.size;
+		});
+
+	logi(RESOURCE_MANAGER, "Largest resident resources:");
+	for (u32 i = 0; i < num; ++i)
+	{
+		logi(RESOURCE_MANAGER, "  " RESOURCE_ID_FMT ": %u bytes (%u references)"
+			, resource_id(entries[i]->first.type, entries[i]->first.name)._id
+			, entries[i]->second.size
+			, entries[i]->second.references
+			);
+	}
+}
+
+void ResourceManager::on_resident(StringId64 type, u32 size)
+{
+	if (!hash_map::has(_type_data, type))
+		return;
+
+	ResourceTypeData& rtd = hash_map::get(_type_data, type, ResourceTypeData());
+	if (rtd.resident <= rtd.budget && rtd.resident + size > rtd.budget)
+	{
+		logw(RESOURCE_MANAGER, "Budget exceeded for type " RESOURCE_ID_FMT ": %u / %u bytes"
+			, type._id
+			, rtd.resident + size
+			, rtd.budget
+			);
+	}
+
+	rtd.resident += size;
+}
+
+void ResourceManager::on_released(StringId64 type, u32 size)
+{
+	if (!hash_map::has(_type_data, type))
+		return;
+
+	ResourceTypeData& rtd = hash_map::get(_type_data, type, ResourceTypeData());
+	rtd.resident -= size;
+}
+
 void ResourceManager::register_type(StringId64 type, u32 version, LoadFunction load, UnloadFunction unload, OnlineFunction online, OfflineFunction offline)
 {
 	ResourceTypeData rtd;
@@ -196,6 +536,10 @@ void ResourceManager::register_type(StringId64 type, u32 version, LoadFunction l
 	rtd.online = online;
 	rtd.offline = offline;
 	rtd.unload = unload;
+	rtd.resident = 0;
+	rtd.budget = UINT32_MAX;
+	rtd.refuse = false;
+	rtd.replacing = StringId64();
 
 	hash_map::set(_type_data, type, rtd);
 }
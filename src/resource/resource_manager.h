@@ -36,6 +36,8 @@ struct ResourceManager
 	{
 		u32 references;
 		void* data;
+		u32 size;
+		bool fallback; ///< Whether the data is the fallback resource loaded because the budget was exceeded.
 
 		static const ResourceEntry NOT_FOUND;
 	};
@@ -47,21 +49,43 @@ struct ResourceManager
 		OnlineFunction online;
 		OfflineFunction offline;
 		UnloadFunction unload;
+		u32 resident; ///< Memory in bytes used by the resources of this type.
+		u32 budget;   ///< Maximum memory in bytes resources of this type should use.
+		bool refuse;  ///< Whether to load fallbacks instead of resources once the budget is exceeded.
+		StringId64 replacing; ///< Name of the resource whose fallback is being replaced, if any.
+	};
+
+	struct UnloadRequest
+	{
+		ResourcePair id;
+		void* data;
+		bool online; ///< Whether the resource must be brought offline before releasing its data.
 	};
 
 	typedef HashMap<StringId64, ResourceTypeData> TypeMap;
 	typedef HashMap<ResourcePair, ResourceEntry> ResourceMap;
+	typedef HashMap<ResourcePair, u32> PendingMap;
 
 	ProxyAllocator _resource_heap;
 	ResourceLoader* _loader;
 	TypeMap _type_data;
+	Array<ResourcePackage*> _packages;
 	ResourceMap _rm;
+	PendingMap _pending; ///< Number of requesters of each in-flight request.
+	Queue<UnloadRequest> _unloads;
+	f64 _unload_budget;
+	u32 _num_fallbacks; ///< Number of resources currently served with their fallback.
 	bool _autoload;
 
 	void on_online(StringId64 type, StringId64 name);
 	void on_offline(StringId64 type, StringId64 name);
 	void on_unload(StringId64 type, void* data);
-	void complete_request(StringId64 type, StringId64 name, void* data);
+	void complete_request(StringId64 type, StringId64 name, void* data, u32 size, bool fallback);
+	void complete_replace(StringId64 type, StringId64 name, void* data, u32 size, bool fallback);
+	void replace_fallbacks();
+	void on_resident(StringId64 type, u32 size);
+	void on_released(StringId64 type, u32 size);
+	bool complete_unload();
 
 	/// Uses @a rl to load resources.
 	ResourceManager(ResourceLoader& rl);
@@ -71,9 +95,15 @@ struct ResourceManager
 
 	/// Loads the resource (@a type, @a name).
 	/// You can check whether the resource is available with can_get().
+	/// @note
+	/// Loads of a resource whose request is still in flight are coalesced
+	/// into that request.
 	void load(StringId64 type, StringId64 name);
 
 	/// Unloads the resource @a type @a name.
+	/// @note
+	/// The call does not block: the resource is brought offline and its
+	/// memory released later by complete_requests().
 	void unload(StringId64 type, StringId64 name);
 
 	/// Reloads the resource (@a type, @a name).
@@ -83,18 +113,55 @@ struct ResourceManager
 	/// Returns whether the manager has the resource (@a type, @a name).
 	bool can_get(StringId64 type, StringId64 name);
 
+	/// Returns the number of load() calls waiting for the in-flight request
+	/// of the resource (@a type, @a name) to complete.
+	u32 num_requesters(StringId64 type, StringId64 name);
+
 	/// Returns the data of the resource (@a type, @a name).
 	const void* get(StringId64 type, StringId64 name);
 
+	/// Returns the size in bytes of the compiled data of the resource (@a type, @a name).
+	u32 size(StringId64 type, StringId64 name);
+
 	/// Sets whether resources should be automatically loaded when accessed.
 	void enable_autoload(bool enable);
 
-	/// Blocks until all load() requests have been completed.
+	/// Blocks until all load() and unload() requests have been completed.
 	void flush();
 
-	/// Completes all load() requests which have been loaded by ResourceLoader.
+	/// Completes all load() requests which have been loaded by ResourceLoader
+	/// and processes pending unload() requests within the unload budget.
 	void complete_requests();
 
+	/// Sets the maximum time in @a seconds complete_requests() spends
+	/// processing unload() requests. At least one request is always processed.
+	void set_unload_budget(f64 seconds);
+
+	/// Tracks the @a package, whose contents are loaded by complete_requests()
+	/// after ResourcePackage::load() has been called.
+	void add_package(ResourcePackage& package);
+
+	/// Stops tracking the @a package.
+	void remove_package(ResourcePackage& package);
+
+	/// Sets the memory budget in @a bytes for resources of the given @a type.
+	/// A warning is logged when the budget is exceeded. If @a refuse is true
+	/// and the type has a fallback resource, further loads of that type are
+	/// served with the fallback until memory goes back under budget.
+	/// @note
+	/// Once memory goes back under budget, the fallbacks are replaced by their
+	/// resources in the background, one at a time. As with reload(), the data
+	/// is swapped while the resource is offline, so the user has to get() it
+	/// again once it is brought online.
+	void set_budget(StringId64 type, u32 bytes, bool refuse);
+
+	/// Returns the memory in bytes used by resources of the given @a type.
+	u32 resident(StringId64 type);
+
+	/// Logs the memory used by each resource type and package and the @a num
+	/// largest resources.
+	void log_resident(u32 num);
+
 	/// Registers a new resource @a type into the resource manager.
 	void register_type(StringId64 type, u32 version, LoadFunction load, UnloadFunction unload, OnlineFunction online, OfflineFunction offline);
 };
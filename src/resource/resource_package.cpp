@@ -4,7 +4,9 @@
  */
 
 #include "core/containers/array.inl"
+#include "core/error/error.h"
 #include "resource/package_resource.h"
+#include "resource/resource_id.h"
 #include "resource/resource_manager.h"
 #include "resource/resource_package.h"
 #include "world/types.h"
@@ -16,11 +18,16 @@ ResourcePackage::ResourcePackage(StringId64 id, ResourceManager& resman)
 	, _resource_manager(&resman)
 	, _package_id(id)
 	, _package(NULL)
+	, _num_loaded(0)
+	, _bytes_loaded(0)
+	, _loading(false)
 {
+	_resource_manager->add_package(*this);
 }
 
 ResourcePackage::~ResourcePackage()
 {
+	_resource_manager->remove_package(*this);
 	_resource_manager->unload(RESOURCE_TYPE_PACKAGE, _package_id);
 	_marker = 0;
 }
@@ -28,37 +35,90 @@ ResourcePackage::~ResourcePackage()
 void ResourcePackage::load()
 {
 	_resource_manager->load(RESOURCE_TYPE_PACKAGE, _package_id);
-	_resource_manager->flush();
-	_package = (const PackageResource*)_resource_manager->get(RESOURCE_TYPE_PACKAGE, _package_id);
-
-	for (u32 i = 0; i < array::size(_package->resources); ++i)
-	{
-		_resource_manager->load(_package->resources[i].type, _package->resources[i].name);
-	}
+	_loading = true;
 }
 
 void ResourcePackage::unload()
 {
+	_loading = false;
+
+	// Contents are only requested after the manifest has been loaded.
+	if (_package == NULL)
+		return;
+
 	for (u32 i = 0; i < array::size(_package->resources); ++i)
 	{
 		_resource_manager->unload(_package->resources[i].type, _package->resources[i].name);
 	}
+
+	_package = NULL;
+	_num_loaded = 0;
+	_bytes_loaded = 0;
 }
 
 void ResourcePackage::flush()
 {
-	_resource_manager->flush();
+	CE_ASSERT(_loading || has_loaded(), "Package not loaded: " RESOURCE_ID_FMT, _package_id._id);
+
+	while (_loading)
+		_resource_manager->flush();
 }
 
 bool ResourcePackage::has_loaded() const
 {
-	for (u32 i = 0; i < array::size(_package->resources); ++i)
+	return _package != NULL && _num_loaded == array::size(_package->resources);
+}
+
+u32 ResourcePackage::num_loaded() const
+{
+	return _num_loaded;
+}
+
+u32 ResourcePackage::num_resources() const
+{
+	return _package != NULL ? array::size(_package->resources) : 0;
+}
+
+u32 ResourcePackage::bytes_loaded() const
+{
+	return _bytes_loaded;
+}
+
+bool ResourcePackage::update()
+{
+	if (_package == NULL)
 	{
-		if (!_resource_manager->can_get(_package->resources[i].type, _package->resources[i].name))
+		if (!_resource_manager->can_get(RESOURCE_TYPE_PACKAGE, _package_id))
 			return false;
+
+		// With autoload enabled, get() flushes the resource manager, which
+		// would update the package again.
+		_loading = false;
+		_package = (const PackageResource*)_resource_manager->get(RESOURCE_TYPE_PACKAGE, _package_id);
+		_loading = true;
+
+		for (u32 i = 0; i < array::size(_package->resources); ++i)
+		{
+			_resource_manager->load(_package->resources[i].type, _package->resources[i].name);
+		}
+	}
+
+	// Resources are loaded roughly in the order they have been requested,
+	// so a cursor is enough to keep track of progress.
+	const u32 num = array::size(_package->resources);
+	while (_num_loaded < num)
+	{
+		const StringId64 type = _package->resources[_num_loaded].type;
+		const StringId64 name = _package->resources[_num_loaded].name;
+		if (!_resource_manager->can_get(type, name))
+			break;
+
+		_bytes_loaded += _resource_manager->size(type, name);
+		++_num_loaded;
 	}
 
-	return true;
+	_loading = _num_loaded != num;
+	return !_loading;
 }
 
 } // namespace crown
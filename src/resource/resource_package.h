@@ -18,6 +18,9 @@ struct ResourcePackage
 	ResourceManager* _resource_manager;
 	StringId64 _package_id;
 	const PackageResource* _package;
+	u32 _num_loaded;
+	u32 _bytes_loaded;
+	bool _loading;
 
 	///
 	ResourcePackage(StringId64 id, ResourceManager& resman);
@@ -39,6 +42,21 @@ struct ResourcePackage
 
 	/// Returns whether the package has been loaded.
 	bool has_loaded() const;
+
+	/// Returns the number of resources that have been loaded so far.
+	u32 num_loaded() const;
+
+	/// Returns the total number of resources in the package.
+	/// @note
+	/// Returns 0 until the package manifest has been loaded.
+	u32 num_resources() const;
+
+	/// Returns the size in bytes of the resources that have been loaded so far.
+	u32 bytes_loaded() const;
+
+	/// Requests the package's contents once its manifest is available and
+	/// advances the loading progress. Returns true when the package has been loaded.
+	bool update();
 };
 
 } // namespace crown
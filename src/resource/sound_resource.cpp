@@ -4,8 +4,10 @@
  */
 
 #include "config.h"
+#include "core/adpcm.h"
 #include "core/containers/array.inl"
 #include "core/filesystem/file.h"
+#include "core/filesystem/reader_writer.inl"
 #include "core/json/json_object.inl"
 #include "core/json/sjson.h"
 #include "core/memory/allocator.h"
@@ -13,9 +15,86 @@
 #include "core/strings/dynamic_string.inl"
 #include "resource/compile_options.h"
 #include "resource/sound_resource.h"
+#include "world/audio.h"
 
 namespace crown
 {
+namespace sound_resource_internal
+{
+	void* load(File& file, Allocator& a)
+	{
+		BinaryReader br(file);
+
+		u32 version;
+		br.read(version);
+		CE_ASSERT(version == RESOURCE_HEADER(RESOURCE_VERSION_SOUND), "Wrong version");
+
+		SoundResource header;
+		br.read(header.size);
+		br.read(header.num_frames);
+		br.read(header.sample_rate);
+		br.read(header.avg_bytes_ps);
+		br.read(header.channels);
+		br.read(header.block_size);
+		br.read(header.bits_ps);
+		br.read(header.sound_type);
+		header.data_offset = file.position();
+		header.buffer      = 0;
+
+		const u32 pcm_size = header.sound_type == SoundType::ADPCM
+			? header.num_frames * header.channels * sizeof(s16)
+			: header.size
+			;
+		header.streaming = pcm_size > CROWN_SOUND_STREAMING_SIZE;
+
+		// Large sounds are streamed by SoundWorld while playing.
+		if (header.streaming)
+		{
+			SoundResource* sr = (SoundResource*)a.allocate(sizeof(SoundResource));
+			*sr = header;
+			return sr;
+		}
+
+		SoundResource* sr = (SoundResource*)a.allocate(sizeof(SoundResource) + pcm_size);
+		*sr = header;
+
+		if (header.sound_type == SoundType::ADPCM)
+		{
+			// Decode resident sounds right away, on the loader thread.
+			char* encoded = (char*)a.allocate(header.size);
+			br.read(encoded, header.size);
+			adpcm::decode((s16*)&sr[1], (const u8*)encoded, header.num_frames, header.channels, header.block_size);
+			a.deallocate(encoded);
+
+			sr->size       = pcm_size;
+			sr->block_size = u16(header.channels * sizeof(s16));
+			sr->sound_type = SoundType::WAV;
+		}
+		else
+		{
+			br.read(&sr[1], header.size);
+		}
+
+		return sr;
+	}
+
+	void online(StringId64 id, ResourceManager& rm)
+	{
+		audio_globals::sound_online(id, rm);
+	}
+
+	void offline(StringId64 id, ResourceManager& rm)
+	{
+		audio_globals::sound_offline(id, rm);
+	}
+
+	void unload(Allocator& a, void* resource)
+	{
+		a.deallocate(resource);
+	}
+
+} // namespace sound_resource_internal
+
 namespace sound_resource
 {
 	const char* data(const SoundResource* sr)
@@ -56,14 +135,17 @@ namespace sound_resource_internal
 		DynamicString name(ta);
 		sjson::parse_string(name, obj["source"]);
 
+		DynamicString compression(ta);
+		if (json_object::has(obj, "compression"))
+			sjson::parse_string(compression, obj["compression"]);
+
 		Buffer sound = opts.read(name.c_str());
 		const WAVHeader* wav = (const WAVHeader*)array::begin(sound);
 		const char* wavdata = (const char*)&wav[1];
 
-		// Write
 		SoundResource sr;
-		sr.version      = RESOURCE_HEADER(RESOURCE_VERSION_SOUND);
 		sr.size         = wav->data_size;
+		sr.num_frames   = wav->data_size / wav->fmt_block_align;
 		sr.sample_rate  = wav->fmt_sample_rate;
 		sr.avg_bytes_ps = wav->fmt_avarage;
 		sr.channels     = wav->fmt_channels;
@@ -71,8 +153,45 @@ namespace sound_resource_internal
 		sr.bits_ps      = wav->fmt_bits_ps;
 		sr.sound_type   = SoundType::WAV;
 
-		opts.write(sr.version);
+		Buffer data(default_allocator());
+
+		if (compression == "adpcm")
+		{
+			DATA_COMPILER_ASSERT(sr.bits_ps == 16
+				, opts
+				, "ADPCM compression requires 16-bit samples"
+				);
+			DATA_COMPILER_ASSERT(sr.channels <= 2
+				, opts
+				, "ADPCM compression supports mono and stereo sounds only"
+				);
+
+			sr.block_size = u16(CROWN_SOUND_ADPCM_BLOCK_SIZE * sr.channels);
+			sr.size       = adpcm::encoded_size(sr.num_frames, sr.channels, sr.block_size);
+			sr.sound_type = SoundType::ADPCM;
+
+			array::resize(data, sr.size);
+			adpcm::encode((u8*)array::begin(data)
+				, (const s16*)wavdata
+				, sr.num_frames
+				, sr.channels
+				, sr.block_size
+				);
+			wavdata = array::begin(data);
+		}
+		else
+		{
+			DATA_COMPILER_ASSERT(compression == "" || compression == "none"
+				, opts
+				, "Unknown compression: '%s'"
+				, compression.c_str()
+				);
+		}
+
+		// Write
+		opts.write(RESOURCE_HEADER(RESOURCE_VERSION_SOUND));
 		opts.write(sr.size);
+		opts.write(sr.num_frames);
 		opts.write(sr.sample_rate);
 		opts.write(sr.avg_bytes_ps);
 		opts.write(sr.channels);
@@ -80,7 +199,7 @@ namespace sound_resource_internal
 		opts.write(sr.bits_ps);
 		opts.write(sr.sound_type);
 
-		opts.write(wavdata, wav->data_size);
+		opts.write(wavdata, sr.size);
 
 		return 0;
 	}
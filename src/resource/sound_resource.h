@@ -19,31 +19,47 @@ struct SoundType
 	enum Enum
 	{
 		WAV,
-		OGG
+		OGG,
+		ADPCM   ///< IMA ADPCM, decoded to 16-bit PCM at runtime.
 	};
 };
 
+/// Sound data is either loaded along with the resource or, when it is larger
+/// than CROWN_SOUND_STREAMING_SIZE once decoded, streamed from the resource
+/// file while the sound plays. Resident ADPCM sounds are decoded when loaded,
+/// streaming ones a chunk at a time on the streaming thread.
 struct SoundResource
 {
-	u32 version;
-	u32 size;
+	StringId64 name;  ///< Set when the resource is brought online.
+	u32 size;         ///< Size of the sample data.
+	u32 num_frames;
 	u32 sample_rate;
 	u32 avg_bytes_ps;
 	u32 channels;
-	u16 block_size;
-	u16 bits_ps;
+	u16 block_size;   ///< Size of an ADPCM block if sound_type is ADPCM.
+	u16 bits_ps;      ///< Bits per sample of the decoded data.
 	u32 sound_type;
+	u32 data_offset;  ///< Offset of the sample data in the resource file.
+	u32 buffer;       ///< Buffer shared by the instances of resident sounds.
+	bool streaming;   ///< Whether the sample data is streamed.
+	// u8 data[size], if not streaming
 };
 
 namespace sound_resource_internal
 {
 	s32 compile(CompileOptions& opts);
+	void* load(File& file, Allocator& a);
+	void online(StringId64 id, ResourceManager& rm);
+	void offline(StringId64 id, ResourceManager& rm);
+	void unload(Allocator& a, void* resource);
 
 } // namespace	sound_resource_internal
 
 namespace sound_resource
 {
 	/// Returns the sound data.
+	/// @note
+	/// Streaming sounds have no resident data.
 	const char* data(const SoundResource* sr);
 
 } // namespace sound_resource
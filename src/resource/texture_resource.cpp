@@ -11,9 +11,12 @@
 #include "core/process.h"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_stream.inl"
+#include "device/device.h"
 #include "resource/compile_options.h"
 #include "resource/resource_manager.h"
 #include "resource/texture_resource.h"
+#include "world/texture_manager.h"
+#include <bimg/bimg.h>
 
 namespace crown
 {
@@ -27,30 +30,78 @@ namespace texture_resource_internal
 		br.read(version);
 		CE_ASSERT(version == RESOURCE_HEADER(RESOURCE_VERSION_TEXTURE), "Wrong version");
 
+		u32 format;
+		u32 width;
+		u32 height;
+		u32 num_mips;
 		u32 size;
+		br.read(format);
+		br.read(width);
+		br.read(height);
+		br.read(num_mips);
 		br.read(size);
 
-		TextureResource* tr = (TextureResource*)a.allocate(sizeof(TextureResource) + size);
+		TextureMip mips[32];
+		CE_ENSURE(num_mips <= countof(mips));
+		br.read(mips, sizeof(TextureMip)*num_mips);
 
-		void* data = &tr[1];
-		br.read(data, size);
+		// Only load the mips not larger than CROWN_TEXTURE_STREAMING_MIP_SIZE,
+		// larger ones are streamed in by TextureManager.
+		u32 low_mip = 0;
+		if (num_mips > 1)
+		{
+			while (low_mip < num_mips - 1
+				&& max(width >> low_mip, height >> low_mip) > CROWN_TEXTURE_STREAMING_MIP_SIZE
+				)
+				++low_mip;
+		}
+
+		const u32 data_size = num_mips == 0 ? size : mips[low_mip].offset + mips[low_mip].size;
 
-		tr->mem        = bgfx::makeRef(data, size);
-		tr->handle.idx = BGFX_INVALID_HANDLE;
+		TextureResource* tr = (TextureResource*)a.allocate(sizeof(TextureResource)
+			+ sizeof(TextureMip)*num_mips
+			+ data_size
+			);
+		tr->format       = format;
+		tr->width        = width;
+		tr->height       = height;
+		tr->num_mips     = num_mips;
+		tr->low_mip      = low_mip;
+		tr->resident_mip = low_mip;
+		tr->stream_id    = 0;
+		tr->last_used    = 0;
+		tr->handle.idx   = BGFX_INVALID_HANDLE;
+
+		memcpy((TextureMip*)&tr[1], mips, sizeof(TextureMip)*num_mips);
+		tr->data = (TextureMip*)&tr[1] + num_mips;
+		tr->size = data_size;
+
+		if (num_mips == 0)
+		{
+			br.read(tr->data, data_size);
+		}
+		else
+		{
+			// Mips are stored from the smallest to the largest while bgfx
+			// expects them from the largest to the smallest.
+			for (u32 i = num_mips; i-- > low_mip;)
+			{
+				const u32 offset = data_size - mips[i].offset - mips[i].size;
+				br.read((char*)tr->data + offset, mips[i].size);
+			}
+		}
 
 		return tr;
 	}
 
 	void online(StringId64 id, ResourceManager& rm)
 	{
-		TextureResource* tr = (TextureResource*)rm.get(RESOURCE_TYPE_TEXTURE, id);
-		tr->handle = bgfx::createTexture(tr->mem);
+		device()->_texture_manager->online(id, rm);
 	}
 
 	void offline(StringId64 id, ResourceManager& rm)
 	{
-		TextureResource* tr = (TextureResource*)rm.get(RESOURCE_TYPE_TEXTURE, id);
-		bgfx::destroy(tr->handle);
+		device()->_texture_manager->offline(id, rm);
 	}
 
 	void unload(Allocator& a, void* resource)
@@ -60,6 +111,42 @@ namespace texture_resource_internal
 
 } // namespace texture_resource_internal
 
+namespace texture_resource
+{
+	const TextureMip* mip(const TextureResource* tr, u32 i)
+	{
+		CE_ASSERT(i < tr->num_mips, "Index out of bounds");
+		return (const TextureMip*)&tr[1] + i;
+	}
+
+	u32 mips_size(const TextureResource* tr, u32 first_mip)
+	{
+		if (tr->num_mips == 0)
+			return tr->size;
+
+		const TextureMip* tm = mip(tr, first_mip);
+		return tm->offset + tm->size;
+	}
+
+	bgfx::TextureHandle create(const TextureResource* tr, u32 first_mip, const void* data, bgfx::ReleaseFn release, void* user_data)
+	{
+		const bgfx::Memory* mem = bgfx::makeRef(data, mips_size(tr, first_mip), release, user_data);
+
+		if (tr->num_mips == 0)
+			return bgfx::createTexture(mem);
+
+		return bgfx::createTexture2D(u16(max(1u, tr->width >> first_mip))
+			, u16(max(1u, tr->height >> first_mip))
+			, tr->num_mips - first_mip > 1
+			, 1
+			, (bgfx::TextureFormat::Enum)tr->format
+			, BGFX_TEXTURE_NONE|BGFX_SAMPLER_NONE
+			, mem
+			);
+	}
+
+} // namespace texture_resource
+
 #if CROWN_CAN_COMPILE
 namespace texture_resource_internal
 {
@@ -137,10 +224,64 @@ namespace texture_resource_internal
 		Buffer blob = opts.read_temporary(tex_out.c_str());
 		opts.delete_file(tex_out.c_str());
 
-		// Write DDS
+		bimg::ImageContainer ic;
+		const bool parsed = bimg::imageParse(ic, array::begin(blob), array::size(blob));
+		DATA_COMPILER_ASSERT(parsed
+			, opts
+			, "Failed to parse texture"
+			);
+
+		// Only 2D textures with a full mip chain can be streamed.
+		u32 num_mips = 0;
+		if (ic.m_numMips > 1
+			&& ic.m_depth == 1
+			&& ic.m_numLayers == 1
+			&& !ic.m_cubeMap
+			)
+		{
+			u32 full_chain = 1;
+			for (u32 mm = max(ic.m_width, ic.m_height); mm > 1; mm >>= 1)
+				++full_chain;
+
+			if (ic.m_numMips == full_chain)
+				num_mips = ic.m_numMips;
+		}
+
 		opts.write(RESOURCE_HEADER(RESOURCE_VERSION_TEXTURE));
-		opts.write(array::size(blob));
-		opts.write(blob);
+		opts.write(u32(ic.m_format));
+		opts.write(ic.m_width);
+		opts.write(ic.m_height);
+		opts.write(num_mips);
+
+		if (num_mips == 0)
+		{
+			// Write KTX
+			opts.write(array::size(blob));
+			opts.write(blob);
+			return 0;
+		}
+
+		// Write mips from the smallest to the largest
+		bimg::ImageMip mips[32];
+		u32 size = 0;
+		for (u32 i = 0; i < num_mips; ++i)
+		{
+			bimg::imageGetRawData(ic, 0, u8(i), array::begin(blob), array::size(blob), mips[i]);
+			size += mips[i].m_size;
+		}
+
+		opts.write(size);
+
+		u32 offset = size;
+		for (u32 i = 0; i < num_mips; ++i)
+		{
+			offset -= mips[i].m_size;
+			opts.write(offset);
+			opts.write(mips[i].m_size);
+		}
+
+		for (u32 i = num_mips; i-- > 0;)
+			opts.write(mips[i].m_data, mips[i].m_size);
 
 		return 0;
 	}
@@ -14,10 +14,30 @@
 
 namespace crown
 {
+struct TextureMip
+{
+	u32 offset; ///< Offset of the mip's data from the beginning of the texture's data.
+	u32 size;
+};
+
+/// Texture data is stored either as a KTX container or, when the texture
+/// can be streamed, as a list of mips ordered from the smallest to the
+/// largest so that the low mips can be loaded with a single read.
 struct TextureResource
 {
-	const bgfx::Memory* mem;
+	void* data;                 ///< Resident data, from the largest mip to the smallest.
+	u32 size;
 	bgfx::TextureHandle handle;
+	u32 format;                 ///< bgfx::TextureFormat::Enum.
+	u32 width;
+	u32 height;
+	u32 num_mips;               ///< 0 if the data is a KTX container.
+	u32 low_mip;                ///< Largest mip loaded along with the resource.
+	u32 resident_mip;           ///< Largest mip resident on the GPU.
+	u32 stream_id;              ///< Identifies the pending stream request, if any.
+	u32 last_used;              ///< Frame the texture has been used last.
+	// TextureMip mips[num_mips]
+	// u8 data[size]
 };
 
 namespace texture_resource_internal
@@ -30,4 +50,18 @@ namespace texture_resource_internal
 
 } // namespace texture_resource_internal
 
+namespace texture_resource
+{
+	/// Returns the @a i-th mip of the texture @a tr.
+	const TextureMip* mip(const TextureResource* tr, u32 i);
+
+	/// Returns the size in bytes of the mips of @a tr from @a first_mip to the smallest one.
+	u32 mips_size(const TextureResource* tr, u32 first_mip);
+
+	/// Creates the GPU texture of @a tr using the @a data of the mips from @a first_mip to the smallest one.
+	/// @a data is released with @a release when bgfx is done with it.
+	bgfx::TextureHandle create(const TextureResource* tr, u32 first_mip, const void* data, bgfx::ReleaseFn release = NULL, void* user_data = NULL);
+
+} // namespace texture_resource
+
 } // namespace crown
@@ -58,18 +58,18 @@ struct UnitResource;
 #define RESOURCE_VERSION_STATE_MACHINE    RESOURCE_VERSION(2)
 #define RESOURCE_VERSION_CONFIG           RESOURCE_VERSION(1)
 #define RESOURCE_VERSION_FONT             RESOURCE_VERSION(1)
-#define RESOURCE_VERSION_UNIT             RESOURCE_VERSION(3)
+#define RESOURCE_VERSION_UNIT             RESOURCE_VERSION(7)
 #define RESOURCE_VERSION_LEVEL            (RESOURCE_VERSION_UNIT + 2) //!< Level embeds UnitResource
 #define RESOURCE_VERSION_MATERIAL         RESOURCE_VERSION(2)
 #define RESOURCE_VERSION_MESH             RESOURCE_VERSION(1)
 #define RESOURCE_VERSION_PACKAGE          RESOURCE_VERSION(4)
-#define RESOURCE_VERSION_PHYSICS_CONFIG   RESOURCE_VERSION(1)
+#define RESOURCE_VERSION_PHYSICS_CONFIG   RESOURCE_VERSION(3)
 #define RESOURCE_VERSION_SCRIPT           RESOURCE_VERSION(1)
 #define RESOURCE_VERSION_SHADER           RESOURCE_VERSION(3)
-#define RESOURCE_VERSION_SOUND            RESOURCE_VERSION(1)
+#define RESOURCE_VERSION_SOUND            RESOURCE_VERSION(2)
 #define RESOURCE_VERSION_SPRITE_ANIMATION RESOURCE_VERSION(1)
 #define RESOURCE_VERSION_SPRITE           RESOURCE_VERSION(2)
-#define RESOURCE_VERSION_TEXTURE          RESOURCE_VERSION(1)
+#define RESOURCE_VERSION_TEXTURE          RESOURCE_VERSION(2)
 
 #define RESOURCE_MAGIC                    u32(0x9B) //!< Non-UTF8 to early out on file type detection
 #define RESOURCE_HEADER(version)          u32((version & 0x00ffffff) << 8 | RESOURCE_MAGIC)
@@ -6,13 +6,21 @@
 #include "config.h"
 #include "core/containers/array.inl"
 #include "core/memory/globals.h"
+#include "resource/types.h"
 #include "resource/unit_compiler.h"
+#include "resource/unit_resource.h"
+#include "world/physics.h"
 
 namespace crown
 {
-#if CROWN_CAN_COMPILE
 namespace unit_resource_internal
 {
+	void offline(StringId64 id, ResourceManager& /*rm*/)
+	{
+		physics_globals::resource_offline(RESOURCE_TYPE_UNIT, id);
+	}
+
+#if CROWN_CAN_COMPILE
 	s32 compile(CompileOptions& opts)
 	{
 		Buffer unit_data(default_allocator());
@@ -24,8 +32,8 @@ namespace unit_resource_internal
 		opts.write(uc.blob());
 		return 0;
 	}
+#endif // CROWN_CAN_COMPILE
 
 } // namespace unit_resource_internal
-#endif // CROWN_CAN_COMPILE
 
 } // namespace crown
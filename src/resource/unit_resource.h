@@ -31,6 +31,7 @@ struct ComponentData
 namespace unit_resource_internal
 {
 	s32 compile(CompileOptions& opts);
+	void offline(StringId64 id, ResourceManager& rm);
 
 } // namespace unit_resource_internal
 
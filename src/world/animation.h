@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2012-2020 Daniele Bartolini and individual contributors.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#pragma once
+
+#include "core/memory/types.h"
+
+namespace crown
+{
+/// Global animation-related functions
+///
+/// @ingroup World
+namespace animation_globals
+{
+	/// Initializes the animation system.
+	/// This is the place where to create and initialize per-application objects.
+	/// If @a num_threads is greater than 1, the state machines of all the
+	/// worlds are evaluated on a pool of @a num_threads threads, the calling
+	/// thread included.
+	void init(Allocator& a, u32 num_threads);
+
+	/// It should reverse the actions performed by animation_globals::init().
+	void shutdown(Allocator& a);
+
+} // namespace animation_globals
+
+} // namespace crown
@@ -6,15 +6,21 @@
 #include "core/containers/array.inl"
 #include "core/containers/hash_map.inl"
 #include "core/containers/types.h"
-#include "core/memory/globals.h"
+#include "core/memory/allocator.h"
+#include "core/memory/memory.inl"
+#include "core/memory/temp_allocator.inl"
+#include "core/thread/semaphore.h"
+#include "core/thread/thread.h"
 #include "resource/expression_language.h"
 #include "resource/resource_manager.h"
 #include "resource/sprite_resource.h"
 #include "resource/state_machine_resource.h"
+#include "world/animation.h"
 #include "world/animation_state_machine.h"
 #include "world/event_stream.inl"
 #include "world/types.h"
 #include "world/unit_manager.h"
+#include <string.h> // memcpy
 
 namespace crown
 {
@@ -23,13 +29,90 @@ static void unit_destroyed_callback_bridge(UnitId id, void* user_ptr)
 	((AnimationStateMachine*)user_ptr)->unit_destroyed_callback(id);
 }
 
+static u32 variable_bit(u32 variable_id)
+{
+	return 1u << min(variable_id, 31u);
+}
+
+namespace animation_globals
+{
+	static u32 _num_threads;
+	static Thread* _threads[CROWN_ANIMATION_MAX_THREADS];
+	static Semaphore* _work_sem;
+	static Semaphore* _done_sem;
+	static AtomicInt* _exit;
+	static AnimationStateMachine* _state_machine; ///< State machine being evaluated by the workers.
+
+	static s32 worker_main(void* /*user_data*/)
+	{
+		while (true)
+		{
+			_work_sem->wait();
+			if (_exit->load())
+				break;
+
+			_state_machine->evaluate_chunks();
+			_done_sem->post();
+		}
+
+		return 0;
+	}
+
+	void init(Allocator& a, u32 num_threads)
+	{
+		_num_threads   = max(1u, min(num_threads, (u32)CROWN_ANIMATION_MAX_THREADS));
+		_work_sem      = CE_NEW(a, Semaphore)();
+		_done_sem      = CE_NEW(a, Semaphore)();
+		_exit          = CE_NEW(a, AtomicInt)(0);
+		_state_machine = NULL;
+
+		for (u32 i = 1; i < _num_threads; ++i)
+		{
+			_threads[i] = CE_NEW(a, Thread)();
+			_threads[i]->start(worker_main, NULL);
+		}
+	}
+
+	void shutdown(Allocator& a)
+	{
+		_exit->store(1);
+		_work_sem->post(_num_threads - 1);
+
+		for (u32 i = 1; i < _num_threads; ++i)
+		{
+			_threads[i]->stop();
+			CE_DELETE(a, _threads[i]);
+		}
+
+		CE_DELETE(a, _exit);
+		CE_DELETE(a, _done_sem);
+		CE_DELETE(a, _work_sem);
+	}
+
+	/// Evaluates the chunks of @a sm on the calling thread and on
+	/// @a num_workers workers.
+	static void evaluate_chunks(AnimationStateMachine& sm, u32 num_workers)
+	{
+		_state_machine = &sm;
+		_work_sem->post(num_workers);
+		sm.evaluate_chunks();
+		for (u32 i = 0; i < num_workers; ++i)
+			_done_sem->wait();
+		_state_machine = NULL;
+	}
+
+} // namespace animation_globals
+
 AnimationStateMachine::AnimationStateMachine(Allocator& a, ResourceManager& rm, UnitManager& um)
 	: _marker(ANIMATION_STATE_MACHINE_MARKER)
+	, _allocator(&a)
 	, _resource_manager(&rm)
 	, _unit_manager(&um)
 	, _map(a)
-	, _animations(a)
+	, _variables(a)
+	, _num_dead_variables(0)
 	, _events(a)
+	, _next(0)
 {
 	_unit_destroy_callback.destroy = unit_destroyed_callback_bridge;
 	_unit_destroy_callback.user_data = this;
@@ -41,6 +124,9 @@ AnimationStateMachine::AnimationStateMachine(Allocator& a, ResourceManager& rm,
 AnimationStateMachine::~AnimationStateMachine()
 {
 	_unit_manager->unregister_destroy_callback(&_unit_destroy_callback);
+
+	_allocator->deallocate(_data.buffer);
+
 	_marker = 0;
 }
 
@@ -50,22 +136,26 @@ u32 AnimationStateMachine::create(UnitId unit, const AnimationStateMachineDesc&
 
 	const StateMachineResource* smr = (StateMachineResource*)_resource_manager->get(RESOURCE_TYPE_STATE_MACHINE, desc.state_machine_resource);
 
-	Animation anim;
-	anim.unit          = unit;
-	anim.time          = 0.0f;
-	anim.time_total    = 0.0f;
-	anim.num_frames    = 0;
-	anim.frames        = NULL;
-	anim.resource      = NULL;
-	anim.state         = state_machine::initial_state(smr);
-	anim.state_next    = NULL;
-	anim.state_machine = smr;
-	anim.variables     = (f32*)default_allocator().allocate(sizeof(*anim.variables)*smr->num_variables);
-
-	memcpy(anim.variables, state_machine::variables(smr), sizeof(*anim.variables)*smr->num_variables);
-
-	u32 last = array::size(_animations);
-	array::push_back(_animations, anim);
+	if (_data.capacity == _data.size)
+		allocate(_data.capacity * 2 + 1);
+
+	const u32 last = _data.size;
+
+	_data.unit[last]          = unit;
+	_data.state_machine[last] = smr;
+	_data.state_next[last]    = NULL;
+	_data.variables[last]     = array::size(_variables);
+	_data.animation[last]     = StringId64();
+	_data.speed[last]         = 1.0f;
+	_data.time[last]          = 0.0f;
+	_data.resource[last]      = NULL;
+
+	array::push(_variables, state_machine::variables(smr), smr->num_variables);
+
+	++_data.size;
+
+	set_state(last, state_machine::initial_state(smr));
+
 	hash_map::set(_map, unit, last);
 	return 0;
 }
@@ -73,15 +163,34 @@ u32 AnimationStateMachine::create(UnitId unit, const AnimationStateMachineDesc&
 void AnimationStateMachine::destroy(UnitId unit)
 {
 	const u32 i = hash_map::get(_map, unit, UINT32_MAX);
-	const u32 last_i = array::size(_animations) - 1;
-	const UnitId last_u = _animations[last_i].unit;
+	CE_ASSERT(i < _data.size, "Index out of bounds");
 
-	default_allocator().deallocate(_animations[i].variables);
-	_animations[i] = _animations[last_i];
+	const u32 last = _data.size - 1;
+	const UnitId last_u = _data.unit[last];
+
+	_num_dead_variables += _data.state_machine[i]->num_variables;
+
+	_data.unit[i]           = _data.unit[last];
+	_data.state_machine[i]  = _data.state_machine[last];
+	_data.state[i]          = _data.state[last];
+	_data.state_next[i]     = _data.state_next[last];
+	_data.variables[i]      = _data.variables[last];
+	_data.variables_mask[i] = _data.variables_mask[last];
+	_data.dirty[i]          = _data.dirty[last];
+	_data.animation[i]      = _data.animation[last];
+	_data.speed[i]          = _data.speed[last];
+	_data.time[i]           = _data.time[last];
+	_data.resource[i]       = _data.resource[last];
+
+	--_data.size;
 
-	array::pop_back(_animations);
 	hash_map::set(_map, last_u, i);
 	hash_map::remove(_map, unit);
+
+	// Reclaim the variables of destroyed instances once they make up
+	// at least half of the pool.
+	if (_num_dead_variables > 0 && _num_dead_variables*2 >= array::size(_variables))
+		compact_variables();
 }
 
 u32 AnimationStateMachine::instances(UnitId unit)
@@ -97,7 +206,7 @@ bool AnimationStateMachine::has(UnitId unit)
 u32 AnimationStateMachine::variable_id(UnitId unit, StringId32 name)
 {
 	const u32 i = hash_map::get(_map, unit, UINT32_MAX);
-	const u32 index = state_machine::variable_index(_animations[i].state_machine, name);
+	const u32 index = state_machine::variable_index(_data.state_machine[i], name);
 	return index;
 }
 
@@ -105,14 +214,18 @@ f32 AnimationStateMachine::variable(UnitId unit, u32 variable_id)
 {
 	const u32 i = hash_map::get(_map, unit, UINT32_MAX);
 	CE_ENSURE(variable_id != UINT32_MAX);
-	return _animations[i].variables[variable_id];
+	return _variables[_data.variables[i] + variable_id];
 }
 
 void AnimationStateMachine::set_variable(UnitId unit, u32 variable_id, f32 value)
 {
 	const u32 i = hash_map::get(_map, unit, UINT32_MAX);
 	CE_ENSURE(variable_id != UINT32_MAX);
-	_animations[i].variables[variable_id] = value;
+
+	f32& var = _variables[_data.variables[i] + variable_id];
+	if (var != value && (_data.variables_mask[i] & variable_bit(variable_id)))
+		_data.dirty[i] = true;
+	var = value;
 }
 
 void AnimationStateMachine::trigger(UnitId unit, StringId32 event)
@@ -120,8 +233,8 @@ void AnimationStateMachine::trigger(UnitId unit, StringId32 event)
 	const u32 i = hash_map::get(_map, unit, UINT32_MAX);
 
 	const Transition* transition;
-	const State* s = state_machine::trigger(_animations[i].state_machine
-		, _animations[i].state
+	const State* s = state_machine::trigger(_data.state_machine[i]
+		, _data.state[i]
 		, event
 		, &transition
 		);
@@ -130,104 +243,183 @@ void AnimationStateMachine::trigger(UnitId unit, StringId32 event)
 		return;
 
 	if (transition->mode == TransitionMode::IMMEDIATE)
-		_animations[i].state = s;
+		set_state(i, s);
 	else if (transition->mode == TransitionMode::WAIT_UNTIL_END)
-		_animations[i].state_next = s;
+		_data.state_next[i] = s;
 	else
 		CE_FATAL("Unknown transition mode");
 }
 
-void AnimationStateMachine::update(float dt)
+void AnimationStateMachine::evaluate(u32 begin, u32 end)
 {
-	f32 stack_data[32];
-	skinny::expression_language::Stack stack(stack_data, countof(stack_data));
+	u32 batch[CROWN_ANIMATION_BATCH_SIZE];
+	f32 max_v[CROWN_ANIMATION_BATCH_SIZE];
+	u32 max_i[CROWN_ANIMATION_BATCH_SIZE];
+	StringId64 name[CROWN_ANIMATION_BATCH_SIZE];
+	f32 stack_data[32*CROWN_ANIMATION_BATCH_SIZE];
 
-	for (u32 i = 0; i < array::size(_animations); ++i)
+	TempAllocator4096 ta;
+	Array<f32> columns(ta);
+
+	const f32* variables = array::begin(_variables);
+
+	for (u32 i = begin; i < end; ++i)
 	{
-		Animation& anim_i = _animations[i];
+		if (!_data.dirty[i])
+			continue;
 
-		const f32* variables = anim_i.variables;
-		const u32* byte_code = state_machine::byte_code(anim_i.state_machine);
+		const StateMachineResource* smr = _data.state_machine[i];
+		const u32* byte_code = state_machine::byte_code(smr);
+		const State* state = _data.state[i];
+
+		// Collect the dirty instances in the same state: they run the same
+		// byte code, so they can be evaluated in a single pass. Look ahead
+		// a bounded number of instances to keep the search linear.
+		const u32 last = min(end, i + CROWN_ANIMATION_GRAIN_SIZE);
+		u32 num = 0;
+		for (u32 j = i; j < last && num < countof(batch); ++j)
+		{
+			if (_data.dirty[j] && _data.state[j] == state)
+				batch[num++] = j;
+		}
+
+		// Store the variables in columns, one per variable.
+		const u32 num_variables = smr->num_variables;
+		array::resize(columns, num_variables*num);
+		for (u32 k = 0; k < num; ++k)
+		{
+			const f32* vars = &variables[_data.variables[batch[k]]];
+			for (u32 v = 0; v < num_variables; ++v)
+				columns[v*num + k] = vars[v];
+		}
+
+		skinny::expression_language::Stack stack(stack_data, 32*num);
 
 		// Evaluate animation weights
-		f32 max_v = 0.0f;
-		u32 max_i = UINT32_MAX;
-		StringId64 name;
+		for (u32 k = 0; k < num; ++k)
+		{
+			max_v[k] = 0.0f;
+			max_i[k] = UINT32_MAX;
+		}
 
-		const AnimationArray* aa = state_machine::state_animations(anim_i.state);
-		for (u32 i = 0; i < aa->num; ++i)
+		const AnimationArray* aa = state_machine::state_animations(state);
+		for (u32 j = 0; j < aa->num; ++j)
 		{
-			const crown::Animation* animation = state_machine::animation(aa, i);
+			const crown::Animation* animation = state_machine::animation(aa, j);
 
 			stack.size = 0;
-			skinny::expression_language::run(&byte_code[animation->bytecode_entry], variables, stack);
-			const f32 cur = stack.size > 0 ? stack_data[stack.size-1] : 0.0f;
-			if (cur > max_v || max_i == UINT32_MAX)
+			skinny::expression_language::run(&byte_code[animation->bytecode_entry], array::begin(columns), num, num, stack);
+			for (u32 k = 0; k < num; ++k)
 			{
-				max_v = cur;
-				max_i = i;
-				name = animation->name;
+				const f32 cur = stack.size >= num ? stack_data[stack.size - num + k] : 0.0f;
+				if (cur > max_v[k] || max_i[k] == UINT32_MAX)
+				{
+					max_v[k] = cur;
+					max_i[k] = j;
+					name[k]  = animation->name;
+				}
 			}
 		}
 
 		// Evaluate animation speed
 		stack.size = 0;
-		skinny::expression_language::run(&byte_code[anim_i.state->speed_bytecode], variables, stack);
-		const f32 speed = stack.size > 0 ? stack_data[stack.size-1] : 1.0f;
+		skinny::expression_language::run(&byte_code[state->speed_bytecode], array::begin(columns), num, num, stack);
+
+		for (u32 k = 0; k < num; ++k)
+		{
+			const u32 inst = batch[k];
+			_data.animation[inst] = name[k];
+			_data.speed[inst]     = stack.size >= num ? stack_data[stack.size - num + k] : 1.0f;
+			_data.dirty[inst]     = false;
+		}
+	}
+}
+
+void AnimationStateMachine::evaluate_chunks()
+{
+	const s32 size = (s32)_data.size;
+
+	while (true)
+	{
+		const s32 begin = _next.fetch_add(CROWN_ANIMATION_GRAIN_SIZE);
+		if (begin >= size)
+			break;
+
+		evaluate(begin, min(begin + CROWN_ANIMATION_GRAIN_SIZE, size));
+	}
+}
+
+void AnimationStateMachine::update(float dt)
+{
+	// Evaluate the expressions of all instances, sharing the chunks with the
+	// worker threads if there is more than one.
+	const u32 num_chunks = (_data.size + CROWN_ANIMATION_GRAIN_SIZE - 1) / CROWN_ANIMATION_GRAIN_SIZE;
+	const u32 num_workers = num_chunks > 1 ? min(num_chunks, animation_globals::_num_threads) - 1 : 0;
+
+	if (num_workers == 0)
+	{
+		evaluate(0, _data.size);
+	}
+	else
+	{
+		_next.store(0);
+		animation_globals::evaluate_chunks(*this, num_workers);
+	}
 
-		// Advance animation
-		const SpriteAnimationResource* sar = (SpriteAnimationResource*)_resource_manager->get(RESOURCE_TYPE_SPRITE_ANIMATION, name);
-		if (anim_i.resource != sar)
+	// Advance animations
+	for (u32 i = 0; i < _data.size; ++i)
+	{
+		const SpriteAnimationResource* sar = (SpriteAnimationResource*)_resource_manager->get(RESOURCE_TYPE_SPRITE_ANIMATION, _data.animation[i]);
+		if (_data.resource[i] != sar)
 		{
-			anim_i.time       = 0.0f;
-			anim_i.time_total = sar->total_time;
-			anim_i.num_frames = sar->num_frames;
-			anim_i.frames     = sprite_animation_resource::frames(sar);
-			anim_i.resource   = sar;
+			_data.time[i]     = 0.0f;
+			_data.resource[i] = sar;
 		}
 
-		if (!anim_i.resource)
+		if (!sar)
 			continue;
 
-		const f32 frame_ratio     = anim_i.time / anim_i.time_total;
-		const u32 frame_unclamped = u32(frame_ratio * f32(anim_i.num_frames));
-		const u32 frame_index     = min(frame_unclamped, anim_i.num_frames-1);
+		const f32 time_total      = sar->total_time;
+		const u32 num_frames      = sar->num_frames;
+		const f32 frame_ratio     = _data.time[i] / time_total;
+		const u32 frame_unclamped = u32(frame_ratio * f32(num_frames));
+		const u32 frame_index     = min(frame_unclamped, num_frames-1);
 
-		anim_i.time += dt*speed;
+		_data.time[i] += dt*_data.speed[i];
 
 		// If animation finished playing
-		if (anim_i.time > anim_i.time_total)
+		if (_data.time[i] > time_total)
 		{
-			if (anim_i.state_next)
+			if (_data.state_next[i])
 			{
-				anim_i.state = anim_i.state_next;
-				anim_i.state_next = NULL;
-				anim_i.time = 0.0f;
+				set_state(i, _data.state_next[i]);
+				_data.state_next[i] = NULL;
+				_data.time[i] = 0.0f;
 			}
 			else
 			{
-				if (!!anim_i.state->loop)
+				if (!!_data.state[i]->loop)
 				{
-					anim_i.time = anim_i.time - anim_i.time_total;
+					_data.time[i] = _data.time[i] - time_total;
 				}
 				else
 				{
 					const Transition* dummy;
-					const State* s = state_machine::trigger(anim_i.state_machine
-						, anim_i.state
+					const State* s = state_machine::trigger(_data.state_machine[i]
+						, _data.state[i]
 						, StringId32("animation_end")
 						, &dummy
 						);
-					anim_i.time = anim_i.state != s ? 0.0f : anim_i.time_total;
-					anim_i.state = s;
+					_data.time[i] = _data.state[i] != s ? 0.0f : time_total;
+					set_state(i, s);
 				}
 			}
 		}
 
 		// Emit events
 		SpriteFrameChangeEvent ev;
-		ev.unit      = anim_i.unit;
-		ev.frame_num = anim_i.frames[frame_index];
+		ev.unit      = _data.unit[i];
+		ev.frame_num = sprite_animation_resource::frames(sar)[frame_index];
 		event_stream::write(_events, 0, ev);
 	}
 }
@@ -238,4 +430,82 @@ void AnimationStateMachine::unit_destroyed_callback(UnitId unit)
 		destroy(unit);
 }
 
+void AnimationStateMachine::allocate(u32 num)
+{
+	CE_ASSERT(num > _data.size, "num > _data.size");
+
+	const u32 bytes = 0
+		+ num*sizeof(UnitId) + alignof(UnitId)
+		+ num*sizeof(StateMachineResource*) + alignof(StateMachineResource*)
+		+ num*sizeof(State*) * 2 + alignof(State*)
+		+ num*sizeof(u32) * 2 + alignof(u32)
+		+ num*sizeof(bool) + alignof(bool)
+		+ num*sizeof(StringId64) + alignof(StringId64)
+		+ num*sizeof(f32) * 2 + alignof(f32)
+		+ num*sizeof(SpriteAnimationResource*) + alignof(SpriteAnimationResource*)
+		;
+
+	InstanceData new_data;
+	new_data.size = _data.size;
+	new_data.capacity = num;
+	new_data.buffer = _allocator->allocate(bytes);
+
+	new_data.unit           = (UnitId*                        )memory::align_top(new_data.buffer,               alignof(UnitId                  ));
+	new_data.state_machine  = (const StateMachineResource**   )memory::align_top(new_data.unit + num,           alignof(StateMachineResource*   ));
+	new_data.state          = (const State**                  )memory::align_top(new_data.state_machine + num,  alignof(State*                  ));
+	new_data.state_next     = (const State**                  )memory::align_top(new_data.state + num,          alignof(State*                  ));
+	new_data.variables      = (u32*                           )memory::align_top(new_data.state_next + num,     alignof(u32                     ));
+	new_data.variables_mask = (u32*                           )memory::align_top(new_data.variables + num,      alignof(u32                     ));
+	new_data.dirty          = (bool*                          )memory::align_top(new_data.variables_mask + num, alignof(bool                    ));
+	new_data.animation      = (StringId64*                    )memory::align_top(new_data.dirty + num,          alignof(StringId64              ));
+	new_data.speed          = (f32*                           )memory::align_top(new_data.animation + num,      alignof(f32                     ));
+	new_data.time           = (f32*                           )memory::align_top(new_data.speed + num,          alignof(f32                     ));
+	new_data.resource       = (const SpriteAnimationResource**)memory::align_top(new_data.time + num,           alignof(SpriteAnimationResource*));
+
+	memcpy(new_data.unit, _data.unit, _data.size * sizeof(UnitId));
+	memcpy(new_data.state_machine, _data.state_machine, _data.size * sizeof(StateMachineResource*));
+	memcpy(new_data.state, _data.state, _data.size * sizeof(State*));
+	memcpy(new_data.state_next, _data.state_next, _data.size * sizeof(State*));
+	memcpy(new_data.variables, _data.variables, _data.size * sizeof(u32));
+	memcpy(new_data.variables_mask, _data.variables_mask, _data.size * sizeof(u32));
+	memcpy(new_data.dirty, _data.dirty, _data.size * sizeof(bool));
+	memcpy(new_data.animation, _data.animation, _data.size * sizeof(StringId64));
+	memcpy(new_data.speed, _data.speed, _data.size * sizeof(f32));
+	memcpy(new_data.time, _data.time, _data.size * sizeof(f32));
+	memcpy(new_data.resource, _data.resource, _data.size * sizeof(SpriteAnimationResource*));
+
+	_allocator->deallocate(_data.buffer);
+	_data = new_data;
+}
+
+void AnimationStateMachine::set_state(u32 i, const State* s)
+{
+	const u32* byte_code = state_machine::byte_code(_data.state_machine[i]);
+
+	u32 mask = skinny::expression_language::variables_mask(&byte_code[s->speed_bytecode]);
+	const AnimationArray* aa = state_machine::state_animations(s);
+	for (u32 j = 0; j < aa->num; ++j)
+		mask |= skinny::expression_language::variables_mask(&byte_code[state_machine::animation(aa, j)->bytecode_entry]);
+
+	_data.state[i]          = s;
+	_data.variables_mask[i] = mask;
+	_data.dirty[i]          = true;
+}
+
+void AnimationStateMachine::compact_variables()
+{
+	Array<f32> variables(*_allocator);
+	array::reserve(variables, array::size(_variables) - _num_dead_variables);
+
+	for (u32 i = 0; i < _data.size; ++i)
+	{
+		const u32 offset = array::size(variables);
+		array::push(variables, &_variables[_data.variables[i]], _data.state_machine[i]->num_variables);
+		_data.variables[i] = offset;
+	}
+
+	_variables = variables;
+	_num_dead_variables = 0;
+}
+
 } // namespace crown
@@ -5,7 +5,9 @@
 
 #pragma once
 
+#include "config.h"
 #include "core/containers/types.h"
+#include "core/thread/atomic_int.h"
 #include "resource/state_machine_resource.h"
 #include "resource/types.h"
 #include "world/event_stream.h"
@@ -21,28 +23,56 @@ struct SpriteFrameChangeEvent
 
 struct AnimationStateMachine
 {
-	struct Animation
+	struct InstanceData
 	{
-		UnitId unit;
-		f32 time_total;
-		f32 time;
-		u32 num_frames;
-		const u32* frames;
-		const SpriteAnimationResource* resource;
-		const State* state;
-		const State* state_next;
-		const StateMachineResource* state_machine;
-		f32* variables;
+		InstanceData()
+			: size(0)
+			, capacity(0)
+			, buffer(NULL)
+			, unit(NULL)
+			, state_machine(NULL)
+			, state(NULL)
+			, state_next(NULL)
+			, variables(NULL)
+			, variables_mask(NULL)
+			, dirty(NULL)
+			, animation(NULL)
+			, speed(NULL)
+			, time(NULL)
+			, resource(NULL)
+		{
+		}
+
+		u32 size;
+		u32 capacity;
+		void* buffer;
+
+		UnitId* unit;
+		const StateMachineResource** state_machine;
+		const State** state;
+		const State** state_next;
+		u32* variables;                            ///< Offset of the first variable in _variables.
+		u32* variables_mask;                       ///< Variables read by the expressions of the current state.
+		bool* dirty;                               ///< Whether the expressions must be evaluated again.
+		StringId64* animation;                     ///< Animation with the largest weight.
+		f32* speed;                                ///< Playback speed of the animation.
+		f32* time;
+		const SpriteAnimationResource** resource;
 	};
 
 	u32 _marker;
+	Allocator* _allocator;
 	ResourceManager* _resource_manager;
 	UnitManager* _unit_manager;
 	HashMap<UnitId, u32> _map;
-	Array<Animation> _animations;
+	InstanceData _data;
+	Array<f32> _variables;
+	u32 _num_dead_variables;
 	EventStream _events;
 	UnitDestroyCallback _unit_destroy_callback;
 
+	AtomicInt _next;                             ///< First instance of the next chunk to evaluate.
+
 	///
 	AnimationStateMachine(Allocator& a, ResourceManager& rm, UnitManager& um);
 
@@ -78,6 +108,23 @@ struct AnimationStateMachine
 
 	///
 	void unit_destroyed_callback(UnitId unit);
+
+	///
+	void allocate(u32 num);
+
+	/// Sets the current state of the instance @a i to @a s.
+	void set_state(u32 i, const State* s);
+
+	/// Evaluates the animation weights and speed of the instances
+	/// [begin; end) whose variables or state changed since the last time.
+	/// Instances in the same state are evaluated together, in batches.
+	void evaluate(u32 begin, u32 end);
+
+	/// Evaluates chunks of instances until none is left.
+	void evaluate_chunks();
+
+	/// Moves the variables of the live instances to the front of _variables.
+	void compact_variables();
 };
 
 } // namespace crown
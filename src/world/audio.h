@@ -5,6 +5,10 @@
 
 #pragma once
 
+#include "core/filesystem/types.h"
+#include "core/strings/string_id.h"
+#include "resource/types.h"
+
 namespace crown
 {
 /// Global audio-related functions
@@ -14,11 +18,18 @@ namespace audio_globals
 {
 	/// Initializes the audio system.
 	/// This is the place where to create and initialize per-application objects.
-	void init();
+	/// Streaming sounds are read from @a data_filesystem.
+	void init(Filesystem& data_filesystem);
 
 	/// It should reverse the actions performed by audio_globals::init().
 	void shutdown();
 
+	/// Uploads the data of the sound @a id to a buffer shared by all its instances.
+	void sound_online(StringId64 id, ResourceManager& rm);
+
+	/// Stops the instances of the sound @a id and releases its shared buffer.
+	void sound_offline(StringId64 id, ResourceManager& rm);
+
 } // namespace audio_globals
 
 } // namespace crown
@@ -7,6 +7,7 @@
 #include "core/math/constants.h"
 #include "core/strings/string_id.inl"
 #include "resource/level_resource.h"
+#include "resource/resource_id.h"
 #include "resource/unit_resource.h"
 #include "world/level.h"
 #include "world/unit_manager.h"
@@ -14,11 +15,12 @@
 
 namespace crown
 {
-Level::Level(Allocator& a, UnitManager& um, World& w, const LevelResource& lr)
+Level::Level(Allocator& a, UnitManager& um, World& w, StringId64 name, const LevelResource& lr)
 	: _marker(LEVEL_MARKER)
 	, _allocator(&a)
 	, _unit_manager(&um)
 	, _world(&w)
+	, _name(name)
 	, _resource(&lr)
 	, _unit_lookup(a)
 {
@@ -41,7 +43,7 @@ void Level::load(const Vector3& pos, const Quaternion& rot)
 	for (u32 i = 0; i < ur->num_units; ++i)
 		_unit_lookup[i] = _unit_manager->create();
 
-	spawn_units(*_world, *ur, pos, rot, VECTOR3_ONE, array::begin(_unit_lookup));
+	spawn_units(*_world, *ur, pos, rot, VECTOR3_ONE, array::begin(_unit_lookup), resource_id(RESOURCE_TYPE_LEVEL, _name));
 
 	// Play sounds
 	const u32 num_sounds = level_resource::num_sounds(_resource);
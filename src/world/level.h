@@ -9,6 +9,7 @@
 #include "core/list.h"
 #include "core/math/types.h"
 #include "core/memory/types.h"
+#include "core/strings/string_id.h"
 #include "resource/types.h"
 #include "world/types.h"
 
@@ -23,12 +24,13 @@ struct Level
 	Allocator* _allocator;
 	UnitManager* _unit_manager;
 	World* _world;
+	StringId64 _name;
 	const LevelResource* _resource;
 	Array<UnitId> _unit_lookup;
 	ListNode _node;
 
 	///
-	Level(Allocator& a, UnitManager& um, World& w, const LevelResource& lr);
+	Level(Allocator& a, UnitManager& um, World& w, StringId64 name, const LevelResource& lr);
 
 	///
 	~Level();
@@ -12,10 +12,12 @@
 
 namespace crown
 {
-void Material::bind(ResourceManager& rm, ShaderManager& sm, u8 view, s32 depth) const
+void Material::bind(ResourceManager& rm, ShaderManager& sm, u8 view, s32 depth)
 {
 	using namespace material_resource;
 
+	_used = true;
+
 	// Set samplers
 	for (u32 i = 0; i < _resource->num_textures; ++i)
 	{
@@ -18,9 +18,10 @@ struct Material
 {
 	const MaterialResource* _resource;
 	char* _data;
+	bool _used; ///< Whether the material has been bound since last TextureManager::update().
 
 	///
-	void bind(ResourceManager& rm, ShaderManager& sm, u8 view, s32 depth = 0) const;
+	void bind(ResourceManager& rm, ShaderManager& sm, u8 view, s32 depth = 0);
 
 	/// Sets the @a value of the variable @a name.
 	void set_float(StringId32 name, f32 value);
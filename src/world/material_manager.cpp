@@ -106,6 +106,7 @@ void MaterialManager::create_material(StringId64 id)
 	Material* mat  = (Material*)_allocator->allocate(size);
 	mat->_resource = mr;
 	mat->_data     = (char*)&mat[1];
+	mat->_used     = false;
 
 	const char* data = (char*)mr + mr->dynamic_data_offset;
 	memcpy(mat->_data, data, mr->dynamic_data_size);
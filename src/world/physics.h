@@ -6,6 +6,7 @@
 #pragma once
 
 #include "core/memory/types.h"
+#include "core/strings/string_id.h"
 
 namespace crown
 {
@@ -16,11 +17,25 @@ namespace physics_globals
 {
 	/// Initializes the physics system.
 	/// This is the place where to create and initialize per-application objects.
-	void init(Allocator& a);
+	/// If @a num_threads is greater than 1, physics worlds are stepped on a
+	/// pool of @a num_threads threads, the calling thread included.
+	void init(Allocator& a, u32 num_threads);
 
 	/// It should reverse the actions performed by physics_globals::init().
 	void shutdown(Allocator& a);
 
+	/// Returns the number of threads physics worlds are stepped on.
+	u32 num_threads();
+
+	/// Sets the number of threads physics worlds are stepped on, up to the
+	/// number passed to physics_globals::init().
+	void set_num_threads(u32 num);
+
+	/// Releases the collision shapes shared by the colliders of the unit or
+	/// level @a name of the given @a type. Colliders created afterwards
+	/// build their shapes again.
+	void resource_offline(StringId64 type, StringId64 name);
+
 } // namespace physics_globals
 
 } // namespace crown
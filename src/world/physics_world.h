@@ -24,13 +24,15 @@ struct PhysicsWorld
 	PhysicsWorldImpl* _impl;
 
 	///
-	PhysicsWorld(Allocator& a, ResourceManager& rm, UnitManager& um, DebugLine& dl);
+	PhysicsWorld(Allocator& a, ResourceManager& rm, UnitManager& um, SceneGraph& sg, DebugLine& dl);
 
 	///
 	~PhysicsWorld();
 
-	///
-	ColliderInstance collider_create(UnitId id, const ColliderDesc* sd, const Vector3& scl);
+	/// Creates the @a index-th collider @a sd of the unit or level @a resource.
+	/// Colliders created from the same resource and index with the same scale
+	/// share their collision shape.
+	ColliderInstance collider_create(UnitId id, const ColliderDesc* sd, const Vector3& scl, StringId64 resource, u32 index);
 
 	///
 	void collider_destroy(ColliderInstance i);
@@ -172,6 +174,35 @@ struct PhysicsWorld
 	/// Casts a box into the physics world and returns info about the closest collision if any.
 	bool cast_box(RaycastHit& hit, const Vector3& from, const Vector3& half_extents, const Vector3& dir, f32 len);
 
+	/// Casts @a num rays described by @a queries into the physics world and
+	/// fills @a hits with info about the closest collision of each ray.
+	/// Rays that do not hit anything have a negative hit time.
+	/// Returns the number of rays that hit something.
+	/// @note
+	/// The rays are spread over the physics worker threads, if any.
+	u32 cast_ray_batch(RaycastHit* hits, const RaycastQuery* queries, u32 num);
+
+	/// Same as PhysicsWorld::cast_ray_batch() but sweeps spheres and boxes.
+	u32 sweep_batch(RaycastHit* hits, const SweepQuery* queries, u32 num);
+
+	/// Fills @a hits with up to @a max actors overlapping the sphere at @a center
+	/// with the given @a radius. If @a exact is false, only the bounds of the
+	/// actors are tested. Returns the number of hits.
+	u32 overlap_sphere(OverlapHit* hits, u32 max, const Vector3& center, f32 radius, bool exact);
+
+	/// Same as PhysicsWorld::overlap_sphere() but tests the box at @a center
+	/// with the given @a rotation and @a half_extents.
+	u32 overlap_box(OverlapHit* hits, u32 max, const Vector3& center, const Quaternion& rotation, const Vector3& half_extents, bool exact);
+
+	/// Fills @a hits with up to @a max actors whose bounds overlap @a aabb.
+	/// Returns the number of hits.
+	u32 overlap_aabb(OverlapHit* hits, u32 max, const AABB& aabb);
+
+	/// Runs @a num overlap @a queries and fills @a hits with up to @a max
+	/// actors overlapping them, in query order. The number of hits of each
+	/// query is written to @a num_hits. Returns the total number of hits.
+	u32 overlap_batch(OverlapHit* hits, u32 max, u32* num_hits, const OverlapQuery* queries, u32 num);
+
 	/// Returns the gravity.
 	Vector3 gravity() const;
 
@@ -181,9 +212,16 @@ struct PhysicsWorld
 	///
 	void update_actor_world_poses(const UnitId* begin, const UnitId* end, const Matrix4x4* begin_world);
 
-	/// Updates the physics simulation.
+	/// Advances the physics simulation by @a dt seconds in fixed steps.
 	void update(f32 dt);
 
+	/// Returns the number of fixed steps taken by the last update().
+	u32 num_substeps() const;
+
+	/// Returns the total simulation time dropped because updates were lagging
+	/// behind, in seconds.
+	f32 dropped_time() const;
+
 	///
 	EventStream& events();
 
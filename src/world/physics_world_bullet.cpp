@@ -9,21 +9,33 @@
 
 #include "core/containers/array.inl"
 #include "core/containers/hash_map.inl"
+#include "core/list.inl"
 #include "core/math/color4.inl"
 #include "core/math/constants.h"
 #include "core/math/matrix4x4.inl"
 #include "core/math/quaternion.inl"
 #include "core/math/vector3.inl"
 #include "core/memory/proxy_allocator.h"
+#include "core/memory/temp_allocator.inl"
+#include "core/murmur.h"
+#include "core/strings/string_id.inl"
+#include "core/thread/atomic_int.h"
+#include "core/thread/semaphore.h"
+#include "core/thread/thread.h"
 #include "device/log.h"
 #include "resource/physics_resource.h"
+#include "resource/resource_id.h"
 #include "resource/resource_manager.h"
 #include "world/debug_line.h"
 #include "world/event_stream.inl"
 #include "world/physics.h"
 #include "world/physics_world.h"
+#include "world/scene_graph.h"
 #include "world/unit_manager.h"
+#include <BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h>
 #include <BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcher.h>
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
 #include <BulletCollision/CollisionDispatch/btCollisionObject.h>
 #include <BulletCollision/CollisionDispatch/btDefaultCollisionConfiguration.h>
 #include <BulletCollision/CollisionDispatch/btGhostObject.h>
@@ -33,7 +45,9 @@
 #include <BulletCollision/CollisionShapes/btCompoundShape.h>
 #include <BulletCollision/CollisionShapes/btConvexHullShape.h>
 #include <BulletCollision/CollisionShapes/btConvexTriangleMeshShape.h>
+#include <BulletCollision/CollisionShapes/btOptimizedBvh.h>
 #include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
+#include <BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h>
 #include <BulletCollision/CollisionShapes/btSphereShape.h>
 #include <BulletCollision/CollisionShapes/btStaticPlaneShape.h>
 #include <BulletCollision/CollisionShapes/btTriangleMesh.h>
@@ -42,37 +56,318 @@
 #include <BulletDynamics/ConstraintSolver/btPoint2PointConstraint.h>
 #include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolver.h>
 #include <BulletDynamics/ConstraintSolver/btSliderConstraint.h>
-#define BT_THREADSAFE 0
 #include <BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
 #include <BulletDynamics/Dynamics/btRigidBody.h>
-#include <LinearMath/btDefaultMotionState.h>
 #include <LinearMath/btIDebugDraw.h>
+#include <LinearMath/btMotionState.h>
+#include <LinearMath/btThreads.h>
 
 LOG_SYSTEM(PHYSICS, "physics")
 
 namespace crown
 {
+/// Runs Bullet's parallel loops on a pool of engine threads. The calling
+/// thread takes part in each loop, so @a num_threads includes it.
+struct MyTaskScheduler : public btITaskScheduler
+{
+	struct Worker
+	{
+		MyTaskScheduler* scheduler;
+		u32 index;
+	};
+
+	Allocator* _allocator;
+	Thread* _threads[BT_MAX_THREAD_COUNT];
+	Worker _workers[BT_MAX_THREAD_COUNT];
+	u32 _max_threads;
+	u32 _num_threads;
+	Semaphore _work_sem;
+	Semaphore _done_sem;
+	AtomicInt _next;
+	AtomicInt _exit;
+	const btIParallelForBody* _for_body;
+	const btIParallelSumBody* _sum_body;
+	s32 _end;
+	s32 _grain_size;
+	btScalar _sums[BT_MAX_THREAD_COUNT];
+
+	MyTaskScheduler(Allocator& a, u32 num_threads)
+		: btITaskScheduler("crown")
+		, _allocator(&a)
+		, _max_threads(min(num_threads, BT_MAX_THREAD_COUNT))
+		, _num_threads(_max_threads)
+		, _next(0)
+		, _exit(0)
+		, _for_body(NULL)
+		, _sum_body(NULL)
+		, _end(0)
+		, _grain_size(1)
+	{
+		for (u32 i = 1; i < _max_threads; ++i)
+		{
+			_workers[i].scheduler = this;
+			_workers[i].index = i;
+			_threads[i] = CE_NEW(*_allocator, Thread)();
+			_threads[i]->start(worker_main, &_workers[i]);
+		}
+	}
+
+	~MyTaskScheduler()
+	{
+		_exit.store(1);
+		_work_sem.post(_max_threads - 1);
+
+		for (u32 i = 1; i < _max_threads; ++i)
+		{
+			_threads[i]->stop();
+			CE_DELETE(*_allocator, _threads[i]);
+		}
+	}
+
+	int getMaxNumThreads() const
+	{
+		return (int)_max_threads;
+	}
+
+	int getNumThreads() const
+	{
+		return (int)_num_threads;
+	}
+
+	void setNumThreads(int num_threads)
+	{
+		_num_threads = (u32)btMax(1, btMin((int)_max_threads, num_threads));
+	}
+
+	/// Consumes chunks of the current loop until none is left.
+	void run(u32 index)
+	{
+		while (true)
+		{
+			const s32 begin = _next.fetch_add(_grain_size);
+			if (begin >= _end)
+				break;
+
+			const s32 end = btMin(begin + _grain_size, _end);
+			if (_for_body != NULL)
+				_for_body->forLoop(begin, end);
+			else
+				_sums[index] += _sum_body->sumLoop(begin, end);
+		}
+	}
+
+	/// Runs the current loop on the calling thread and on as many workers as
+	/// there are chunks to share.
+	void dispatch(int begin, int end, int grain_size)
+	{
+		const s32 num_chunks = (end - begin + grain_size - 1) / grain_size;
+		const u32 num_workers = (u32)btMin(num_chunks, (s32)_num_threads) - 1;
+
+		_next.store(begin);
+		_end = end;
+		_grain_size = grain_size;
+
+		for (u32 i = 0; i < _max_threads; ++i)
+			_sums[i] = btScalar(0);
+
+		_work_sem.post(num_workers);
+		run(0);
+		for (u32 i = 0; i < num_workers; ++i)
+			_done_sem.wait();
+	}
+
+	void parallelFor(int begin, int end, int grain_size, const btIParallelForBody& body)
+	{
+		if (_num_threads < 2 || end - begin <= grain_size)
+		{
+			body.forLoop(begin, end);
+			return;
+		}
+
+		_for_body = &body;
+		_sum_body = NULL;
+		dispatch(begin, end, grain_size);
+	}
+
+	btScalar parallelSum(int begin, int end, int grain_size, const btIParallelSumBody& body)
+	{
+		if (_num_threads < 2 || end - begin <= grain_size)
+			return body.sumLoop(begin, end);
+
+		_for_body = NULL;
+		_sum_body = &body;
+		dispatch(begin, end, grain_size);
+
+		btScalar sum = btScalar(0);
+		for (u32 i = 0; i < _max_threads; ++i)
+			sum += _sums[i];
+		return sum;
+	}
+
+	static s32 worker_main(void* user_data)
+	{
+		Worker* worker = (Worker*)user_data;
+		MyTaskScheduler* ts = worker->scheduler;
+
+		while (true)
+		{
+			ts->_work_sem.wait();
+			if (ts->_exit.load())
+				break;
+
+			ts->run(worker->index);
+			ts->_done_sem.post();
+		}
+
+		return 0;
+	}
+};
+
+/// Keeps the manifolds in the same order regardless of which thread created
+/// them, so that the simulation stays deterministic with the same number of
+/// threads.
+struct MyCollisionDispatcherMt : public btCollisionDispatcherMt
+{
+	struct ManifoldLess
+	{
+		bool operator()(const btPersistentManifold* a, const btPersistentManifold* b) const
+		{
+			const int a0 = a->getBody0()->getBroadphaseHandle()->m_uniqueId;
+			const int b0 = b->getBody0()->getBroadphaseHandle()->m_uniqueId;
+			if (a0 != b0)
+				return a0 < b0;
+
+			const int a1 = a->getBody1()->getBroadphaseHandle()->m_uniqueId;
+			const int b1 = b->getBody1()->getBroadphaseHandle()->m_uniqueId;
+			if (a1 != b1)
+				return a1 < b1;
+
+			// Compound and mesh shapes get one manifold per pair of children.
+			// quickSort() is not stable, so tell them apart by their contacts.
+			if (a->getNumContacts() != b->getNumContacts())
+				return a->getNumContacts() < b->getNumContacts();
+			if (a->getNumContacts() == 0)
+				return false;
+
+			const btManifoldPoint& pa = a->getContactPoint(0);
+			const btManifoldPoint& pb = b->getContactPoint(0);
+			if (pa.m_index0 != pb.m_index0)
+				return pa.m_index0 < pb.m_index0;
+			if (pa.m_index1 != pb.m_index1)
+				return pa.m_index1 < pb.m_index1;
+			if (pa.m_partId0 != pb.m_partId0)
+				return pa.m_partId0 < pb.m_partId0;
+			if (pa.m_partId1 != pb.m_partId1)
+				return pa.m_partId1 < pb.m_partId1;
+
+			for (int i = 0; i < 3; ++i)
+			{
+				if (pa.m_localPointA[i] != pb.m_localPointA[i])
+					return pa.m_localPointA[i] < pb.m_localPointA[i];
+			}
+
+			return false;
+		}
+	};
+
+	explicit MyCollisionDispatcherMt(btCollisionConfiguration* config)
+		: btCollisionDispatcherMt(config)
+	{
+	}
+
+	void dispatchAllCollisionPairs(btOverlappingPairCache* pair_cache, const btDispatcherInfo& info, btDispatcher* dispatcher)
+	{
+		btCollisionDispatcherMt::dispatchAllCollisionPairs(pair_cache, info, dispatcher);
+
+		m_manifoldsPtr.quickSort(ManifoldLess());
+		for (int i = 0; i < m_manifoldsPtr.size(); ++i)
+			m_manifoldsPtr[i]->m_index1a = i;
+	}
+};
+
 namespace physics_globals
 {
 	static btDefaultCollisionConfiguration* _bt_configuration;
 	static btCollisionDispatcher* _bt_dispatcher;
 	static btBroadphaseInterface* _bt_interface;
+	static btGhostPairCallback* _bt_ghost_pair_callback; ///< Shared by all the worlds, like the broadphase it is installed in.
 	static btSequentialImpulseConstraintSolver* _bt_solver;
+	static MyTaskScheduler* _bt_task_scheduler;   ///< NULL if physics is stepped on the main thread only.
+	static btConstraintSolverPoolMt* _bt_solver_pool;
+	static ListNode _worlds;
+
+	// Triggers only track overlaps in the broadphase. Their narrowphase is
+	// run on demand by PhysicsWorld::update(), never by the simulation.
+	static void near_callback(btBroadphasePair& pair, btCollisionDispatcher& dispatcher, const btDispatcherInfo& info)
+	{
+		const btCollisionObject* obj_a = (btCollisionObject*)pair.m_pProxy0->m_clientObject;
+		const btCollisionObject* obj_b = (btCollisionObject*)pair.m_pProxy1->m_clientObject;
+
+		if (obj_a->getInternalType() == btCollisionObject::CO_GHOST_OBJECT
+			|| obj_b->getInternalType() == btCollisionObject::CO_GHOST_OBJECT
+			)
+			return;
+
+		btCollisionDispatcher::defaultNearCallback(pair, dispatcher, info);
+	}
 
-	void init(Allocator& a)
+	void init(Allocator& a, u32 num_threads)
 	{
+		_bt_task_scheduler = NULL;
+		_bt_solver_pool    = NULL;
+
 		_bt_configuration = CE_NEW(a, btDefaultCollisionConfiguration);
-		_bt_dispatcher    = CE_NEW(a, btCollisionDispatcher)(_bt_configuration);
+
+		if (num_threads > 1)
+		{
+			// The scheduler must be set before creating any of the Mt objects.
+			_bt_task_scheduler = CE_NEW(a, MyTaskScheduler)(a, num_threads);
+			btSetTaskScheduler(_bt_task_scheduler);
+
+			_bt_dispatcher  = CE_NEW(a, MyCollisionDispatcherMt)(_bt_configuration);
+			_bt_solver_pool = CE_NEW(a, btConstraintSolverPoolMt)(_bt_task_scheduler->getNumThreads());
+		}
+		else
+		{
+			_bt_dispatcher = CE_NEW(a, btCollisionDispatcher)(_bt_configuration);
+		}
+
+		_bt_dispatcher->setNearCallback(near_callback);
 		_bt_interface     = CE_NEW(a, btDbvtBroadphase);
 		_bt_solver        = CE_NEW(a, btSequentialImpulseConstraintSolver);
+
+		_bt_ghost_pair_callback = CE_NEW(a, btGhostPairCallback);
+		_bt_interface->getOverlappingPairCache()->setInternalGhostPairCallback(_bt_ghost_pair_callback);
+
+		list::init_head(_worlds);
 	}
 
 	void shutdown(Allocator& a)
 	{
 		CE_DELETE(a, _bt_solver);
 		CE_DELETE(a, _bt_interface);
+		CE_DELETE(a, _bt_ghost_pair_callback);
+		CE_DELETE(a, _bt_solver_pool);
 		CE_DELETE(a, _bt_dispatcher);
 		CE_DELETE(a, _bt_configuration);
+
+		if (_bt_task_scheduler != NULL)
+		{
+			btSetTaskScheduler(btGetSequentialTaskScheduler());
+			CE_DELETE(a, _bt_task_scheduler);
+		}
+	}
+
+	u32 num_threads()
+	{
+		return _bt_task_scheduler != NULL ? (u32)_bt_task_scheduler->getNumThreads() : 1;
+	}
+
+	void set_num_threads(u32 num)
+	{
+		if (_bt_task_scheduler != NULL)
+			_bt_task_scheduler->setNumThreads((int)num);
 	}
 
 } // namespace physics_globals
@@ -194,13 +489,81 @@ struct MyFilterCallback : public btOverlapFilterCallback
 	}
 };
 
+/// Receives the transforms of active bodies from Bullet and records which of
+/// them moved since the last PhysicsWorld::update().
+struct MyMotionState : public btMotionState
+{
+	btTransform _tm;      ///< Pose after the last step.
+	btTransform _prev_tm; ///< Pose after the step before the last.
+	btRigidBody* _body;
+	Array<btRigidBody*>* _moved;
+	u32 _published;       ///< Last update in which the pose has been published.
+	bool _is_moved;
+
+	MyMotionState(const btTransform& tm, Array<btRigidBody*>& moved)
+		: _tm(tm)
+		, _prev_tm(tm)
+		, _body(NULL)
+		, _moved(&moved)
+		, _published(UINT32_MAX)
+		, _is_moved(false)
+	{
+	}
+
+	void getWorldTransform(btTransform& tm) const
+	{
+		tm = _tm;
+	}
+
+	// Only called by Bullet for active, non-kinematic bodies.
+	void setWorldTransform(const btTransform& tm)
+	{
+		_prev_tm = _tm;
+		_tm = tm;
+
+		if (!_is_moved)
+		{
+			_is_moved = true;
+			array::push_back(*_moved, _body);
+		}
+	}
+
+	/// Sets the pose without recording a move and without interpolating from
+	/// the previous pose.
+	void reset(const btTransform& tm)
+	{
+		_tm = tm;
+		_prev_tm = tm;
+	}
+};
+
 struct PhysicsWorldImpl
 {
+	/// Collision shape shared by all the colliders created from the same
+	/// collider of a resource with the same scale.
+	struct ShapeData
+	{
+		u64 key;
+		StringId64 resource;                      ///< Unit or level resource the collider belongs to.
+		ShapeData* child;                         ///< Unscaled mesh wrapped by the shape, if any.
+		btTriangleIndexVertexArray* vertex_array;
+		btOptimizedBvh* bvh;                      ///< BVH cooked by the data compiler, if any.
+		btCollisionShape* shape;
+		u32 references;
+	};
+
+	/// Links the world into physics_globals::_worlds.
+	struct WorldNode
+	{
+		ListNode node;
+		PhysicsWorldImpl* world;
+	};
+
 	struct ColliderInstanceData
 	{
 		UnitId unit;
 		Matrix4x4 local_tm;
-		btTriangleIndexVertexArray* vertex_array;
+		ShapeData* shape_data;
 		btCollisionShape* shape;
 		ColliderInstance next;
 	};
@@ -208,17 +571,59 @@ struct PhysicsWorldImpl
 	struct ActorInstanceData
 	{
 		UnitId unit;
-		btRigidBody* actor;
+		btRigidBody* actor;                 ///< NULL if the actor is a trigger.
+		btPairCachingGhostObject* trigger;  ///< NULL if the actor is not a trigger.
+		u32 flags;
+		f32 max_linear_velocity;            ///< 0 if the velocity is not limited. Only enforced while the actor is dynamic.
+		TransformInstance transform;        ///< Cached transform of the unit, validated before use.
+	};
+
+	/// Overlap between a trigger and an actor, tracked across updates.
+	struct OverlapData
+	{
+		UnitId trigger;
+		UnitId other;
+		u32 step;    ///< Last update in which the actors were overlapping.
+		bool is_new; ///< Whether trigger enter has not been posted yet.
+	};
+
+	/// Contact between two actors, tracked across updates.
+	struct ContactData
+	{
+		UnitId units[2];
+		ActorInstance actors[2];
+		Vector3 position;
+		Vector3 normal;
+		f32 distance;
+		u32 step;    ///< Last update in which the actors were touching.
+		bool is_new; ///< Whether touch begin has not been posted yet.
+		bool report_contacts;
 	};
 
 	Allocator* _allocator;
 	UnitManager* _unit_manager;
+	SceneGraph* _scene_graph;
 
 	HashMap<UnitId, u32> _collider_map;
 	HashMap<UnitId, u32> _actor_map;
+	HashMap<u64, ShapeData*> _shape_map; ///< Shapes of the resources currently online.
+	HashMap<u64, ContactData> _contacts;
+	HashMap<u64, OverlapData> _overlaps;
+	Array<u64> _ended_contacts;
+	btManifoldArray _manifolds;
+	u32 _step;
+	f32 _accumulator;
+	u32 _num_substeps;
+	f32 _dropped_time;
 	Array<ColliderInstanceData> _collider;
 	Array<ActorInstanceData> _actor;
 	Array<btTypedConstraint*> _joints;
+	Array<btRigidBody*> _moved;
+	Array<UnitId> _interpolating;
+	Array<btRigidBody*> _speed_limited;
+	Array<TransformInstance> _pose_instances;
+	Array<Matrix4x4> _poses;
+	btAlignedObjectArray<const btDbvtNode*> _overlap_stack;
 
 	MyFilterCallback _filter_callback;
 	btDiscreteDynamicsWorld* _dynamics_world;
@@ -229,25 +634,52 @@ struct PhysicsWorldImpl
 
 	const PhysicsConfigResource* _config_resource;
 	bool _debug_drawing;
+	WorldNode _node;
 
-	PhysicsWorldImpl(Allocator& a, ResourceManager& rm, UnitManager& um, DebugLine& dl)
+	PhysicsWorldImpl(Allocator& a, ResourceManager& rm, UnitManager& um, SceneGraph& sg, DebugLine& dl)
 		: _allocator(&a)
 		, _unit_manager(&um)
+		, _scene_graph(&sg)
 		, _collider_map(a)
 		, _actor_map(a)
+		, _shape_map(a)
+		, _contacts(a)
+		, _overlaps(a)
+		, _ended_contacts(a)
+		, _step(0)
+		, _accumulator(0.0f)
+		, _num_substeps(0)
+		, _dropped_time(0.0f)
 		, _collider(a)
 		, _actor(a)
 		, _joints(a)
+		, _moved(a)
+		, _interpolating(a)
+		, _speed_limited(a)
+		, _pose_instances(a)
+		, _poses(a)
 		, _dynamics_world(NULL)
 		, _debug_drawer(dl)
 		, _events(a)
 		, _debug_drawing(false)
 	{
-		_dynamics_world = CE_NEW(*_allocator, btDiscreteDynamicsWorld)(physics_globals::_bt_dispatcher
-			, physics_globals::_bt_interface
-			, physics_globals::_bt_solver
-			, physics_globals::_bt_configuration
-			);
+		if (physics_globals::_bt_solver_pool != NULL)
+		{
+			_dynamics_world = CE_NEW(*_allocator, btDiscreteDynamicsWorldMt)(physics_globals::_bt_dispatcher
+				, physics_globals::_bt_interface
+				, physics_globals::_bt_solver_pool
+				, NULL
+				, physics_globals::_bt_configuration
+				);
+		}
+		else
+		{
+			_dynamics_world = CE_NEW(*_allocator, btDiscreteDynamicsWorld)(physics_globals::_bt_dispatcher
+				, physics_globals::_bt_interface
+				, physics_globals::_bt_solver
+				, physics_globals::_bt_configuration
+				);
+		}
 
 		_dynamics_world->getCollisionWorld()->setDebugDrawer(&_debug_drawer);
 		_dynamics_world->setInternalTickCallback(tick_cb, this);
@@ -260,48 +692,56 @@ struct PhysicsWorldImpl
 		_unit_destroy_callback.node.next = NULL;
 		_unit_destroy_callback.node.prev = NULL;
 		um.register_destroy_callback(&_unit_destroy_callback);
+
+		_node.world = this;
+		list::add(_node.node, physics_globals::_worlds);
 	}
 
 	~PhysicsWorldImpl()
 	{
+		list::remove(_node.node);
 		_unit_manager->unregister_destroy_callback(&_unit_destroy_callback);
 
 		for (u32 i = 0; i < array::size(_actor); ++i)
-		{
-			btRigidBody* rb = _actor[i].actor;
-
-			_dynamics_world->removeRigidBody(rb);
-			CE_DELETE(*_allocator, rb->getMotionState());
-			CE_DELETE(*_allocator, rb->getCollisionShape());
-			CE_DELETE(*_allocator, rb);
-		}
+			actor_delete(_actor[i]);
 
 		for (u32 i = 0; i < array::size(_collider); ++i)
-		{
-			CE_DELETE(*_allocator, _collider[i].vertex_array);
-			CE_DELETE(*_allocator, _collider[i].shape);
-		}
+			shape_release(_collider[i].shape_data);
+
+		CE_ASSERT(hash_map::size(_shape_map) == 0, "Leaking shapes");
 
 		CE_DELETE(*_allocator, _dynamics_world);
 	}
 
-	ColliderInstance collider_create(UnitId id, const ColliderDesc* sd, const Vector3& scale)
+	static u64 shape_key(StringId64 resource, u32 index, const Vector3& scale)
 	{
-		btTriangleIndexVertexArray* vertex_array = NULL;
-		btCollisionShape* child_shape = NULL;
+		const u64 seed = murmur64(&index, sizeof(index), resource._id);
+		return murmur64(&scale, sizeof(scale), seed);
+	}
+
+	ShapeData* shape_create(StringId64 resource, u32 index, const ColliderDesc* sd, const Vector3& scale)
+	{
+		ShapeData* shape    = CE_NEW(*_allocator, ShapeData)();
+		shape->key          = shape_key(resource, index, scale);
+		shape->resource     = resource;
+		shape->child        = NULL;
+		shape->vertex_array = NULL;
+		shape->bvh          = NULL;
+		shape->shape        = NULL;
+		shape->references   = 0;
 
 		switch(sd->type)
 		{
 		case ColliderType::SPHERE:
-			child_shape = CE_NEW(*_allocator, btSphereShape)(sd->sphere.radius);
+			shape->shape = CE_NEW(*_allocator, btSphereShape)(sd->sphere.radius);
 			break;
 
 		case ColliderType::CAPSULE:
-			child_shape = CE_NEW(*_allocator, btCapsuleShape)(sd->capsule.radius, sd->capsule.height);
+			shape->shape = CE_NEW(*_allocator, btCapsuleShape)(sd->capsule.radius, sd->capsule.height);
 			break;
 
 		case ColliderType::BOX:
-			child_shape = CE_NEW(*_allocator, btBoxShape)(to_btVector3(sd->box.half_size));
+			shape->shape = CE_NEW(*_allocator, btBoxShape)(to_btVector3(sd->box.half_size));
 			break;
 
 		case ColliderType::CONVEX_HULL:
@@ -310,17 +750,28 @@ struct PhysicsWorldImpl
 				const u32 num          = *(u32*)data;
 				const btScalar* points = (btScalar*)(data + sizeof(u32));
 
-				child_shape = CE_NEW(*_allocator, btConvexHullShape)(points, (int)num, sizeof(Vector3));
+				shape->shape = CE_NEW(*_allocator, btConvexHullShape)(points, (int)num, sizeof(Vector3));
 			}
 			break;
 
 		case ColliderType::MESH:
 			{
+				// Scaling a btBvhTriangleMeshShape rebuilds its BVH: wrap the
+				// unscaled shape instead.
+				if (!(scale == VECTOR3_ONE))
+				{
+					shape->child = shape_acquire(resource, index, sd, VECTOR3_ONE);
+					shape->shape = CE_NEW(*_allocator, btScaledBvhTriangleMeshShape)((btBvhTriangleMeshShape*)shape->child->shape, to_btVector3(scale));
+					return shape;
+				}
+
 				const char* data      = (char*)&sd[1];
 				const u32 num_points  = *(u32*)data;
 				const char* points    = data + sizeof(u32);
 				const u32 num_indices = *(u32*)(points + num_points*sizeof(Vector3));
 				const char* indices   = points + sizeof(u32) + num_points*sizeof(Vector3);
+				const u32 bvh_size    = *(u32*)(indices + num_indices*sizeof(u16));
+				const char* bvh       = indices + sizeof(u32) + num_indices*sizeof(u16);
 
 				btIndexedMesh part;
 				part.m_vertexBase          = (const unsigned char*)points;
@@ -331,35 +782,164 @@ struct PhysicsWorldImpl
 				part.m_numTriangles        = num_indices/3;
 				part.m_indexType           = PHY_SHORT;
 
-				vertex_array = CE_NEW(*_allocator, btTriangleIndexVertexArray)();
-				vertex_array->addIndexedMesh(part, PHY_SHORT);
+				shape->vertex_array = CE_NEW(*_allocator, btTriangleIndexVertexArray)();
+				shape->vertex_array->addIndexedMesh(part, PHY_SHORT);
+
+				if (bvh_size == 0)
+				{
+					shape->shape = CE_NEW(*_allocator, btBvhTriangleMeshShape)(shape->vertex_array, true);
+					break;
+				}
 
-				const btVector3 aabb_min(-1000.0f,-1000.0f,-1000.0f);
-				const btVector3 aabb_max(1000.0f,1000.0f,1000.0f);
-				child_shape = CE_NEW(*_allocator, btBvhTriangleMeshShape)(vertex_array, false, aabb_min, aabb_max);
+				// Rebuild the BVH cooked by the data compiler from an aligned
+				// copy of its nodes.
+				MeshBvh* mb = (MeshBvh*)_allocator->allocate(bvh_size, alignof(MeshBvh));
+				memcpy(mb, bvh, bvh_size);
+				btQuantizedBvhNodeData* nodes = (btQuantizedBvhNodeData*)&mb[1];
+				btBvhSubtreeInfoData* subtrees = (btBvhSubtreeInfoData*)&nodes[mb->num_nodes];
+				CE_ENSURE((char*)&subtrees[mb->num_subtrees] == (char*)mb + bvh_size);
+
+				btQuantizedBvhFloatData bvh_data;
+				to_btVector3(mb->aabb_min).serializeFloat(bvh_data.m_bvhAabbMin);
+				to_btVector3(mb->aabb_max).serializeFloat(bvh_data.m_bvhAabbMax);
+				to_btVector3(mb->quantization).serializeFloat(bvh_data.m_bvhQuantization);
+				bvh_data.m_curNodeIndex                = (int)mb->cur_node_index;
+				bvh_data.m_useQuantization             = 1;
+				bvh_data.m_numContiguousLeafNodes      = 0;
+				bvh_data.m_numQuantizedContiguousNodes = (int)mb->num_nodes;
+				bvh_data.m_contiguousNodesPtr          = NULL;
+				bvh_data.m_quantizedContiguousNodesPtr = nodes;
+				bvh_data.m_subTreeInfoPtr              = subtrees;
+				bvh_data.m_traversalMode               = (int)mb->traversal_mode;
+				bvh_data.m_numSubtreeHeaders           = (int)mb->num_subtrees;
+
+				shape->bvh = CE_NEW(*_allocator, btOptimizedBvh)();
+				shape->bvh->deSerializeFloat(bvh_data);
+				_allocator->deallocate(mb);
+
+				btBvhTriangleMeshShape* mesh = CE_NEW(*_allocator, btBvhTriangleMeshShape)(shape->vertex_array, true, false);
+				mesh->setOptimizedBvh(shape->bvh);
+				shape->shape = mesh;
 			}
 			break;
 
 		case ColliderType::HEIGHTFIELD:
-			CE_FATAL("Not implemented");
-			break;
+			{
+				const HeightfieldShape& hf = sd->heightfield;
+				btHeightfieldTerrainShape* terrain = CE_NEW(*_allocator, btHeightfieldTerrainShape)(hf.width
+					, hf.length
+					, &sd[1]
+					, hf.height_scale
+					, -32768.0f*hf.height_scale
+					, 32767.0f*hf.height_scale
+					, 1
+					, PHY_SHORT
+					, false
+					);
+				terrain->buildAccelerator();
+				terrain->setLocalScaling(btVector3(scale.x*hf.cell_size.x, scale.y, scale.z*hf.cell_size.y));
+				shape->shape = terrain;
+			}
+			return shape;
 
 		default:
 			CE_FATAL("Unknown shape type");
 			break;
 		}
 
-		child_shape->setLocalScaling(to_btVector3(scale));
+		shape->shape->setLocalScaling(to_btVector3(scale));
+		return shape;
+	}
+
+	void shape_destroy(ShapeData* shape)
+	{
+		CE_DELETE(*_allocator, shape->shape);
+		CE_DELETE(*_allocator, shape->vertex_array);
+		CE_DELETE(*_allocator, shape->bvh);
+
+		// Scaled meshes hold a reference to the unscaled shape.
+		if (shape->child != NULL)
+			shape_release(shape->child);
+
+		CE_DELETE(*_allocator, shape);
+	}
+
+	/// Returns the shape for the @a index-th collider @a sd of the unit or
+	/// level @a resource with the given @a scale, creating it the first time
+	/// it is requested.
+	ShapeData* shape_acquire(StringId64 resource, u32 index, const ColliderDesc* sd, const Vector3& scale)
+	{
+		const u64 key = shape_key(resource, index, scale);
+
+		ShapeData* shape = hash_map::get(_shape_map, key, (ShapeData*)NULL);
+		if (shape == NULL)
+		{
+			shape = shape_create(resource, index, sd, scale);
+			hash_map::set(_shape_map, key, shape);
+		}
+
+		++shape->references;
+		return shape;
+	}
+
+	void shape_release(ShapeData* shape)
+	{
+		CE_ASSERT(shape->references > 0, "Shape not acquired");
+
+		if (--shape->references > 0)
+			return;
+
+		// The shape is not in the map anymore if its resource went offline.
+		if (hash_map::get(_shape_map, shape->key, (ShapeData*)NULL) == shape)
+			hash_map::remove(_shape_map, shape->key);
+
+		shape_destroy(shape);
+	}
+
+	/// Stops sharing the shapes of the colliders of the unit or level
+	/// @a resource with colliders created from now on. Existing colliders
+	/// keep their shapes until they are destroyed.
+	void shapes_offline(StringId64 resource)
+	{
+		TempAllocator512 ta;
+		Array<u64> keys(ta);
+
+		auto cur = hash_map::begin(_shape_map);
+		auto end = hash_map::end(_shape_map);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(_shape_map, cur);
+
+			if (cur->second->resource == resource)
+				array::push_back(keys, cur->first);
+		}
+
+		for (u32 i = 0; i < array::size(keys); ++i)
+			hash_map::remove(_shape_map, keys[i]);
+	}
+
+	ColliderInstance collider_create(UnitId id, const ColliderDesc* sd, const Vector3& scale, StringId64 resource, u32 index)
+	{
+		ShapeData* shape = shape_acquire(resource, index, sd, scale);
 
 		const u32 last = array::size(_collider);
 
 		ColliderInstanceData cid;
 		cid.unit         = id;
 		cid.local_tm     = sd->local_tm;
-		cid.vertex_array = vertex_array;
-		cid.shape        = child_shape;
+		cid.shape_data   = shape;
+		cid.shape        = shape->shape;
 		cid.next.i       = UINT32_MAX;
 
+		if (sd->type == ColliderType::HEIGHTFIELD)
+		{
+			// Bullet centers heightfields vertically between their
+			// lowest and highest heights.
+			const HeightfieldShape& hf = sd->heightfield;
+			const f32 offset = (hf.height_min + hf.height_max) * 0.5f * scale.y;
+			set_translation(cid.local_tm, translation(sd->local_tm) + y(sd->local_tm)*offset);
+		}
+
 		ColliderInstance ci = collider_first(id);
 		while (is_valid(ci) && is_valid(collider_next(ci)))
 			ci = collider_next(ci);
@@ -385,8 +965,7 @@ struct PhysicsWorldImpl
 		collider_swap_node(last_i, i);
 		collider_remove_node(first_i, i);
 
-		CE_DELETE(*_allocator, _collider[i.i].vertex_array);
-		CE_DELETE(*_allocator, _collider[i.i].shape);
+		shape_release(_collider[i.i].shape_data);
 
 		_collider[i.i] = _collider[last];
 
@@ -482,11 +1061,45 @@ struct PhysicsWorldImpl
 			ci = collider_next(ci);
 		}
 
-		// Create motion state
 		const btTransform tr = to_btTransform(tm);
-		btDefaultMotionState* ms = is_static
+		const u32 last = array::size(_actor);
+
+		// Set collision filters
+		const u32 me   = physics_config_resource::filter(_config_resource, ar->collision_filter)->me;
+		const u32 mask = physics_config_resource::filter(_config_resource, ar->collision_filter)->mask;
+
+		ActorInstanceData aid;
+		aid.unit    = id;
+		aid.actor   = NULL;
+		aid.trigger = NULL;
+		aid.flags   = ar->flags;
+		aid.max_linear_velocity = 0.0f;
+		aid.transform.i = UINT32_MAX;
+
+		if (is_trigger)
+		{
+			// Triggers are never simulated: they can only be moved
+			// explicitly or through the SceneGraph.
+			btPairCachingGhostObject* trigger = CE_NEW(*_allocator, btPairCachingGhostObject)();
+			trigger->setWorldTransform(tr);
+			trigger->setCollisionShape(shape);
+			trigger->setCollisionFlags(btCollisionObject::CF_NO_CONTACT_RESPONSE
+				| (is_static ? btCollisionObject::CF_STATIC_OBJECT : btCollisionObject::CF_KINEMATIC_OBJECT)
+				);
+			trigger->setUserPointer((void*)(uintptr_t)last);
+
+			_dynamics_world->addCollisionObject(trigger, me, mask);
+
+			aid.trigger = trigger;
+			array::push_back(_actor, aid);
+			hash_map::set(_actor_map, id, last);
+			return make_actor_instance(last);
+		}
+
+		// Create motion state
+		MyMotionState* ms = is_static
 			? NULL
-			: CE_NEW(*_allocator, btDefaultMotionState)(tr)
+			: CE_NEW(*_allocator, MyMotionState)(tr, _moved)
 			;
 
 		// If dynamic, calculate inertia
@@ -506,11 +1119,12 @@ struct PhysicsWorldImpl
 
 		// Create rigid body
 		btRigidBody* actor = CE_NEW(*_allocator, btRigidBody)(rbinfo);
+		if (ms)
+			ms->_body = actor;
 
 		int cflags = actor->getCollisionFlags();
 		cflags |= is_kinematic ? btCollisionObject::CF_KINEMATIC_OBJECT    : 0;
 		cflags |= is_static    ? btCollisionObject::CF_STATIC_OBJECT       : 0;
-		cflags |= is_trigger   ? btCollisionObject::CF_NO_CONTACT_RESPONSE : 0;
 		actor->setCollisionFlags(cflags);
 		if (is_kinematic)
 			actor->setActivationState(DISABLE_DEACTIVATION);
@@ -526,19 +1140,20 @@ struct PhysicsWorldImpl
 			(ar->flags & ActorFlags::LOCK_ROTATION_Z) ? 0.0f : 1.0f)
 		);
 
-		const u32 last = array::size(_actor);
 		actor->setUserPointer((void*)(uintptr_t)last);
 
-		// Set collision filters
-		const u32 me   = physics_config_resource::filter(_config_resource, ar->collision_filter)->me;
-		const u32 mask = physics_config_resource::filter(_config_resource, ar->collision_filter)->mask;
-
 		_dynamics_world->addRigidBody(actor, me, mask);
 
-		ActorInstanceData aid;
-		aid.unit  = id;
 		aid.actor = actor;
 
+		// Only simulated bodies can exceed their velocity limit.
+		if (actor_class->max_linear_velocity > 0.0f && !is_static)
+		{
+			aid.max_linear_velocity = actor_class->max_linear_velocity;
+			if (!is_kinematic)
+				array::push_back(_speed_limited, actor);
+		}
+
 		array::push_back(_actor, aid);
 		hash_map::set(_actor_map, id, last);
 
@@ -551,13 +1166,11 @@ struct PhysicsWorldImpl
 		const UnitId u      = _actor[i.i].unit;
 		const UnitId last_u = _actor[last].unit;
 
-		_dynamics_world->removeRigidBody(_actor[i.i].actor);
-		CE_DELETE(*_allocator, _actor[i.i].actor->getMotionState());
-		CE_DELETE(*_allocator, _actor[i.i].actor->getCollisionShape());
-		CE_DELETE(*_allocator, _actor[i.i].actor);
+		actor_delete(_actor[i.i]);
 
 		_actor[i.i] = _actor[last];
-		_actor[i.i].actor->setUserPointer((void*)(uintptr_t)i.i);
+		if (i.i != last)
+			object(i)->setUserPointer((void*)(uintptr_t)i.i);
 
 		array::pop_back(_actor);
 
@@ -565,6 +1178,64 @@ struct PhysicsWorldImpl
 		hash_map::remove(_actor_map, u);
 	}
 
+	void actor_delete(const ActorInstanceData& aid)
+	{
+		if (aid.trigger != NULL)
+		{
+			_dynamics_world->removeCollisionObject(aid.trigger);
+			CE_DELETE(*_allocator, aid.trigger->getCollisionShape());
+			CE_DELETE(*_allocator, aid.trigger);
+			return;
+		}
+
+		if (aid.max_linear_velocity > 0.0f)
+			speed_limited_remove(aid.actor);
+
+		_dynamics_world->removeRigidBody(aid.actor);
+		CE_DELETE(*_allocator, aid.actor->getMotionState());
+		CE_DELETE(*_allocator, aid.actor->getCollisionShape());
+		CE_DELETE(*_allocator, aid.actor);
+	}
+
+	/// Stops limiting the velocity of @a actor, if it was.
+	void speed_limited_remove(btRigidBody* actor)
+	{
+		const u32 num = array::size(_speed_limited);
+		for (u32 i = 0; i < num; ++i)
+		{
+			if (_speed_limited[i] == actor)
+			{
+				_speed_limited[i] = _speed_limited[num - 1];
+				array::pop_back(_speed_limited);
+				break;
+			}
+		}
+	}
+
+	/// Returns the collision object of the actor @a i.
+	btCollisionObject* object(ActorInstance i) const
+	{
+		return _actor[i.i].actor != NULL
+			? (btCollisionObject*)_actor[i.i].actor
+			: (btCollisionObject*)_actor[i.i].trigger
+			;
+	}
+
+	/// Returns whether @a obj is the rigid body or the trigger of an actor of
+	/// this world. Broadphase proxies are shared by all worlds.
+	bool owns(const btCollisionObject* obj) const
+	{
+		const u32 ai = (u32)(uintptr_t)obj->getUserPointer();
+		return ai < array::size(_actor) && object(make_actor_instance(ai)) == obj;
+	}
+
+	/// Returns the rigid body of the actor @a i.
+	btRigidBody* body(ActorInstance i) const
+	{
+		CE_ASSERT(_actor[i.i].actor != NULL, "Actor is a trigger");
+		return _actor[i.i].actor;
+	}
+
 	ActorInstance actor(UnitId id)
 	{
 		return make_actor_instance(hash_map::get(_actor_map, id, UINT32_MAX));
@@ -572,31 +1243,47 @@ struct PhysicsWorldImpl
 
 	Vector3 actor_world_position(ActorInstance i) const
 	{
-		return to_vector3(_actor[i.i].actor->getCenterOfMassPosition());
+		return to_vector3(object(i)->getWorldTransform().getOrigin());
 	}
 
 	Quaternion actor_world_rotation(ActorInstance i) const
 	{
-		return to_quaternion(_actor[i.i].actor->getOrientation());
+		return to_quaternion(object(i)->getWorldTransform().getRotation());
 	}
 
 	Matrix4x4 actor_world_pose(ActorInstance i) const
 	{
-		return to_matrix4x4(_actor[i.i].actor->getCenterOfMassTransform());
+		return to_matrix4x4(object(i)->getWorldTransform());
+	}
+
+	void actor_set_world_transform(ActorInstance i, const btTransform& pose)
+	{
+		if (_actor[i.i].actor != NULL)
+		{
+			_actor[i.i].actor->setCenterOfMassTransform(pose);
+
+			MyMotionState* ms = (MyMotionState*)_actor[i.i].actor->getMotionState();
+			if (ms)
+				ms->reset(pose);
+		}
+		else
+		{
+			_actor[i.i].trigger->setWorldTransform(pose);
+		}
 	}
 
 	void actor_teleport_world_position(ActorInstance i, const Vector3& p)
 	{
-		btTransform pose = _actor[i.i].actor->getCenterOfMassTransform();
+		btTransform pose = object(i)->getWorldTransform();
 		pose.setOrigin(to_btVector3(p));
-		_actor[i.i].actor->setCenterOfMassTransform(pose);
+		actor_set_world_transform(i, pose);
 	}
 
 	void actor_teleport_world_rotation(ActorInstance i, const Quaternion& r)
 	{
-		btTransform pose = _actor[i.i].actor->getCenterOfMassTransform();
+		btTransform pose = object(i)->getWorldTransform();
 		pose.setRotation(to_btQuaternion(r));
-		_actor[i.i].actor->setCenterOfMassTransform(pose);
+		actor_set_world_transform(i, pose);
 	}
 
 	void actor_teleport_world_pose(ActorInstance i, const Matrix4x4& m)
@@ -604,29 +1291,29 @@ struct PhysicsWorldImpl
 		const Quaternion rot = rotation(m);
 		const Vector3 pos = translation(m);
 
-		btTransform pose = _actor[i.i].actor->getCenterOfMassTransform();
+		btTransform pose = object(i)->getWorldTransform();
 		pose.setRotation(to_btQuaternion(rot));
 		pose.setOrigin(to_btVector3(pos));
-		_actor[i.i].actor->setCenterOfMassTransform(pose);
+		actor_set_world_transform(i, pose);
 	}
 
 	Vector3 actor_center_of_mass(ActorInstance i) const
 	{
-		return to_vector3(_actor[i.i].actor->getCenterOfMassTransform().getOrigin());
+		return to_vector3(object(i)->getWorldTransform().getOrigin());
 	}
 
 	void actor_enable_gravity(ActorInstance i)
 	{
-		btRigidBody* body = _actor[i.i].actor;
-		body->setFlags(body->getFlags() & ~BT_DISABLE_WORLD_GRAVITY);
-		body->setGravity(_dynamics_world->getGravity());
+		btRigidBody* rb = body(i);
+		rb->setFlags(rb->getFlags() & ~BT_DISABLE_WORLD_GRAVITY);
+		rb->setGravity(_dynamics_world->getGravity());
 	}
 
 	void actor_disable_gravity(ActorInstance i)
 	{
-		btRigidBody* body = _actor[i.i].actor;
-		body->setFlags(body->getFlags() | BT_DISABLE_WORLD_GRAVITY);
-		body->setGravity(btVector3(0.0f, 0.0f, 0.0f));
+		btRigidBody* rb = body(i);
+		rb->setFlags(rb->getFlags() | BT_DISABLE_WORLD_GRAVITY);
+		rb->setGravity(btVector3(0.0f, 0.0f, 0.0f));
 	}
 
 	void actor_enable_collision(ActorInstance /*i*/)
@@ -646,29 +1333,40 @@ struct PhysicsWorldImpl
 
 	void actor_set_kinematic(ActorInstance i, bool kinematic)
 	{
-		btRigidBody* body = _actor[i.i].actor;
-		int flags = body->getCollisionFlags();
+		btCollisionObject* obj = object(i);
+		int flags = obj->getCollisionFlags();
+		const bool was_dynamic = actor_is_dynamic(i);
 
 		if (kinematic)
 		{
-			body->setCollisionFlags(flags | btCollisionObject::CF_KINEMATIC_OBJECT);
-			body->setActivationState(DISABLE_DEACTIVATION);
+			obj->setCollisionFlags(flags | btCollisionObject::CF_KINEMATIC_OBJECT);
+			obj->setActivationState(DISABLE_DEACTIVATION);
 		}
 		else
 		{
-			body->setCollisionFlags(flags & ~btCollisionObject::CF_KINEMATIC_OBJECT);
-			body->setActivationState(ACTIVE_TAG);
+			obj->setCollisionFlags(flags & ~btCollisionObject::CF_KINEMATIC_OBJECT);
+			obj->setActivationState(ACTIVE_TAG);
 		}
-	}
 
-	bool actor_is_static(ActorInstance i) const
-	{
-		return _actor[i.i].actor->getCollisionFlags() & btCollisionObject::CF_STATIC_OBJECT;
+		// Only dynamic actors have their velocity limited.
+		const ActorInstanceData& aid = _actor[i.i];
+		if (aid.max_linear_velocity > 0.0f && was_dynamic != actor_is_dynamic(i))
+		{
+			if (was_dynamic)
+				speed_limited_remove(aid.actor);
+			else
+				array::push_back(_speed_limited, aid.actor);
+		}
+	}
+
+	bool actor_is_static(ActorInstance i) const
+	{
+		return object(i)->getCollisionFlags() & btCollisionObject::CF_STATIC_OBJECT;
 	}
 
 	bool actor_is_dynamic(ActorInstance i) const
 	{
-		const int flags = _actor[i.i].actor->getCollisionFlags();
+		const int flags = object(i)->getCollisionFlags();
 		return !(flags & btCollisionObject::CF_STATIC_OBJECT)
 			&& !(flags & btCollisionObject::CF_KINEMATIC_OBJECT)
 			;
@@ -676,7 +1374,7 @@ struct PhysicsWorldImpl
 
 	bool actor_is_kinematic(ActorInstance i) const
 	{
-		const int flags = _actor[i.i].actor->getCollisionFlags();
+		const int flags = object(i)->getCollisionFlags();
 		return (flags & btCollisionObject::CF_KINEMATIC_OBJECT) != 0;
 	}
 
@@ -687,93 +1385,93 @@ struct PhysicsWorldImpl
 
 	f32 actor_linear_damping(ActorInstance i) const
 	{
-		return _actor[i.i].actor->getLinearDamping();
+		return body(i)->getLinearDamping();
 	}
 
 	void actor_set_linear_damping(ActorInstance i, f32 rate)
 	{
-		_actor[i.i].actor->setDamping(rate, _actor[i.i].actor->getAngularDamping());
+		body(i)->setDamping(rate, body(i)->getAngularDamping());
 	}
 
 	f32 actor_angular_damping(ActorInstance i) const
 	{
-		return _actor[i.i].actor->getAngularDamping();
+		return body(i)->getAngularDamping();
 	}
 
 	void actor_set_angular_damping(ActorInstance i, f32 rate)
 	{
-		_actor[i.i].actor->setDamping(_actor[i.i].actor->getLinearDamping(), rate);
+		body(i)->setDamping(body(i)->getLinearDamping(), rate);
 	}
 
 	Vector3 actor_linear_velocity(ActorInstance i) const
 	{
-		btVector3 v = _actor[i.i].actor->getLinearVelocity();
+		btVector3 v = body(i)->getLinearVelocity();
 		return to_vector3(v);
 	}
 
 	void actor_set_linear_velocity(ActorInstance i, const Vector3& vel)
 	{
-		_actor[i.i].actor->activate();
-		_actor[i.i].actor->setLinearVelocity(to_btVector3(vel));
+		body(i)->activate();
+		body(i)->setLinearVelocity(to_btVector3(vel));
 	}
 
 	Vector3 actor_angular_velocity(ActorInstance i) const
 	{
-		btVector3 v = _actor[i.i].actor->getAngularVelocity();
+		btVector3 v = body(i)->getAngularVelocity();
 		return to_vector3(v);
 	}
 
 	void actor_set_angular_velocity(ActorInstance i, const Vector3& vel)
 	{
-		_actor[i.i].actor->activate();
-		_actor[i.i].actor->setAngularVelocity(to_btVector3(vel));
+		body(i)->activate();
+		body(i)->setAngularVelocity(to_btVector3(vel));
 	}
 
 	void actor_add_impulse(ActorInstance i, const Vector3& impulse)
 	{
-		_actor[i.i].actor->activate();
-		_actor[i.i].actor->applyCentralImpulse(to_btVector3(impulse));
+		body(i)->activate();
+		body(i)->applyCentralImpulse(to_btVector3(impulse));
 	}
 
 	void actor_add_impulse_at(ActorInstance i, const Vector3& impulse, const Vector3& pos)
 	{
-		_actor[i.i].actor->activate();
-		_actor[i.i].actor->applyImpulse(to_btVector3(impulse), to_btVector3(pos));
+		body(i)->activate();
+		body(i)->applyImpulse(to_btVector3(impulse), to_btVector3(pos));
 	}
 
 	void actor_add_torque_impulse(ActorInstance i, const Vector3& imp)
 	{
-		_actor[i.i].actor->applyTorqueImpulse(to_btVector3(imp));
+		body(i)->applyTorqueImpulse(to_btVector3(imp));
 	}
 
 	void actor_push(ActorInstance i, const Vector3& vel, f32 mass)
 	{
 		const Vector3 f = vel * mass;
-		_actor[i.i].actor->applyCentralForce(to_btVector3(f));
+		body(i)->applyCentralForce(to_btVector3(f));
 	}
 
 	void actor_push_at(ActorInstance i, const Vector3& vel, f32 mass, const Vector3& pos)
 	{
 		const Vector3 f = vel * mass;
-		_actor[i.i].actor->applyForce(to_btVector3(f), to_btVector3(pos));
+		body(i)->applyForce(to_btVector3(f), to_btVector3(pos));
 	}
 
 	bool actor_is_sleeping(ActorInstance i)
 	{
-		return !_actor[i.i].actor->isActive();
+		return !object(i)->isActive();
 	}
 
 	void actor_wake_up(ActorInstance i)
 	{
-		_actor[i.i].actor->activate(true);
+		object(i)->activate(true);
 	}
 
 	JointInstance joint_create(ActorInstance a0, ActorInstance a1, const JointDesc& jd)
 	{
 		const btVector3 anchor_0 = to_btVector3(jd.anchor_0);
 		const btVector3 anchor_1 = to_btVector3(jd.anchor_1);
-		btRigidBody* actor_0 = _actor[a0.i].actor;
-		btRigidBody* actor_1 = is_valid(a1) ? _actor[a1.i].actor : NULL;
+		btRigidBody* actor_0 = body(a0);
+		btRigidBody* actor_1 = is_valid(a1) ? body(a1) : NULL;
 
 		btTypedConstraint* joint = NULL;
 		switch(jd.type)
@@ -852,7 +1550,7 @@ struct PhysicsWorldImpl
 
 		if (cb.hasHit())
 		{
-			const u32 actor = (u32)(uintptr_t)btRigidBody::upcast(cb.m_collisionObject)->getUserPointer();
+			const u32 actor = (u32)(uintptr_t)cb.m_collisionObject->getUserPointer();
 
 			hit.position = to_vector3(cb.m_hitPointWorld);
 			hit.normal   = to_vector3(cb.m_hitNormalWorld);
@@ -884,7 +1582,7 @@ struct PhysicsWorldImpl
 
 			for (int i = 0; i < num; ++i)
 			{
-				const u32 actor = (u32)(uintptr_t)btRigidBody::upcast(cb.m_collisionObjects[i])->getUserPointer();
+				const u32 actor = (u32)(uintptr_t)cb.m_collisionObjects[i]->getUserPointer();
 
 				hits[i].position = to_vector3(cb.m_hitPointWorld[i]);
 				hits[i].normal   = to_vector3(cb.m_hitNormalWorld[i]);
@@ -912,7 +1610,7 @@ struct PhysicsWorldImpl
 
 		if (cb.hasHit())
 		{
-			const u32 actor = (u32)(uintptr_t)btRigidBody::upcast(cb.m_hitCollisionObject)->getUserPointer();
+			const u32 actor = (u32)(uintptr_t)cb.m_hitCollisionObject->getUserPointer();
 
 			hit.position = to_vector3(cb.m_hitPointWorld);
 			hit.normal   = to_vector3(cb.m_hitNormalWorld);
@@ -937,6 +1635,248 @@ struct PhysicsWorldImpl
 		return cast(hit, &shape, from, dir, len);
 	}
 
+	static void set_no_hit(RaycastHit& hit)
+	{
+		hit.time    = -1.0f;
+		hit.unit    = UNIT_INVALID;
+		hit.actor.i = UINT32_MAX;
+	}
+
+	bool cast_query(RaycastHit& hit, const RaycastQuery& q)
+	{
+		if (cast_ray(hit, q.from, q.dir, q.len))
+			return true;
+
+		set_no_hit(hit);
+		return false;
+	}
+
+	bool cast_query(RaycastHit& hit, const SweepQuery& q)
+	{
+		bool hit_any = false;
+
+		switch (q.type)
+		{
+		case ColliderType::SPHERE:
+			hit_any = cast_sphere(hit, q.from, q.half_extents.x, q.dir, q.len);
+			break;
+
+		case ColliderType::BOX:
+			hit_any = cast_box(hit, q.from, q.half_extents, q.dir, q.len);
+			break;
+
+		default:
+			CE_FATAL("Unsupported sweep shape");
+			break;
+		}
+
+		if (!hit_any)
+			set_no_hit(hit);
+		return hit_any;
+	}
+
+	/// Runs a range of the queries of a batch. Queries only read the world,
+	/// so they can run on Bullet's worker threads between steps.
+	template <typename T>
+	struct CastBatch : public btIParallelForBody
+	{
+		PhysicsWorldImpl* _world;
+		RaycastHit* _hits;
+		const T* _queries;
+
+		void forLoop(int begin, int end) const
+		{
+			for (int i = begin; i < end; ++i)
+				_world->cast_query(_hits[i], _queries[i]);
+		}
+	};
+
+	template <typename T>
+	u32 cast_batch(RaycastHit* hits, const T* queries, u32 num)
+	{
+		CastBatch<T> body;
+		body._world   = this;
+		body._hits    = hits;
+		body._queries = queries;
+
+		if (physics_globals::_bt_task_scheduler == NULL)
+			body.forLoop(0, (int)num);
+		else
+			btParallelFor(0, (int)num, CROWN_PHYSICS_QUERY_GRAIN_SIZE, body);
+
+		u32 num_hits = 0;
+		for (u32 i = 0; i < num; ++i)
+			num_hits += u32(hits[i].time >= 0.0f);
+		return num_hits;
+	}
+
+	u32 cast_ray_batch(RaycastHit* hits, const RaycastQuery* queries, u32 num)
+	{
+		return cast_batch(hits, queries, num);
+	}
+
+	u32 sweep_batch(RaycastHit* hits, const SweepQuery* queries, u32 num)
+	{
+		return cast_batch(hits, queries, num);
+	}
+
+	/// Collects the actors of this world whose broadphase proxy overlaps the
+	/// volume. Proxies are shared by all worlds.
+	struct OverlapCollector : public btDbvt::ICollide
+	{
+		PhysicsWorldImpl* _world;
+		btCollisionObject* _query; ///< NULL to only test the bounds.
+		OverlapHit* _hits;
+		u32 _max;
+		u32 _num;
+		btAlignedObjectArray<const btDbvtNode*>* _stack;
+
+		void Process(const btDbvtNode* leaf)
+		{
+			btCollisionObject* obj = (btCollisionObject*)((btBroadphaseProxy*)leaf->data)->m_clientObject;
+			if (!_world->owns(obj))
+				return;
+
+			const u32 ai = (u32)(uintptr_t)obj->getUserPointer();
+
+			if (_query != NULL && !_world->overlaps(_query, obj))
+				return;
+
+			_hits[_num].unit = _world->_actor[ai].unit;
+			_hits[_num].actor = make_actor_instance(ai);
+			++_num;
+
+			// Empty the stack to stop the traversal once full.
+			if (_num == _max)
+				_stack->resize(0);
+		}
+	};
+
+	struct OverlapResultCallback : public btCollisionWorld::ContactResultCallback
+	{
+		bool _overlaps;
+
+		OverlapResultCallback()
+			: _overlaps(false)
+		{
+		}
+
+		bool needsCollision(btBroadphaseProxy* /*proxy*/) const
+		{
+			return true;
+		}
+
+		btScalar addSingleResult(btManifoldPoint& cp
+			, const btCollisionObjectWrapper* /*obj0*/
+			, int /*part0*/
+			, int /*index0*/
+			, const btCollisionObjectWrapper* /*obj1*/
+			, int /*part1*/
+			, int /*index1*/
+			)
+		{
+			_overlaps = _overlaps || cp.getDistance() <= 0.0f;
+			return 0.0f;
+		}
+	};
+
+	/// Returns whether the shapes of @a a and @a b overlap.
+	bool overlaps(btCollisionObject* a, btCollisionObject* b)
+	{
+		OverlapResultCallback cb;
+		_dynamics_world->contactPairTest(a, b, cb);
+		return cb._overlaps;
+	}
+
+	u32 overlap(OverlapHit* hits, u32 max, const btVector3& aabb_min, const btVector3& aabb_max, btCollisionObject* query)
+	{
+		if (max == 0)
+			return 0;
+
+		OverlapCollector collector;
+		collector._world = this;
+		collector._query = query;
+		collector._hits  = hits;
+		collector._max   = max;
+		collector._num   = 0;
+		collector._stack = &_overlap_stack;
+
+		btDbvtBroadphase* bp = (btDbvtBroadphase*)physics_globals::_bt_interface;
+		const btDbvtVolume bounds = btDbvtVolume::FromMM(aabb_min, aabb_max);
+		bp->m_sets[0].collideTVNoStackAlloc(bp->m_sets[0].m_root, bounds, _overlap_stack, collector);
+		if (collector._num < max)
+			bp->m_sets[1].collideTVNoStackAlloc(bp->m_sets[1].m_root, bounds, _overlap_stack, collector);
+
+		return collector._num;
+	}
+
+	u32 overlap_sphere(OverlapHit* hits, u32 max, const Vector3& center, f32 radius, bool exact)
+	{
+		const btVector3 c = to_btVector3(center);
+		const btVector3 r(radius, radius, radius);
+
+		if (!exact)
+			return overlap(hits, max, c - r, c + r, NULL);
+
+		btSphereShape shape(radius);
+		btCollisionObject query;
+		query.setCollisionShape(&shape);
+		query.setWorldTransform(btTransform(btQuaternion::getIdentity(), c));
+		return overlap(hits, max, c - r, c + r, &query);
+	}
+
+	u32 overlap_box(OverlapHit* hits, u32 max, const Vector3& center, const Quaternion& rotation, const Vector3& half_extents, bool exact)
+	{
+		btBoxShape shape(to_btVector3(half_extents));
+		const btTransform tr(to_btQuaternion(rotation), to_btVector3(center));
+
+		btVector3 aabb_min;
+		btVector3 aabb_max;
+		shape.getAabb(tr, aabb_min, aabb_max);
+
+		if (!exact)
+			return overlap(hits, max, aabb_min, aabb_max, NULL);
+
+		btCollisionObject query;
+		query.setCollisionShape(&shape);
+		query.setWorldTransform(tr);
+		return overlap(hits, max, aabb_min, aabb_max, &query);
+	}
+
+	u32 overlap_aabb(OverlapHit* hits, u32 max, const AABB& aabb)
+	{
+		return overlap(hits, max, to_btVector3(aabb.min), to_btVector3(aabb.max), NULL);
+	}
+
+	u32 overlap_batch(OverlapHit* hits, u32 max, u32* num_hits, const OverlapQuery* queries, u32 num)
+	{
+		u32 total = 0;
+
+		for (u32 i = 0; i < num; ++i)
+		{
+			const OverlapQuery& q = queries[i];
+
+			switch (q.type)
+			{
+			case ColliderType::SPHERE:
+				num_hits[i] = overlap_sphere(hits + total, max - total, q.center, q.half_extents.x, q.exact);
+				break;
+
+			case ColliderType::BOX:
+				num_hits[i] = overlap_box(hits + total, max - total, q.center, q.rotation, q.half_extents, q.exact);
+				break;
+
+			default:
+				CE_FATAL("Unsupported overlap shape");
+				break;
+			}
+
+			total += num_hits[i];
+		}
+
+		return total;
+	}
+
 	Vector3 gravity() const
 	{
 		return to_vector3(_dynamics_world->getGravity());
@@ -957,46 +1897,303 @@ struct PhysicsWorldImpl
 
 			const Quaternion rot = rotation(*begin_world);
 			const Vector3 pos = translation(*begin_world);
+			const btTransform tr(to_btQuaternion(rot), to_btVector3(pos));
+
+			if (_actor[ai].trigger != NULL)
+			{
+				_actor[ai].trigger->setWorldTransform(tr);
+				continue;
+			}
+
 			// http://www.bulletphysics.org/mediawiki-1.5.8/index.php/MotionStates
-			btMotionState* ms = _actor[ai].actor->getMotionState();
+			// Write the transform directly to avoid publishing it back to
+			// the SceneGraph.
+			MyMotionState* ms = (MyMotionState*)_actor[ai].actor->getMotionState();
 			if (ms)
-				ms->setWorldTransform(btTransform(to_btQuaternion(rot), to_btVector3(pos)));
+				ms->reset(tr);
 		}
 	}
 
+	void publish_pose(btRigidBody* body, f32 alpha)
+	{
+		MyMotionState* ms = (MyMotionState*)body->getMotionState();
+		ms->_published = _step;
+
+		btTransform tm = ms->_tm;
+		if (alpha < 1.0f)
+		{
+			tm.setOrigin(ms->_prev_tm.getOrigin().lerp(ms->_tm.getOrigin(), alpha));
+			tm.setRotation(slerp(ms->_prev_tm.getRotation(), ms->_tm.getRotation(), alpha));
+		}
+
+		// Instances move when other units are destroyed: look the transform
+		// up again only if the cached one does not belong to the unit anymore.
+		ActorInstanceData& aid = _actor[(u32)(uintptr_t)body->getUserPointer()];
+		const SceneGraph::InstanceData& sgd = _scene_graph->_data;
+		if (aid.transform.i >= sgd.size || sgd.unit[aid.transform.i] != aid.unit)
+		{
+			aid.transform = _scene_graph->instances(aid.unit);
+			if (!is_valid(aid.transform))
+				return;
+		}
+
+		array::push_back(_pose_instances, aid.transform);
+		array::push_back(_poses, to_matrix4x4(tm));
+	}
+
 	void update(f32 dt)
 	{
-		// 12Hz to 120Hz
-		_dynamics_world->stepSimulation(dt, 7, 1.0f/60.0f);
+		const f32 step_time = _config_resource->step_time;
+		const u32 max_substeps = _config_resource->max_substeps;
+
+		// Drop the time the simulation can not catch up with.
+		_accumulator += dt;
+		if (_accumulator > _config_resource->max_lag)
+		{
+			_dropped_time += _accumulator - _config_resource->max_lag;
+			_accumulator = _config_resource->max_lag;
+		}
+
+		// Take fixed steps; the time left for the next update is carried over.
+		_num_substeps = 0;
+		while (_accumulator >= step_time && _num_substeps < max_substeps)
+		{
+			_dynamics_world->stepSimulation(step_time, 0, step_time);
+			_accumulator -= step_time;
+			++_num_substeps;
+		}
 
-		const int num = _dynamics_world->getNumCollisionObjects();
-		const btCollisionObjectArray& collision_array = _dynamics_world->getCollisionObjectArray();
-	    // Update actors
-		for (int i = 0; i < num; ++i)
+		const f32 alpha = (_config_resource->flags & PhysicsConfigResource::INTERPOLATE)
+			? min(_accumulator / step_time, 1.0f)
+			: 1.0f
+			;
+
+		// Bullet only synchronizes the motion states of active bodies, so
+		// sleeping and static bodies never end up in the moved list.
+		for (u32 i = 0; i < array::size(_moved); ++i)
 		{
-			if ((uintptr_t)collision_array[i]->getUserPointer() == (uintptr_t)UINT32_MAX)
+			btRigidBody* body = _moved[i];
+			MyMotionState* ms = (MyMotionState*)body->getMotionState();
+			ms->_is_moved = false;
+			publish_pose(body, alpha);
+		}
+
+		// Bodies published mid-interpolation in the previous update that did
+		// not move since must still reach their last pose.
+		const u32 num_interpolating = array::size(_interpolating);
+		for (u32 i = 0; i < num_interpolating; ++i)
+		{
+			const u32 ai = hash_map::get(_actor_map, _interpolating[i], UINT32_MAX);
+			if (ai == UINT32_MAX || _actor[ai].actor == NULL)
 				continue;
 
-			btRigidBody* body = btRigidBody::upcast(collision_array[i]);
-			if (body
-				&& body->getMotionState()
-				&& body->isActive()
-				)
+			btRigidBody* body = _actor[ai].actor;
+			MyMotionState* ms = (MyMotionState*)body->getMotionState();
+			if (ms == NULL || ms->_published == _step)
+				continue;
+
+			if (_num_substeps > 0)
+			{
+				ms->_prev_tm = ms->_tm;
+				publish_pose(body, 1.0f);
+			}
+			else
+			{
+				publish_pose(body, alpha);
+				array::push_back(_interpolating, _interpolating[i]);
+			}
+		}
+
+		// Remember which bodies still have to reach their last pose.
+		for (u32 i = num_interpolating; i < array::size(_interpolating); ++i)
+			_interpolating[i - num_interpolating] = _interpolating[i];
+		array::resize(_interpolating, array::size(_interpolating) - num_interpolating);
+
+		if (alpha < 1.0f)
+		{
+			for (u32 i = 0; i < array::size(_moved); ++i)
+				array::push_back(_interpolating, _actor[(u32)(uintptr_t)_moved[i]->getUserPointer()].unit);
+		}
+
+		array::clear(_moved);
+
+		_scene_graph->set_world_poses_and_rescale(array::begin(_pose_instances)
+			, array::begin(_poses)
+			, array::size(_pose_instances)
+			);
+		array::clear(_pose_instances);
+		array::clear(_poses);
+
+		// Contacts and overlaps only change when the simulation steps.
+		if (_num_substeps > 0)
+		{
+			post_contact_events();
+			post_trigger_events();
+		}
+		++_step;
+	}
+
+	u32 num_substeps() const
+	{
+		return _num_substeps;
+	}
+
+	f32 dropped_time() const
+	{
+		return _dropped_time;
+	}
+
+	/// Runs the narrowphase between each trigger and the actors overlapping
+	/// its bounds and posts enter/leave events for the overlaps that changed.
+	void post_trigger_events()
+	{
+		btCollisionDispatcher* dispatcher = (btCollisionDispatcher*)_dynamics_world->getDispatcher();
+		const btDispatcherInfo& info = _dynamics_world->getDispatchInfo();
+
+		for (u32 i = 0; i < array::size(_actor); ++i)
+		{
+			btPairCachingGhostObject* trigger = _actor[i].trigger;
+			if (trigger == NULL)
+				continue;
+
+			btBroadphasePairArray& pairs = trigger->getOverlappingPairCache()->getOverlappingPairArray();
+			for (int j = 0; j < pairs.size(); ++j)
 			{
-				const UnitId unit_id = _actor[(u32)(uintptr_t)body->getUserPointer()].unit;
+				btBroadphasePair& pair = pairs[j];
+				const btCollisionObject* obj_a = (btCollisionObject*)pair.m_pProxy0->m_clientObject;
+				const btCollisionObject* obj_b = (btCollisionObject*)pair.m_pProxy1->m_clientObject;
+				const btCollisionObject* other = obj_a == trigger ? obj_b : obj_a;
 
-				btTransform tr;
-				body->getMotionState()->getWorldTransform(tr);
+				if (other->getInternalType() == btCollisionObject::CO_GHOST_OBJECT || !owns(other))
+					continue;
 
-				// Post transform event
+				btCollisionDispatcher::defaultNearCallback(pair, *dispatcher, info);
+				if (pair.m_algorithm == NULL)
+					continue;
+
+				_manifolds.resize(0);
+				pair.m_algorithm->getAllContactManifolds(_manifolds);
+
+				bool overlapping = false;
+				for (int k = 0; k < _manifolds.size() && !overlapping; ++k)
 				{
-					PhysicsTransformEvent ev;
-					ev.unit_id = unit_id;
-					ev.world = to_matrix4x4(tr);
-					event_stream::write(_events, EventType::PHYSICS_TRANSFORM, ev);
+					for (int h = 0; h < _manifolds[k]->getNumContacts() && !overlapping; ++h)
+						overlapping = _manifolds[k]->getContactPoint(h).getDistance() < 0.0f;
 				}
+
+				if (!overlapping)
+					continue;
+
+				const UnitId u0 = _actor[i].unit;
+				const UnitId u1 = _actor[(u32)(uintptr_t)other->getUserPointer()].unit;
+				const u64 key = (u64(u0._idx) << 32) | u1._idx;
+
+				if (!hash_map::has(_overlaps, key))
+				{
+					OverlapData od;
+					od.trigger = u0;
+					od.other   = u1;
+					od.is_new  = true;
+					hash_map::set(_overlaps, key, od);
+				}
+
+				OverlapData deffault;
+				hash_map::get(_overlaps, key, deffault).step = _step;
+			}
+		}
+
+		auto cur = hash_map::begin(_overlaps);
+		auto end = hash_map::end(_overlaps);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(_overlaps, cur);
+
+			const OverlapData& od = cur->second;
+
+			PhysicsTriggerEvent ev;
+			ev.trigger_unit = od.trigger;
+			ev.other_unit   = od.other;
+			ev.trigger      = actor(od.trigger);
+			ev.other        = actor(od.other);
+
+			if (od.step != _step)
+			{
+				// Actors that have been destroyed leave the trigger too.
+				array::push_back(_ended_contacts, cur->first);
+				ev.type = PhysicsTriggerEvent::TRIGGER_LEAVE;
+			}
+			else if (od.is_new)
+			{
+				OverlapData deffault;
+				hash_map::get(_overlaps, cur->first, deffault).is_new = false;
+				ev.type = PhysicsTriggerEvent::TRIGGER_ENTER;
+			}
+			else
+			{
+				continue;
+			}
+
+			event_stream::write(_events, EventType::PHYSICS_TRIGGER, ev);
+		}
+
+		for (u32 i = 0; i < array::size(_ended_contacts); ++i)
+			hash_map::remove(_overlaps, _ended_contacts[i]);
+
+		array::clear(_ended_contacts);
+	}
+
+	/// Posts touch begin/end events for the contacts that changed state
+	/// during the last update and touching events for those that asked for it.
+	void post_contact_events()
+	{
+		auto cur = hash_map::begin(_contacts);
+		auto end = hash_map::end(_contacts);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(_contacts, cur);
+
+			const ContactData& cd = cur->second;
+
+			PhysicsCollisionEvent ev;
+			ev.units[0] = cd.units[0];
+			ev.units[1] = cd.units[1];
+			ev.actors[0] = cd.actors[0];
+			ev.actors[1] = cd.actors[1];
+			ev.position = cd.position;
+			ev.normal = cd.normal;
+			ev.distance = cd.distance;
+
+			if (cd.step != _step)
+			{
+				array::push_back(_ended_contacts, cur->first);
+
+				// Actors that have been destroyed stop touching too.
+				ev.actors[0] = actor(cd.units[0]);
+				ev.actors[1] = actor(cd.units[1]);
+				ev.type = PhysicsCollisionEvent::TOUCH_END;
+			}
+			else if (cd.is_new)
+			{
+				ContactData deffault;
+				hash_map::get(_contacts, cur->first, deffault).is_new = false;
+				ev.type = PhysicsCollisionEvent::TOUCH_BEGIN;
 			}
+			else if (cd.report_contacts)
+			{
+				ev.type = PhysicsCollisionEvent::TOUCHING;
+			}
+			else
+			{
+				continue;
+			}
+
+			event_stream::write(_events, EventType::PHYSICS_COLLISION, ev);
 		}
+
+		for (u32 i = 0; i < array::size(_ended_contacts); ++i)
+			hash_map::remove(_contacts, _ended_contacts[i]);
+
+		array::clear(_ended_contacts);
 	}
 
 	EventStream& events()
@@ -1021,49 +2218,90 @@ struct PhysicsWorldImpl
 
 	void tick_callback(btDynamicsWorld* world, btScalar /*dt*/)
 	{
-		// Limit bodies velocity
-		for (u32 i = 0; i < array::size(_actor); ++i)
+		// Limit the velocity of the active bodies that have a limit
+		for (u32 i = 0; i < array::size(_speed_limited); ++i)
 		{
-			CE_ENSURE(NULL != _actor[i].actor);
-			const btVector3 velocity = _actor[i].actor->getLinearVelocity();
-			const btScalar speed = velocity.length();
+			btRigidBody* body = _speed_limited[i];
+			if (!body->isActive())
+				continue;
+
+			const f32 max_speed = _actor[(u32)(uintptr_t)body->getUserPointer()].max_linear_velocity;
+			const btVector3 velocity = body->getLinearVelocity();
+			const btScalar speed2 = velocity.length2();
 
-			if (speed > 100.0f)
-				_actor[i].actor->setLinearVelocity(velocity * 100.0f / speed);
+			if (speed2 > max_speed*max_speed)
+				body->setLinearVelocity(velocity * max_speed / btSqrt(speed2));
 		}
 
-		// Check collisions
-		int num_manifolds = world->getDispatcher()->getNumManifolds();
+		// Track contacts between actors that report collisions. A contact
+		// counts as touching if it touched in any of the substeps.
+		const int num_manifolds = world->getDispatcher()->getNumManifolds();
 		for (int i = 0; i < num_manifolds; ++i)
 		{
 			const btPersistentManifold* manifold = world->getDispatcher()->getManifoldByIndexInternal(i);
+			const btCollisionObject* obj0 = manifold->getBody0();
+			const btCollisionObject* obj1 = manifold->getBody1();
+
+			// Triggers' manifolds are left in the dispatcher by
+			// post_trigger_events(): overlaps are reported as trigger events.
+			if (obj0->getInternalType() == btCollisionObject::CO_GHOST_OBJECT
+				|| obj1->getInternalType() == btCollisionObject::CO_GHOST_OBJECT
+				|| !owns(obj0)
+				|| !owns(obj1)
+				)
+				continue;
 
-			const btCollisionObject* obj_a = manifold->getBody0();
-			const btCollisionObject* obj_b = manifold->getBody1();
-			const ActorInstance a0 = make_actor_instance((u32)(uintptr_t)obj_a->getUserPointer());
-			const ActorInstance a1 = make_actor_instance((u32)(uintptr_t)obj_b->getUserPointer());
-			const UnitId u0 = _actor[a0.i].unit;
-			const UnitId u1 = _actor[a1.i].unit;
+			const u32 a0 = (u32)(uintptr_t)obj0->getUserPointer();
+			const u32 a1 = (u32)(uintptr_t)obj1->getUserPointer();
+			const u32 flags = _actor[a0].flags | _actor[a1].flags;
+			if (!(flags & ActorFlags::REPORT_COLLISIONS))
+				continue;
 
-			int num_contacts = manifold->getNumContacts();
-			for (int j = 0; j < num_contacts; ++j)
+			// Reduce the manifold to its deepest contact point
+			int deepest = -1;
+			for (int j = 0; j < manifold->getNumContacts(); ++j)
 			{
 				const btManifoldPoint& pt = manifold->getContactPoint(j);
-				if (pt.m_distance1 < 0.0f)
-				{
-					// Post collision event
-					PhysicsCollisionEvent ev;
-					ev.type = pt.m_lifeTime == 1 ? PhysicsCollisionEvent::TOUCH_BEGIN : PhysicsCollisionEvent::TOUCHING;
-					ev.units[0] = u0;
-					ev.units[1] = u1;
-					ev.actors[0] = a0;
-					ev.actors[1] = a1;
-					ev.position = to_vector3(pt.m_positionWorldOnB);
-					ev.normal = to_vector3(pt.m_normalWorldOnB);
-					ev.distance = pt.m_distance1;
-					event_stream::write(_events, EventType::PHYSICS_COLLISION, ev);
-				}
+				if (pt.m_distance1 < 0.0f && (deepest == -1 || pt.m_distance1 < manifold->getContactPoint(deepest).m_distance1))
+					deepest = j;
 			}
+
+			if (deepest == -1)
+				continue;
+
+			const UnitId u0 = _actor[a0].unit;
+			const UnitId u1 = _actor[a1].unit;
+			const u64 key = u0._idx < u1._idx
+				? (u64(u0._idx) << 32) | u1._idx
+				: (u64(u1._idx) << 32) | u0._idx
+				;
+
+			if (!hash_map::has(_contacts, key))
+			{
+				ContactData cd;
+				cd.units[0] = u0;
+				cd.units[1] = u1;
+				cd.step     = UINT32_MAX;
+				cd.is_new   = true;
+				hash_map::set(_contacts, key, cd);
+			}
+
+			ContactData deffault;
+			ContactData& cd = hash_map::get(_contacts, key, deffault);
+			const btManifoldPoint& pt = manifold->getContactPoint(deepest);
+
+			if (cd.step != _step || pt.m_distance1 < cd.distance)
+			{
+				const bool swap = cd.units[0] != u0;
+				cd.actors[0] = make_actor_instance(swap ? a1 : a0);
+				cd.actors[1] = make_actor_instance(swap ? a0 : a1);
+				cd.position  = to_vector3(swap ? pt.m_positionWorldOnA : pt.m_positionWorldOnB);
+				cd.normal    = to_vector3(swap ? -pt.m_normalWorldOnB : pt.m_normalWorldOnB);
+				cd.distance  = pt.m_distance1;
+			}
+
+			cd.step = _step;
+			cd.report_contacts = (flags & ActorFlags::REPORT_CONTACTS) != 0;
 		}
 	}
 
@@ -1104,12 +2342,28 @@ struct PhysicsWorldImpl
 	static JointInstance make_joint_instance(u32 i) { JointInstance inst = { i }; return inst; }
 };
 
-PhysicsWorld::PhysicsWorld(Allocator& a, ResourceManager& rm, UnitManager& um, DebugLine& dl)
+namespace physics_globals
+{
+	void resource_offline(StringId64 type, StringId64 name)
+	{
+		const ResourceId id = resource_id(type, name);
+
+		ListNode* cur;
+		list_for_each(cur, &_worlds)
+		{
+			PhysicsWorldImpl::WorldNode* wn = (PhysicsWorldImpl::WorldNode*)container_of(cur, PhysicsWorldImpl::WorldNode, node);
+			wn->world->shapes_offline(id);
+		}
+	}
+
+} // namespace physics_globals
+
+PhysicsWorld::PhysicsWorld(Allocator& a, ResourceManager& rm, UnitManager& um, SceneGraph& sg, DebugLine& dl)
 	: _marker(PHYSICS_WORLD_MARKER)
 	, _allocator(&a)
 	, _impl(NULL)
 {
-	_impl = CE_NEW(*_allocator, PhysicsWorldImpl)(a, rm, um, dl);
+	_impl = CE_NEW(*_allocator, PhysicsWorldImpl)(a, rm, um, sg, dl);
 }
 
 PhysicsWorld::~PhysicsWorld()
@@ -1118,9 +2372,9 @@ PhysicsWorld::~PhysicsWorld()
 	_marker = 0;
 }
 
-ColliderInstance PhysicsWorld::collider_create(UnitId id, const ColliderDesc* sd, const Vector3& scl)
+ColliderInstance PhysicsWorld::collider_create(UnitId id, const ColliderDesc* sd, const Vector3& scl, StringId64 resource, u32 index)
 {
-	return _impl->collider_create(id, sd, scl);
+	return _impl->collider_create(id, sd, scl, resource, index);
 }
 
 void PhysicsWorld::collider_destroy(ColliderInstance i)
@@ -1343,6 +2597,36 @@ bool PhysicsWorld::cast_box(RaycastHit& hit, const Vector3& from, const Vector3&
 	return _impl->cast_box(hit, from, half_extents, dir, len);
 }
 
+u32 PhysicsWorld::cast_ray_batch(RaycastHit* hits, const RaycastQuery* queries, u32 num)
+{
+	return _impl->cast_ray_batch(hits, queries, num);
+}
+
+u32 PhysicsWorld::sweep_batch(RaycastHit* hits, const SweepQuery* queries, u32 num)
+{
+	return _impl->sweep_batch(hits, queries, num);
+}
+
+u32 PhysicsWorld::overlap_sphere(OverlapHit* hits, u32 max, const Vector3& center, f32 radius, bool exact)
+{
+	return _impl->overlap_sphere(hits, max, center, radius, exact);
+}
+
+u32 PhysicsWorld::overlap_box(OverlapHit* hits, u32 max, const Vector3& center, const Quaternion& rotation, const Vector3& half_extents, bool exact)
+{
+	return _impl->overlap_box(hits, max, center, rotation, half_extents, exact);
+}
+
+u32 PhysicsWorld::overlap_aabb(OverlapHit* hits, u32 max, const AABB& aabb)
+{
+	return _impl->overlap_aabb(hits, max, aabb);
+}
+
+u32 PhysicsWorld::overlap_batch(OverlapHit* hits, u32 max, u32* num_hits, const OverlapQuery* queries, u32 num)
+{
+	return _impl->overlap_batch(hits, max, num_hits, queries, num);
+}
+
 Vector3 PhysicsWorld::gravity() const
 {
 	return _impl->gravity();
@@ -1363,6 +2647,16 @@ void PhysicsWorld::update(f32 dt)
 	_impl->update(dt);
 }
 
+u32 PhysicsWorld::num_substeps() const
+{
+	return _impl->num_substeps();
+}
+
+f32 PhysicsWorld::dropped_time() const
+{
+	return _impl->dropped_time();
+}
+
 EventStream& PhysicsWorld::events()
 {
 	return _impl->events();
@@ -16,7 +16,7 @@ namespace crown
 {
 namespace physics_globals
 {
-	void init(Allocator& /*a*/)
+	void init(Allocator& /*a*/, u32 /*num_threads*/)
 	{
 	}
 
@@ -24,6 +24,19 @@ namespace physics_globals
 	{
 	}
 
+	u32 num_threads()
+	{
+		return 1;
+	}
+
+	void set_num_threads(u32 /*num*/)
+	{
+	}
+
+	void resource_offline(StringId64 /*type*/, StringId64 /*name*/)
+	{
+	}
+
 } // namespace physics_globals
 
 struct PhysicsWorldImpl
@@ -39,7 +52,7 @@ struct PhysicsWorldImpl
 	{
 	}
 
-	ColliderInstance collider_create(UnitId /*id*/, const ColliderDesc* /*sd*/, const Vector3& /*scl*/)
+	ColliderInstance collider_create(UnitId /*id*/, const ColliderDesc* /*sd*/, const Vector3& /*scl*/, StringId64 /*resource*/, u32 /*index*/)
 	{
 		return make_collider_instance(UINT32_MAX);
 	}
@@ -242,6 +255,46 @@ struct PhysicsWorldImpl
 		return false;
 	}
 
+	u32 cast_ray_batch(RaycastHit* hits, const RaycastQuery* /*queries*/, u32 num)
+	{
+		for (u32 i = 0; i < num; ++i)
+		{
+			hits[i].time    = -1.0f;
+			hits[i].unit    = UNIT_INVALID;
+			hits[i].actor.i = UINT32_MAX;
+		}
+
+		return 0;
+	}
+
+	u32 sweep_batch(RaycastHit* hits, const SweepQuery* /*queries*/, u32 num)
+	{
+		return cast_ray_batch(hits, NULL, num);
+	}
+
+	u32 overlap_sphere(OverlapHit* /*hits*/, u32 /*max*/, const Vector3& /*center*/, f32 /*radius*/, bool /*exact*/)
+	{
+		return 0;
+	}
+
+	u32 overlap_box(OverlapHit* /*hits*/, u32 /*max*/, const Vector3& /*center*/, const Quaternion& /*rotation*/, const Vector3& /*half_extents*/, bool /*exact*/)
+	{
+		return 0;
+	}
+
+	u32 overlap_aabb(OverlapHit* /*hits*/, u32 /*max*/, const AABB& /*aabb*/)
+	{
+		return 0;
+	}
+
+	u32 overlap_batch(OverlapHit* /*hits*/, u32 /*max*/, u32* num_hits, const OverlapQuery* /*queries*/, u32 num)
+	{
+		for (u32 i = 0; i < num; ++i)
+			num_hits[i] = 0;
+
+		return 0;
+	}
+
 	Vector3 gravity() const
 	{
 		return VECTOR3_ZERO;
@@ -259,6 +312,16 @@ struct PhysicsWorldImpl
 	{
 	}
 
+	u32 num_substeps() const
+	{
+		return 0;
+	}
+
+	f32 dropped_time() const
+	{
+		return 0.0f;
+	}
+
 	EventStream& events()
 	{
 		return _events;
@@ -277,7 +340,7 @@ struct PhysicsWorldImpl
 	JointInstance make_joint_instance(u32 i) { JointInstance inst = { i }; return inst; }
 };
 
-PhysicsWorld::PhysicsWorld(Allocator& a, ResourceManager& /*rm*/, UnitManager& /*um*/, DebugLine& /*dl*/)
+PhysicsWorld::PhysicsWorld(Allocator& a, ResourceManager& /*rm*/, UnitManager& /*um*/, SceneGraph& /*sg*/, DebugLine& /*dl*/)
 	: _marker(PHYSICS_WORLD_MARKER)
 	, _allocator(&a)
 	, _impl(NULL)
@@ -291,9 +354,9 @@ PhysicsWorld::~PhysicsWorld()
 	_marker = 0;
 }
 
-ColliderInstance PhysicsWorld::collider_create(UnitId id, const ColliderDesc* sd, const Vector3& scl)
+ColliderInstance PhysicsWorld::collider_create(UnitId id, const ColliderDesc* sd, const Vector3& scl, StringId64 resource, u32 index)
 {
-	return _impl->collider_create(id, sd, scl);
+	return _impl->collider_create(id, sd, scl, resource, index);
 }
 
 void PhysicsWorld::collider_destroy(ColliderInstance i)
@@ -516,6 +579,36 @@ bool PhysicsWorld::cast_box(RaycastHit& hit, const Vector3& from, const Vector3&
 	return _impl->cast_box(hit, from, half_extents, dir, len);
 }
 
+u32 PhysicsWorld::cast_ray_batch(RaycastHit* hits, const RaycastQuery* queries, u32 num)
+{
+	return _impl->cast_ray_batch(hits, queries, num);
+}
+
+u32 PhysicsWorld::sweep_batch(RaycastHit* hits, const SweepQuery* queries, u32 num)
+{
+	return _impl->sweep_batch(hits, queries, num);
+}
+
+u32 PhysicsWorld::overlap_sphere(OverlapHit* hits, u32 max, const Vector3& center, f32 radius, bool exact)
+{
+	return _impl->overlap_sphere(hits, max, center, radius, exact);
+}
+
+u32 PhysicsWorld::overlap_box(OverlapHit* hits, u32 max, const Vector3& center, const Quaternion& rotation, const Vector3& half_extents, bool exact)
+{
+	return _impl->overlap_box(hits, max, center, rotation, half_extents, exact);
+}
+
+u32 PhysicsWorld::overlap_aabb(OverlapHit* hits, u32 max, const AABB& aabb)
+{
+	return _impl->overlap_aabb(hits, max, aabb);
+}
+
+u32 PhysicsWorld::overlap_batch(OverlapHit* hits, u32 max, u32* num_hits, const OverlapQuery* queries, u32 num)
+{
+	return _impl->overlap_batch(hits, max, num_hits, queries, num);
+}
+
 Vector3 PhysicsWorld::gravity() const
 {
 	return _impl->gravity();
@@ -536,6 +629,16 @@ void PhysicsWorld::update(f32 dt)
 	_impl->update(dt);
 }
 
+u32 PhysicsWorld::num_substeps() const
+{
+	return _impl->num_substeps();
+}
+
+f32 PhysicsWorld::dropped_time() const
+{
+	return _impl->dropped_time();
+}
+
 EventStream& PhysicsWorld::events()
 {
 	return _impl->events();
@@ -277,6 +277,23 @@ void SceneGraph::set_world_pose_and_rescale(TransformInstance i, const Matrix4x4
 	_data.changed[i.i] = true;
 }
 
+void SceneGraph::set_world_poses_and_rescale(const TransformInstance* ti, const Matrix4x4* poses, u32 num)
+{
+	for (u32 n = 0; n < num; ++n)
+	{
+		const u32 i = ti[n].i;
+		CE_ASSERT(i < _data.size, "Index out of bounds");
+
+		const Vector3 scale = _data.local[i].scale;
+		Matrix4x4& world = _data.world[i];
+		world = poses[n];
+		world.x.x *= scale.x; world.x.y *= scale.x; world.x.z *= scale.x;
+		world.y.x *= scale.y; world.y.y *= scale.y; world.y.z *= scale.y;
+		world.z.x *= scale.z; world.z.y *= scale.z; world.z.z *= scale.z;
+		_data.changed[i] = true;
+	}
+}
+
 u32 SceneGraph::num_nodes() const
 {
 	return _data.size;
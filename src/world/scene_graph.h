@@ -125,6 +125,11 @@ struct SceneGraph
 	///
 	void set_world_pose_and_rescale(TransformInstance i, const Matrix4x4& pose);
 
+	/// Sets the world pose of the @a num instances @a ti to the corresponding
+	/// @a poses, which must not be scaled, and applies the local scale of
+	/// each instance.
+	void set_world_poses_and_rescale(const TransformInstance* ti, const Matrix4x4* poses, u32 num);
+
 	/// Returns the number of nodes in the graph.
 	u32 num_nodes() const;
 
@@ -5,6 +5,7 @@
 
 #include "core/containers/array.inl"
 #include "core/containers/hash_map.inl"
+#include "core/math/constants.h"
 #include "core/strings/string_id.inl"
 #include "device/device.h"
 #include "lua/lua_environment.h"
@@ -33,13 +34,94 @@ namespace script_world_internal
 	{
 		unit_destroyed_callback(*((ScriptWorld*)user_ptr), unit, make_instance(UINT32_MAX));
 	}
+
+	static const char* callback_names[] =
+	{
+		"collision_begin", // ScriptWorld::Callback::COLLISION_BEGIN
+		"collision",       // ScriptWorld::Callback::COLLISION
+		"collision_end",   // ScriptWorld::Callback::COLLISION_END
+		"trigger_enter",   // ScriptWorld::Callback::TRIGGER_ENTER
+		"trigger_leave"    // ScriptWorld::Callback::TRIGGER_LEAVE
+	};
+	CE_STATIC_ASSERT(countof(callback_names) == ScriptWorld::Callback::COUNT);
+
+	/// Queues the event @a ed for the script of @a unit, if it implements
+	/// the callback @a cb.
+	static void queue_event(ScriptWorld& sw, UnitId unit, ScriptWorld::Callback::Enum cb, ScriptWorld::EventData& ed)
+	{
+		const u32 instance_i = hash_map::get(sw._map, unit, UINT32_MAX);
+		if (instance_i == UINT32_MAX)
+			return;
+
+		const u32 script_i = sw._data[instance_i].script_i;
+		ScriptWorld::ScriptData& sd = sw._script[script_i];
+		if (!(sd.callbacks & (1u << cb)))
+			return;
+
+		const u32 event_i = array::size(sw._events);
+		ed.next = UINT32_MAX;
+		array::push_back(sw._events, ed);
+
+		if (sd.last[cb] == UINT32_MAX)
+			sd.first[cb] = event_i;
+		else
+			sw._events[sd.last[cb]].next = event_i;
+		sd.last[cb] = event_i;
+
+		if (!sd.queued)
+		{
+			sd.queued = true;
+			array::push_back(sw._queued, script_i);
+		}
+	}
+
+	/// Pushes a table with the events of the callback @a cb starting at
+	/// @a first, flattened to a fixed number of values per event.
+	static void push_events(LuaStack& stack, ScriptWorld& sw, ScriptWorld::Callback::Enum cb, u32 first)
+	{
+		lua_State* L = stack.L;
+		const bool is_contact = cb == ScriptWorld::Callback::COLLISION_BEGIN || cb == ScriptWorld::Callback::COLLISION;
+		const bool is_collision = is_contact || cb == ScriptWorld::Callback::COLLISION_END;
+
+		lua_newtable(L);
+		int n = 0;
+		for (u32 i = first; i != UINT32_MAX; i = sw._events[i].next)
+		{
+			const ScriptWorld::EventData& ed = sw._events[i];
+
+			stack.push_unit(ed.units[0]);
+			lua_rawseti(L, -2, ++n);
+			stack.push_unit(ed.units[1]);
+			lua_rawseti(L, -2, ++n);
+
+			if (is_collision)
+			{
+				stack.push_actor(ed.actor);
+				lua_rawseti(L, -2, ++n);
+			}
+
+			if (is_contact)
+			{
+				const f32 values[] =
+				{
+					ed.position.x, ed.position.y, ed.position.z,
+					ed.normal.x, ed.normal.y, ed.normal.z,
+					ed.distance
+				};
+				for (u32 v = 0; v < countof(values); ++v)
+				{
+					stack.push_float(values[v]);
+					lua_rawseti(L, -2, ++n);
+				}
+			}
+		}
+	}
 } // script_world_internal
 
 namespace script_world
 {
 	ScriptInstance create(ScriptWorld& sw, UnitId unit, const ScriptDesc& desc)
 	{
-
 		CE_ASSERT(!hash_map::has(sw._map, unit), "Unit already has script component");
 
 		u32 script_i = hash_map::get(sw._cache
@@ -63,6 +145,24 @@ namespace script_world
 			const LuaResource* lr = (LuaResource*)sw._resource_manager->get(RESOURCE_TYPE_SCRIPT, desc.script_resource);
 
 			LuaStack stack = sw._lua_environment->execute(lr, 1);
+
+			// Only scripts implementing a callback receive its events.
+			sd.callbacks = 0;
+			for (u32 cb = 0; cb < ScriptWorld::Callback::COUNT; ++cb)
+			{
+				if (lua_istable(stack.L, -1))
+				{
+					lua_getfield(stack.L, -1, script_world_internal::callback_names[cb]);
+					if (!lua_isnil(stack.L, -1))
+						sd.callbacks |= 1u << cb;
+					stack.pop(1);
+				}
+
+				sd.first[cb] = UINT32_MAX;
+				sd.last[cb] = UINT32_MAX;
+			}
+			sd.queued = false;
+
 			stack.push_value(0);
 			sd.module_ref = luaL_ref(stack.L, LUA_REGISTRYINDEX);
 			stack.pop(1);
@@ -155,64 +255,86 @@ namespace script_world
 
 	void collision(ScriptWorld& sw, const PhysicsCollisionEvent& ev)
 	{
-		for (u32 i = 0; i < array::size(sw._data); ++i)
+		ScriptWorld::Callback::Enum cb = ScriptWorld::Callback::COUNT;
+		switch (ev.type)
 		{
-			if (sw._data[i].unit == ev.units[0] || sw._data[i].unit == ev.units[1])
-			{
-				int unit_index = sw._data[i].unit == ev.units[0] ? 0 : 1;
+		case PhysicsCollisionEvent::TOUCH_BEGIN: cb = ScriptWorld::Callback::COLLISION_BEGIN; break;
+		case PhysicsCollisionEvent::TOUCHING:    cb = ScriptWorld::Callback::COLLISION; break;
+		case PhysicsCollisionEvent::TOUCH_END:   cb = ScriptWorld::Callback::COLLISION_END; break;
+		default: CE_FATAL("Unknown physics collision event"); break;
+		}
+
+		for (u32 i = 0; i < 2; ++i)
+		{
+			ScriptWorld::EventData ed;
+			ed.units[0] = ev.units[1 - i];
+			ed.units[1] = ev.units[i];
+			ed.actor    = ev.actors[i];
+			ed.position = ev.position;
+			ed.normal   = ev.normal;
+			ed.distance = ev.distance;
+			script_world_internal::queue_event(sw, ev.units[i], cb, ed);
+		}
+	}
 
-				LuaStack stack(sw._lua_environment->L);
-				lua_rawgeti(stack.L, LUA_REGISTRYINDEX, sw._script[sw._data[i].script_i].module_ref);
-				switch (ev.type)
+	void trigger(ScriptWorld& sw, const PhysicsTriggerEvent& ev)
+	{
+		const ScriptWorld::Callback::Enum cb = ev.type == PhysicsTriggerEvent::TRIGGER_ENTER
+			? ScriptWorld::Callback::TRIGGER_ENTER
+			: ScriptWorld::Callback::TRIGGER_LEAVE
+			;
+
+		ScriptWorld::EventData ed;
+		ed.units[0] = ev.trigger_unit;
+		ed.units[1] = ev.other_unit;
+		ed.actor    = ev.trigger;
+		ed.position = VECTOR3_ZERO;
+		ed.normal   = VECTOR3_ZERO;
+		ed.distance = 0.0f;
+		script_world_internal::queue_event(sw, ev.trigger_unit, cb, ed);
+		script_world_internal::queue_event(sw, ev.other_unit, cb, ed);
+	}
+
+	void dispatch_events(ScriptWorld& sw)
+	{
+		LuaStack stack(sw._lua_environment->L);
+
+		// Callbacks may queue new events: only dispatch those queued so far.
+		const u32 num_queued = array::size(sw._queued);
+		for (u32 q = 0; q < num_queued; ++q)
+		{
+			ScriptWorld::ScriptData& sd = sw._script[sw._queued[q]];
+
+			for (u32 cb = 0; cb < ScriptWorld::Callback::COUNT; ++cb)
+			{
+				if (sd.first[cb] == UINT32_MAX)
+					continue;
+
+				lua_rawgeti(stack.L, LUA_REGISTRYINDEX, sd.module_ref);
+				lua_getfield(stack.L, -1, script_world_internal::callback_names[cb]);
+				stack.push_world(sw._world);
+				script_world_internal::push_events(stack, sw, (ScriptWorld::Callback::Enum)cb, sd.first[cb]);
+				int status = sw._lua_environment->call(2, 0);
+				if (status != LUA_OK)
 				{
-				case PhysicsCollisionEvent::TOUCH_BEGIN:
-					lua_getfield(stack.L, -1, "collision_begin");
-					if (!lua_isnil(stack.L, -1))
-					{
-						stack.push_unit (ev.units[1-unit_index]);
-						stack.push_unit (ev.units[unit_index]);
-						stack.push_actor(ev.actors[unit_index]);
-						stack.push_vector3(ev.position);
-						stack.push_vector3(ev.normal);
-						stack.push_float(ev.distance);
-						int status = sw._lua_environment->call(6, 0);
-						if (status != LUA_OK)
-						{
-							report(stack.L, status);
-							device()->pause();
-						}
-						stack.pop(1);
-					}
-					break;
-
-				case PhysicsCollisionEvent::TOUCHING:
-					lua_getfield(stack.L, -1, "collision");
-					if (!lua_isnil(stack.L, -1))
-					{
-						stack.push_unit (ev.units[1-unit_index]);
-						stack.push_unit (ev.units[unit_index]);
-						stack.push_actor(ev.actors[unit_index]);
-						stack.push_vector3(ev.position);
-						stack.push_vector3(ev.normal);
-						stack.push_float(ev.distance);
-						int status = sw._lua_environment->call(6, 0);
-						if (status != LUA_OK)
-						{
-							report(stack.L, status);
-							device()->pause();
-						}
-						stack.pop(1);
-					}
-					break;
-
-				default:
-					CE_FATAL("Unknown physics collision event");
-					break;
+					report(stack.L, status);
+					device()->pause();
 				}
+				stack.pop(1);
+
+				sd.first[cb] = UINT32_MAX;
+				sd.last[cb] = UINT32_MAX;
 			}
+
+			sd.queued = false;
 		}
 
-		// Unit not found
+		for (u32 q = num_queued; q < array::size(sw._queued); ++q)
+			sw._queued[q - num_queued] = sw._queued[q];
+		array::resize(sw._queued, array::size(sw._queued) - num_queued);
+
+		if (array::size(sw._queued) == 0)
+			array::clear(sw._events);
 	}
 
 } // namespace script_world
@@ -223,6 +345,8 @@ ScriptWorld::ScriptWorld(Allocator& a, UnitManager& um, ResourceManager& rm, Lua
 	, _data(a)
 	, _map(a)
 	, _cache(a)
+	, _events(a)
+	, _queued(a)
 	, _unit_manager(&um)
 	, _resource_manager(&rm)
 	, _lua_environment(&le)
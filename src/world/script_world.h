@@ -15,9 +15,39 @@ namespace crown
 /// @ingroup World
 struct ScriptWorld
 {
+	/// Physics callbacks a script can implement.
+	struct Callback
+	{
+		enum Enum
+		{
+			COLLISION_BEGIN,
+			COLLISION,
+			COLLISION_END,
+			TRIGGER_ENTER,
+			TRIGGER_LEAVE,
+
+			COUNT
+		};
+	};
+
 	struct ScriptData
 	{
 		int module_ref;
+		u32 callbacks;                 ///< Bitmask of the implemented Callback::Enum.
+		u32 first[Callback::COUNT];    ///< First queued event for each callback.
+		u32 last[Callback::COUNT];     ///< Last queued event for each callback.
+		bool queued;                   ///< Whether the script is in the queued scripts.
+	};
+
+	/// Physics event queued for a script until script_world::dispatch_events().
+	struct EventData
+	{
+		u32 next;
+		UnitId units[2];     ///< (other, unit) for collisions, (trigger, other) for triggers.
+		ActorInstance actor; ///< The actor of the unit. Collisions only.
+		Vector3 position;
+		Vector3 normal;
+		f32 distance;
 	};
 
 	struct InstanceData
@@ -31,6 +61,8 @@ struct ScriptWorld
 	Array<InstanceData> _data;
 	HashMap<UnitId, u32> _map;
 	HashMap<StringId64, u32> _cache;
+	Array<EventData> _events;
+	Array<u32> _queued;
 
 	UnitManager* _unit_manager;
 	ResourceManager* _resource_manager;
@@ -56,9 +88,16 @@ namespace script_world
 	/// Calls the update function on all scripts.
 	void update(ScriptWorld& sw, f32 dt);
 
-	///
+	/// Queues the collision event @a ev for the scripts of the units involved.
 	void collision(ScriptWorld& sw, const PhysicsCollisionEvent& ev);
 
+	/// Queues the trigger event @a ev for the scripts of the units involved.
+	void trigger(ScriptWorld& sw, const PhysicsTriggerEvent& ev);
+
+	/// Calls each physics callback once per script with all the events
+	/// queued for it since the last call.
+	void dispatch_events(ScriptWorld& sw);
+
 } // namespace script_world
 
 } // namespace crown
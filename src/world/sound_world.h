@@ -32,7 +32,10 @@ struct SoundWorld
 
 	/// Plays the sound @a sr at the given @a volume [0 .. 1].
 	/// If loop is true the sound will be played looping.
-	SoundInstanceId play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos);
+	/// When more than CROWN_SOUND_MAX_VOICES sounds are audible, the ones with the
+	/// lowest @a priority [0 .. 255] and then the quietest are made virtual: they
+	/// keep playing silently and resume where they would be once audible again.
+	SoundInstanceId play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos, u8 priority);
 
 	/// Stops the sound with the given @a id.
 	/// After this call, the instance will be destroyed.
@@ -65,8 +68,8 @@ struct SoundWorld
 	/// Sets the @a pose of the listener in world space.
 	void set_listener_pose(const Matrix4x4& pose);
 
-	///
-	void update();
+	/// Updates the voices and the streaming sounds, advancing time by @a dt seconds.
+	void update(f32 dt);
 };
 
 } // namespace crown
@@ -7,17 +7,31 @@
 
 #if CROWN_SOUND_OPENAL
 
+#include "core/adpcm.h"
 #include "core/containers/array.inl"
+#include "core/containers/queue.inl"
+#include "core/filesystem/file.h"
+#include "core/filesystem/filesystem.h"
+#include "core/list.inl"
 #include "core/math/constants.h"
 #include "core/math/matrix4x4.inl"
 #include "core/math/vector3.inl"
 #include "core/memory/temp_allocator.inl"
+#include "core/strings/dynamic_string.inl"
+#include "core/thread/condition_variable.h"
+#include "core/thread/mutex.h"
+#include "core/thread/scoped_mutex.h"
+#include "core/thread/thread.h"
 #include "device/log.h"
+#include "resource/resource_id.h"
+#include "resource/resource_manager.h"
 #include "resource/sound_resource.h"
 #include "world/audio.h"
 #include "world/sound_world.h"
 #include <AL/al.h>
 #include <AL/alc.h>
+#include <algorithm>
+#include <string.h> // memcpy
 
 LOG_SYSTEM(SOUND, "sound")
 
@@ -50,13 +64,17 @@ namespace crown
 	#define AL_CHECK(function) function
 #endif // CROWN_DEBUG
 
+struct SoundWorldImpl;
+
 /// Global audio-related functions
 namespace audio_globals
 {
 	static ALCdevice* s_al_device;
 	static ALCcontext* s_al_context;
+	static Filesystem* s_data_filesystem;
+	static ListNode s_worlds;
 
-	void init()
+	void init(Filesystem& data_filesystem)
 	{
 		s_al_device = alcOpenDevice(NULL);
 		CE_ASSERT(s_al_device, "alcOpenDevice: error");
@@ -75,6 +93,9 @@ namespace audio_globals
 		AL_CHECK(alDistanceModel(AL_LINEAR_DISTANCE_CLAMPED));
 		AL_CHECK(alDopplerFactor(1.0f));
 		AL_CHECK(alDopplerVelocity(343.0f));
+
+		s_data_filesystem = &data_filesystem;
+		list::init_head(s_worlds);
 	}
 
 	void shutdown()
@@ -85,128 +106,353 @@ namespace audio_globals
 
 } // namespace audio_globals
 
+static ALenum al_format(const SoundResource& sr)
+{
+	switch (sr.bits_ps)
+	{
+	case  8: return sr.channels > 1 ? AL_FORMAT_STEREO8  : AL_FORMAT_MONO8;
+	case 16: return sr.channels > 1 ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
+	default: CE_FATAL("Number of bits per sample not supported."); return AL_INVALID_ENUM;
+	}
+}
+
+/// Chunk of sample data of a streaming sound.
+struct StreamChunk
+{
+	SoundInstanceId id; ///< Instance the chunk has been requested for.
+	StringId64 name;
+	u32 offset;         ///< Offset of the chunk in the resource file.
+	u32 size;
+	u32 num_frames;     ///< Number of frames to decode, 0 if the chunk is not compressed.
+	u32 channels;
+	u32 block_size;
+	u32 seek;           ///< Value of SoundInstance::_seek when requested.
+	void* data;         ///< NULL until the chunk has been read.
+};
+
+/// Sound instance. Only the most important instances are given an OpenAL
+/// source (a voice); the others are virtual: they keep time and state but
+/// cost nothing to the mixer until a voice becomes available again.
 struct SoundInstance
 {
 	const SoundResource* _resource;
 	SoundInstanceId _id;
-	ALuint _buffer;
-	ALuint _source;
+	ALuint _source;        ///< 0 if the instance is virtual.
+	Vector3 _position;
+	f32 _range;
+	f32 _volume;
+	f32 _time;             ///< Seconds played since the start of the sound.
+	f32 _audibility;       ///< Estimated gain at the listener position.
+	u8 _priority;
+	bool _loop;
+	bool _paused;
+	bool _stopped;
+
+	// Streaming sounds only
+	ALuint _buffers[CROWN_SOUND_STREAMING_BUFFERS];
+	ALuint _free[CROWN_SOUND_STREAMING_BUFFERS]; ///< Buffers not queued to the source.
+	u32 _num_free;
+	u32 _num_requested;                          ///< Chunks requested since the last seek and not yet queued.
+	u32 _read_offset;                            ///< Offset of the next chunk to request.
+	u32 _seek;                                   ///< Incremented each time the stream restarts.
+	bool _end_of_stream;                         ///< Whether all the chunks have been requested.
+
+	void create(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos, u8 priority)
+	{
+		_resource      = &sr;
+		_source        = 0;
+		_position      = pos;
+		_range         = range;
+		_volume        = volume;
+		_time          = 0.0f;
+		_audibility    = 0.0f;
+		_priority      = priority;
+		_loop          = loop;
+		_paused        = false;
+		_stopped       = false;
+		_num_free      = 0;
+		_num_requested = 0;
+		_read_offset   = 0;
+		_seek          = 0;
+		_end_of_stream = false;
+	}
 
-	void create(const SoundResource& sr, const Vector3& pos, f32 range)
+	void reload(const SoundResource& new_sr)
 	{
-		using namespace sound_resource;
+		const ALuint source = _source != 0 ? virtualize() : 0;
+		_resource = &new_sr;
+		_time = 0.0f;
+		if (source != 0)
+			realize(source);
+	}
 
-		AL_CHECK(alGenSources(1, &_source));
-		CE_ASSERT(alIsSource(_source), "alGenSources: error");
+	/// Starts playing the instance on @a source from the current time.
+	void realize(ALuint source)
+	{
+		CE_ASSERT(_source == 0, "Instance is not virtual");
+		_source = source;
 
 		AL_CHECK(alSourcef(_source, AL_REFERENCE_DISTANCE, 0.01f));
-		AL_CHECK(alSourcef(_source, AL_MAX_DISTANCE, range));
+		AL_CHECK(alSourcef(_source, AL_MAX_DISTANCE, _range));
 		AL_CHECK(alSourcef(_source, AL_PITCH, 1.0f));
+		AL_CHECK(alSourcef(_source, AL_GAIN, _volume));
+		AL_CHECK(alSourcefv(_source, AL_POSITION, to_float_ptr(_position)));
 
-		// Generates AL buffers
-		AL_CHECK(alGenBuffers(1, &_buffer));
-		CE_ASSERT(alIsBuffer(_buffer), "alGenBuffers: error");
+		if (_resource->streaming)
+		{
+			AL_CHECK(alGenBuffers(CROWN_SOUND_STREAMING_BUFFERS, _buffers));
+			memcpy(_free, _buffers, sizeof(_buffers));
+			_num_free = CROWN_SOUND_STREAMING_BUFFERS;
+
+			// Looping is handled when requesting chunks. The source starts
+			// playing as soon as the first chunk is queued.
+			AL_CHECK(alSourcei(_source, AL_LOOPING, AL_FALSE));
+			_read_offset   = stream_offset(wrapped_time());
+			_end_of_stream = false;
+			_num_requested = 0;
+			++_seek;
+
+			if (_read_offset == _resource->size)
+			{
+				_read_offset = 0;
+				_end_of_stream = !_loop;
+			}
+		}
+		else
+		{
+			AL_CHECK(alSourcei(_source, AL_LOOPING, (_loop ? AL_TRUE : AL_FALSE)));
+			AL_CHECK(alSourcei(_source, AL_BUFFER, _resource->buffer));
+			AL_CHECK(alSourcef(_source, AL_SEC_OFFSET, wrapped_time()));
+			if (!_paused)
+			{
+				AL_CHECK(alSourcePlay(_source));
+			}
+		}
+	}
+
+	/// Stops playing the instance and returns the source it was using.
+	ALuint virtualize()
+	{
+		CE_ASSERT(_source != 0, "Instance is virtual");
 
-		ALenum fmt = AL_INVALID_ENUM;
-		switch (sr.bits_ps)
+		AL_CHECK(alSourceStop(_source));
+		AL_CHECK(alSourcei(_source, AL_BUFFER, 0));
+		if (_resource->streaming)
 		{
-		case  8: fmt = sr.channels > 1 ? AL_FORMAT_STEREO8  : AL_FORMAT_MONO8; break;
-		case 16: fmt = sr.channels > 1 ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16; break;
-		default: CE_FATAL("Number of bits per sample not supported."); break;
+			AL_CHECK(alDeleteBuffers(CROWN_SOUND_STREAMING_BUFFERS, _buffers));
+			_num_free = 0;
+			_num_requested = 0;
+			++_seek; // Discard the chunks still in flight.
 		}
-		AL_CHECK(alBufferData(_buffer, fmt, data(&sr), sr.size, sr.sample_rate));
 
-		_resource = &sr;
-		set_position(pos);
+		const ALuint source = _source;
+		_source = 0;
+		return source;
 	}
 
-	void destroy()
+	void pause()
 	{
-		stop();
-		AL_CHECK(alSourcei(_source, AL_BUFFER, 0));
-		AL_CHECK(alDeleteBuffers(1, &_buffer));
-		AL_CHECK(alDeleteSources(1, &_source));
+		_paused = true;
+		if (_source != 0)
+		{
+			AL_CHECK(alSourcePause(_source));
+		}
 	}
 
-	void reload(const SoundResource& new_sr)
+	void resume()
+	{
+		_paused = false;
+		if (_source != 0)
+		{
+			AL_CHECK(alSourcePlay(_source));
+		}
+	}
+
+	void stop()
 	{
-		destroy();
-		create(new_sr, position(), range());
+		_stopped = true;
+		if (_source != 0)
+		{
+			AL_CHECK(alSourceStop(_source));
+			AL_CHECK(alSourceRewind(_source)); // Workaround
+		}
+		_end_of_stream = true;
 	}
 
-	void play(bool loop, f32 volume)
+	/// Advances the time of the instance by @a dt seconds.
+	void advance_time(f32 dt)
 	{
-		set_volume(volume);
-		AL_CHECK(alSourcei(_source, AL_LOOPING, (loop ? AL_TRUE : AL_FALSE)));
-		AL_CHECK(alSourceQueueBuffers(_source, 1, &_buffer));
-		AL_CHECK(alSourcePlay(_source));
+		if (!_paused && !_stopped)
+			_time += dt;
 	}
 
-	void pause()
+	/// Returns the duration of the sound in seconds.
+	f32 duration()
 	{
-		AL_CHECK(alSourcePause(_source));
+		return f32(_resource->num_frames) / f32(_resource->sample_rate);
 	}
 
-	void resume()
+	/// Returns the current time wrapped to the duration of the sound.
+	f32 wrapped_time()
 	{
-		AL_CHECK(alSourcePlay(_source));
+		const f32 d = duration();
+		if (_time < d)
+			return _time;
+		return _loop ? d * ffract(_time / d) : d;
 	}
 
-	void stop()
+	/// Returns the offset of the block that contains @a time in the sample data,
+	/// or the size of the data if @a time is past the end of the sound.
+	u32 stream_offset(f32 time)
+	{
+		const SoundResource* sr = _resource;
+		const u32 frame = min(u32(time * sr->sample_rate), sr->num_frames);
+
+		if (sr->sound_type == SoundType::ADPCM)
+		{
+			const u32 fpb = adpcm::frames_per_block(sr->block_size, sr->channels);
+			return min(frame / fpb * sr->block_size, sr->size);
+		}
+
+		return min(frame * sr->block_size, sr->size);
+	}
+
+	/// Computes the gain of the instance as heard from @a listener, following
+	/// the AL_LINEAR_DISTANCE_CLAMPED model.
+	void update_audibility(const Vector3& listener)
+	{
+		const f32 ref = 0.01f;
+		const f32 dist = min(max(distance(_position, listener), ref), _range);
+		_audibility = _range > ref
+			? _volume * (1.0f - (dist - ref) / (_range - ref))
+			: 0.0f
+			;
+	}
+
+	/// Moves the buffers the source has finished playing to the free buffers.
+	void unqueue_processed()
 	{
-		AL_CHECK(alSourceStop(_source));
-		AL_CHECK(alSourceRewind(_source)); // Workaround
 		ALint processed;
 		AL_CHECK(alGetSourcei(_source, AL_BUFFERS_PROCESSED, &processed));
 
 		if (processed > 0)
 		{
-			ALuint removed;
-			AL_CHECK(alSourceUnqueueBuffers(_source, 1, &removed));
+			AL_CHECK(alSourceUnqueueBuffers(_source, processed, &_free[_num_free]));
+			_num_free += processed;
 		}
 	}
 
-	bool is_playing()
+	/// Queues the chunk @a sc to the source and restarts it if it ran out of data.
+	void queue_chunk(const StreamChunk& sc)
 	{
-		ALint state;
-		AL_CHECK(alGetSourcei(_source, AL_SOURCE_STATE, &state));
-		return state == AL_PLAYING;
+		// Chunks requested before the stream restarted are not counted anymore.
+		if (sc.seek != _seek)
+			return;
+
+		CE_ASSERT(_num_requested > 0, "Unexpected chunk");
+		--_num_requested;
+
+		// The stream may have been stopped in the meantime.
+		if (_stopped || _source == 0)
+			return;
+
+		if (sc.data == NULL)
+		{
+			logw(SOUND, "Failed to stream sound");
+			_end_of_stream = true;
+			return;
+		}
+
+		CE_ASSERT(_num_free > 0, "No free buffers");
+		const ALuint buffer = _free[--_num_free];
+		AL_CHECK(alBufferData(buffer, al_format(*_resource), sc.data, sc.size, _resource->sample_rate));
+		AL_CHECK(alSourceQueueBuffers(_source, 1, &buffer));
+
+		if (!_paused && !is_source_playing())
+		{
+			AL_CHECK(alSourcePlay(_source));
+		}
 	}
 
-	bool finished()
+	/// Returns the size of the next chunk to request, or 0 if no chunk is needed.
+	u32 next_chunk_size()
+	{
+		if (_end_of_stream || _num_free <= _num_requested)
+			return 0;
+
+		const u32 chunk_size = CROWN_SOUND_STREAMING_CHUNK_SIZE - CROWN_SOUND_STREAMING_CHUNK_SIZE % _resource->block_size;
+		return min(chunk_size, _resource->size - _read_offset);
+	}
+
+	/// Advances the stream past the chunk of @a size bytes just requested.
+	void advance(u32 size)
+	{
+		++_num_requested;
+		_read_offset += size;
+
+		if (_read_offset == _resource->size)
+		{
+			_read_offset = 0;
+			_end_of_stream = !_loop;
+		}
+	}
+
+	bool is_source_playing()
 	{
 		ALint state;
 		AL_CHECK(alGetSourcei(_source, AL_SOURCE_STATE, &state));
-		return (state != AL_PLAYING && state != AL_PAUSED);
+		return state == AL_PLAYING;
 	}
 
-	Vector3 position()
+	bool is_playing()
 	{
-		ALfloat pos[3];
-		AL_CHECK(alGetSourcefv(_source, AL_POSITION, pos));
-		return vector3(pos[0], pos[1], pos[2]);
+		return !_paused && !finished();
 	}
 
-	float range()
+	bool finished()
 	{
-		ALfloat range;
-		AL_CHECK(alGetSourcefv(_source, AL_MAX_DISTANCE, &range));
-		return range;
+		if (_stopped)
+			return true;
+
+		if (_source == 0)
+			return !_loop && _time >= duration();
+
+		ALint state;
+		AL_CHECK(alGetSourcei(_source, AL_SOURCE_STATE, &state));
+		if (state == AL_PLAYING || state == AL_PAUSED)
+			return false;
+
+		// A streaming sound may have run out of data while waiting for chunks.
+		return !_resource->streaming
+			|| (_end_of_stream && _num_requested == 0)
+			;
 	}
 
 	void set_position(const Vector3& pos)
 	{
-		AL_CHECK(alSourcefv(_source, AL_POSITION, to_float_ptr(pos)));
+		_position = pos;
+		if (_source != 0)
+		{
+			AL_CHECK(alSourcefv(_source, AL_POSITION, to_float_ptr(pos)));
+		}
 	}
 
 	void set_range(f32 range)
 	{
-		AL_CHECK(alSourcef(_source, AL_MAX_DISTANCE, range));
+		_range = range;
+		if (_source != 0)
+		{
+			AL_CHECK(alSourcef(_source, AL_MAX_DISTANCE, range));
+		}
 	}
 
 	void set_volume(f32 volume)
 	{
-		AL_CHECK(alSourcef(_source, AL_GAIN, volume));
+		_volume = volume;
+		if (_source != 0)
+		{
+			AL_CHECK(alSourcef(_source, AL_GAIN, volume));
+		}
 	}
 };
 
@@ -223,12 +469,28 @@ struct SoundWorldImpl
 		u16 next;
 	};
 
+	Allocator* _allocator;
 	u32 _num_objects;
 	SoundInstance _playing_sounds[MAX_OBJECTS];
 	Index _indices[MAX_OBJECTS];
 	u16 _freelist_enqueue;
 	u16 _freelist_dequeue;
 	Matrix4x4 _listener_pose;
+	ListNode _node;
+
+	// Voices
+	ALuint _voices[CROWN_SOUND_MAX_VOICES];
+	ALuint _free_voices[CROWN_SOUND_MAX_VOICES];
+	u32 _num_free_voices;
+
+	// Streaming
+	Queue<StreamChunk> _requests;
+	Queue<StreamChunk> _loaded;
+	Thread _thread;
+	Mutex _mutex;
+	ConditionVariable _requests_condition;
+	Mutex _loaded_mutex;
+	bool _exit;
 
 	bool has(SoundInstanceId id)
 	{
@@ -243,6 +505,7 @@ struct SoundWorldImpl
 
 	SoundInstanceId add()
 	{
+		CE_ASSERT(_num_objects < MAX_OBJECTS, "Maximum number of sound instances reached");
 		Index& in = _indices[_freelist_dequeue];
 		_freelist_dequeue = in.next;
 		in.id += NEW_OBJECT_ID_ADD;
@@ -265,7 +528,11 @@ struct SoundWorldImpl
 		_freelist_enqueue = id & INDEX_MASK;
 	}
 
-	SoundWorldImpl()
+	explicit SoundWorldImpl(Allocator& a)
+		: _allocator(&a)
+		, _requests(a)
+		, _loaded(a)
+		, _exit(false)
 	{
 		_num_objects = 0;
 		for (u32 i = 0; i < MAX_OBJECTS; ++i)
@@ -276,25 +543,130 @@ struct SoundWorldImpl
 		_freelist_dequeue = 0;
 		_freelist_enqueue = MAX_OBJECTS - 1;
 
+		AL_CHECK(alGenSources(CROWN_SOUND_MAX_VOICES, _voices));
+		memcpy(_free_voices, _voices, sizeof(_voices));
+		_num_free_voices = CROWN_SOUND_MAX_VOICES;
+
 		set_listener_pose(MATRIX4X4_IDENTITY);
+
+		list::add(_node, audio_globals::s_worlds);
+
+		_thread.start([](void* thiz) { return ((SoundWorldImpl*)thiz)->run(); }, this);
+	}
+
+	~SoundWorldImpl()
+	{
+		_exit = true;
+		_requests_condition.signal(); // Spurious wake to exit thread
+		_thread.stop();
+
+		while (!queue::empty(_loaded))
+		{
+			_allocator->deallocate(queue::front(_loaded).data);
+			queue::pop_front(_loaded);
+		}
+
+		for (u32 i = 0; i < _num_objects; ++i)
+		{
+			if (_playing_sounds[i]._source != 0)
+				_playing_sounds[i].virtualize();
+		}
+		AL_CHECK(alDeleteSources(CROWN_SOUND_MAX_VOICES, _voices));
+
+		list::remove(_node);
 	}
 
-	SoundInstanceId play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos)
+	SoundInstanceId play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos, u8 priority)
 	{
 		SoundInstanceId id = add();
 		SoundInstance& si = lookup(id);
-		si.create(sr, pos, range);
-		si.play(loop, volume);
+		si.create(sr, loop, volume, range, pos, priority);
+		si.update_audibility(translation(_listener_pose));
+
+		if (si._audibility <= CROWN_SOUND_MIN_AUDIBILITY)
+			return id;
+
+		if (_num_free_voices == 0)
+		{
+			// Steal the voice of the least important instance, if any.
+			SoundInstance* victim = NULL;
+			for (u32 i = 0; i < _num_objects; ++i)
+			{
+				SoundInstance& other = _playing_sounds[i];
+				if (other._source != 0 && (victim == NULL || more_important(*victim, other)))
+					victim = &other;
+			}
+
+			if (victim == NULL || !more_important(si, *victim))
+				return id;
+
+			_free_voices[_num_free_voices++] = victim->virtualize();
+		}
+
+		si.realize(_free_voices[--_num_free_voices]);
+		request_chunks(si);
 		return id;
 	}
 
 	void stop(SoundInstanceId id)
 	{
 		SoundInstance& si = lookup(id);
-		si.destroy();
+		si.stop();
+		if (si._source != 0)
+			_free_voices[_num_free_voices++] = si.virtualize();
 		remove(id);
 	}
 
+	/// Returns whether the instance @a a is more important than @a b.
+	static bool more_important(const SoundInstance& a, const SoundInstance& b)
+	{
+		if (a._priority != b._priority)
+			return a._priority > b._priority;
+		return a._audibility > b._audibility;
+	}
+
+	/// Gives the voices to the most important audible instances and
+	/// virtualizes the others.
+	void update_voices()
+	{
+		const Vector3 listener = translation(_listener_pose);
+
+		TempAllocator4096 ta;
+		Array<SoundInstance*> order(ta);
+		for (u32 i = 0; i < _num_objects; ++i)
+		{
+			SoundInstance& si = _playing_sounds[i];
+			si.update_audibility(listener);
+			if (!si._stopped)
+				array::push_back(order, &si);
+		}
+
+		std::sort(array::begin(order), array::end(order), [](const SoundInstance* a, const SoundInstance* b)
+			{
+				return more_important(*a, *b);
+			});
+
+		// Release the voices first so that they can be given to others.
+		const u32 num_wanted = min(array::size(order), (u32)CROWN_SOUND_MAX_VOICES);
+		for (u32 i = 0; i < array::size(order); ++i)
+		{
+			SoundInstance& si = *order[i];
+			const bool wanted = i < num_wanted && si._audibility > CROWN_SOUND_MIN_AUDIBILITY;
+			if (!wanted && si._source != 0)
+				_free_voices[_num_free_voices++] = si.virtualize();
+		}
+
+		for (u32 i = 0; i < num_wanted; ++i)
+		{
+			SoundInstance& si = *order[i];
+			if (si._source == 0 && si._audibility > CROWN_SOUND_MIN_AUDIBILITY && !si.finished())
+			{
+				CE_ASSERT(_num_free_voices > 0, "No free voices");
+				si.realize(_free_voices[--_num_free_voices]);
+			}
+		}
+	}
+
 	bool is_playing(SoundInstanceId id)
 	{
 		return has(id) && lookup(id).is_playing();
@@ -359,6 +731,18 @@ struct SoundWorldImpl
 		}
 	}
 
+	/// Destroys the instances of the sound @a sr.
+	void stop_sounds(const SoundResource& sr)
+	{
+		for (u32 i = 0; i < _num_objects;)
+		{
+			if (_playing_sounds[i]._resource == &sr)
+				stop(_playing_sounds[i]._id);
+			else
+				++i;
+		}
+	}
+
 	void set_listener_pose(const Matrix4x4& pose)
 	{
 		const Vector3 pos = translation(pose);
@@ -373,8 +757,89 @@ struct SoundWorldImpl
 		_listener_pose = pose;
 	}
 
-	void update()
+	/// Requests the chunks needed to fill the free buffers of @a si.
+	void request_chunks(SoundInstance& si)
 	{
+		if (!si._resource->streaming || si._source == 0)
+			return;
+
+		u32 size = si.next_chunk_size();
+		if (size == 0)
+			return;
+
+		const SoundResource* sr = si._resource;
+
+		ScopedMutex sm(_mutex);
+		for (; size > 0; size = si.next_chunk_size())
+		{
+			StreamChunk sc;
+			sc.id         = si._id;
+			sc.name       = sr->name;
+			sc.offset     = sr->data_offset + si._read_offset;
+			sc.size       = size;
+			sc.num_frames = 0;
+			sc.channels   = sr->channels;
+			sc.block_size = sr->block_size;
+			sc.seek       = si._seek;
+			sc.data       = NULL;
+
+			if (sr->sound_type == SoundType::ADPCM)
+			{
+				const u32 fpb = adpcm::frames_per_block(sr->block_size, sr->channels);
+				const u32 first_frame = si._read_offset / sr->block_size * fpb;
+				sc.num_frames = min(size / sr->block_size * fpb, sr->num_frames - first_frame);
+			}
+
+			queue::push_back(_requests, sc);
+
+			si.advance(size);
+		}
+		_requests_condition.signal();
+	}
+
+	void update(f32 dt)
+	{
+		for (u32 i = 0; i < _num_objects; ++i)
+			_playing_sounds[i].advance_time(dt);
+
+		update_voices();
+
+		// Queue the chunks that have been read
+		{
+			TempAllocator1024 ta;
+			Array<StreamChunk> loaded(ta);
+			{
+				ScopedMutex sm(_loaded_mutex);
+				while (!queue::empty(_loaded))
+				{
+					array::push_back(loaded, queue::front(_loaded));
+					queue::pop_front(_loaded);
+				}
+			}
+
+			for (u32 i = 0; i < array::size(loaded); ++i)
+			{
+				const StreamChunk& sc = loaded[i];
+
+				// The instance may have been destroyed in the meantime.
+				if (has(sc.id))
+					lookup(sc.id).queue_chunk(sc);
+
+				_allocator->deallocate(sc.data);
+			}
+		}
+
+		// Refill the buffers the streaming sounds have finished playing
+		for (u32 i = 0; i < _num_objects; ++i)
+		{
+			SoundInstance& instance = _playing_sounds[i];
+			if (!instance._resource->streaming || instance._stopped || instance._source == 0)
+				continue;
+
+			instance.unqueue_processed();
+			request_chunks(instance);
+		}
+
 		TempAllocator256 alloc;
 		Array<SoundInstanceId> to_delete(alloc);
 
@@ -394,14 +859,103 @@ struct SoundWorldImpl
 			stop(to_delete[i]);
 		}
 	}
+
+	s32 run()
+	{
+		while (1)
+		{
+			_mutex.lock();
+			while (queue::empty(_requests) && !_exit)
+				_requests_condition.wait(_mutex);
+
+			if (_exit)
+				break;
+
+			StreamChunk sc = queue::front(_requests);
+			queue::pop_front(_requests);
+			_mutex.unlock();
+
+			TempAllocator128 ta;
+			DynamicString path(ta);
+			destination_path(path, resource_id(RESOURCE_TYPE_SOUND, sc.name));
+
+			File* file = audio_globals::s_data_filesystem->open(path.c_str(), FileOpenMode::READ);
+			if (file->is_open())
+			{
+				file->seek(sc.offset);
+				sc.data = _allocator->allocate(sc.size);
+				if (file->read(sc.data, sc.size) != sc.size)
+				{
+					_allocator->deallocate(sc.data);
+					sc.data = NULL;
+				}
+			}
+			audio_globals::s_data_filesystem->close(*file);
+
+			// Decode compressed chunks here to keep the main thread free.
+			if (sc.data != NULL && sc.num_frames > 0)
+			{
+				const u32 pcm_size = sc.num_frames * sc.channels * sizeof(s16);
+				s16* pcm = (s16*)_allocator->allocate(pcm_size);
+				adpcm::decode(pcm, (const u8*)sc.data, sc.num_frames, sc.channels, sc.block_size);
+				_allocator->deallocate(sc.data);
+				sc.data = pcm;
+				sc.size = pcm_size;
+			}
+
+			ScopedMutex sm(_loaded_mutex);
+			queue::push_back(_loaded, sc);
+		}
+
+		_mutex.unlock();
+		return 0;
+	}
 };
 
+namespace audio_globals
+{
+	void sound_online(StringId64 id, ResourceManager& rm)
+	{
+		SoundResource* sr = (SoundResource*)rm.get(RESOURCE_TYPE_SOUND, id);
+		sr->name = id;
+
+		if (sr->streaming)
+			return;
+
+		ALuint buffer;
+		AL_CHECK(alGenBuffers(1, &buffer));
+		CE_ASSERT(alIsBuffer(buffer), "alGenBuffers: error");
+		AL_CHECK(alBufferData(buffer, al_format(*sr), sound_resource::data(sr), sr->size, sr->sample_rate));
+		sr->buffer = buffer;
+	}
+
+	void sound_offline(StringId64 id, ResourceManager& rm)
+	{
+		SoundResource* sr = (SoundResource*)rm.get(RESOURCE_TYPE_SOUND, id);
+
+		ListNode* cur;
+		list_for_each(cur, &s_worlds)
+		{
+			SoundWorldImpl* sw = (SoundWorldImpl*)container_of(cur, SoundWorldImpl, _node);
+			sw->stop_sounds(*sr);
+		}
+
+		if (sr->streaming)
+			return;
+
+		const ALuint buffer = sr->buffer;
+		AL_CHECK(alDeleteBuffers(1, &buffer));
+		sr->buffer = 0;
+	}
+
+} // namespace audio_globals
+
 SoundWorld::SoundWorld(Allocator& a)
 	: _marker(SOUND_WORLD_MARKER)
 	, _allocator(&a)
 	, _impl(NULL)
 {
-	_impl = CE_NEW(*_allocator, SoundWorldImpl)();
+	_impl = CE_NEW(*_allocator, SoundWorldImpl)(*_allocator);
 }
 
 SoundWorld::~SoundWorld()
@@ -410,9 +964,9 @@ SoundWorld::~SoundWorld()
 	_marker = 0;
 }
 
-SoundInstanceId SoundWorld::play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos)
+SoundInstanceId SoundWorld::play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos, u8 priority)
 {
-	return _impl->play(sr, loop, volume, range, pos);
+	return _impl->play(sr, loop, volume, range, pos, priority);
 }
 
 void SoundWorld::stop(SoundInstanceId id)
@@ -465,9 +1019,9 @@ void SoundWorld::set_listener_pose(const Matrix4x4& pose)
 	_impl->set_listener_pose(pose);
 }
 
-void SoundWorld::update()
+void SoundWorld::update(f32 dt)
 {
-	_impl->update();
+	_impl->update(dt);
 }
 
 } // namespace crown
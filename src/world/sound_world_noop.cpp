@@ -16,7 +16,7 @@ namespace crown
 {
 namespace audio_globals
 {
-	void init()
+	void init(Filesystem& /*data_filesystem*/)
 	{
 	}
 
@@ -24,11 +24,19 @@ namespace audio_globals
 	{
 	}
 
+	void sound_online(StringId64 /*id*/, ResourceManager& /*rm*/)
+	{
+	}
+
+	void sound_offline(StringId64 /*id*/, ResourceManager& /*rm*/)
+	{
+	}
+
 } // namespace audio_globals
 
 struct SoundWorldImpl
 {
-	SoundWorldImpl()
+	explicit SoundWorldImpl(Allocator& /*a*/)
 	{
 	}
 
@@ -36,7 +44,7 @@ struct SoundWorldImpl
 	{
 	}
 
-	SoundInstanceId play(const SoundResource& /*sr*/, bool /*loop*/, f32 /*volume*/, f32 /*range*/, const Vector3& /*pos*/)
+	SoundInstanceId play(const SoundResource& /*sr*/, bool /*loop*/, f32 /*volume*/, f32 /*range*/, const Vector3& /*pos*/, u8 /*priority*/)
 	{
 		return 0;
 	}
@@ -82,7 +90,7 @@ struct SoundWorldImpl
 	{
 	}
 
-	void update()
+	void update(f32 /*dt*/)
 	{
 	}
 };
@@ -92,7 +100,7 @@ SoundWorld::SoundWorld(Allocator& a)
 	, _allocator(&a)
 	, _impl(NULL)
 {
-	_impl = CE_NEW(*_allocator, SoundWorldImpl)();
+	_impl = CE_NEW(*_allocator, SoundWorldImpl)(*_allocator);
 }
 
 SoundWorld::~SoundWorld()
@@ -101,9 +109,9 @@ SoundWorld::~SoundWorld()
 	_marker = 0;
 }
 
-SoundInstanceId SoundWorld::play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos)
+SoundInstanceId SoundWorld::play(const SoundResource& sr, bool loop, f32 volume, f32 range, const Vector3& pos, u8 priority)
 {
-	return _impl->play(sr, loop, volume, range, pos);
+	return _impl->play(sr, loop, volume, range, pos, priority);
 }
 
 void SoundWorld::stop(SoundInstanceId id)
@@ -156,9 +164,9 @@ void SoundWorld::set_listener_pose(const Matrix4x4& pose)
 	_impl->set_listener_pose(pose);
 }
 
-void SoundWorld::update()
+void SoundWorld::update(f32 dt)
 {
-	_impl->update();
+	_impl->update(dt);
 }
 
 } // namespace crown
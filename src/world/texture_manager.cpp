@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2012-2020 Daniele Bartolini and individual contributors.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#include "config.h"
+#include "core/containers/array.inl"
+#include "core/containers/hash_map.inl"
+#include "core/containers/queue.inl"
+#include "core/filesystem/file.h"
+#include "core/filesystem/filesystem.h"
+#include "core/filesystem/reader_writer.inl"
+#include "core/memory/temp_allocator.inl"
+#include "core/strings/dynamic_string.inl"
+#include "core/strings/string_id.inl"
+#include "core/thread/scoped_mutex.h"
+#include "resource/material_resource.h"
+#include "resource/resource_id.h"
+#include "resource/resource_manager.h"
+#include "resource/texture_resource.h"
+#include "world/material_manager.h"
+#include "world/texture_manager.h"
+
+namespace crown
+{
+#define STREAM_ID_NONE        u32(0)          // No stream request pending.
+#define STREAM_ID_UNAVAILABLE u32(UINT32_MAX) // Mips can not be streamed.
+
+static void release_mips(void* ptr, void* user_data)
+{
+	((Allocator*)user_data)->deallocate(ptr);
+}
+
+TextureManager::TextureManager(Allocator& a, Filesystem& data_filesystem)
+	: _allocator(&a)
+	, _filesystem(&data_filesystem)
+	, _textures(a)
+	, _budget(CROWN_DEFAULT_TEXTURE_MEMORY_BUDGET)
+	, _memory_used(0)
+	, _memory_reserved(0)
+	, _frame(0)
+	, _stream_id(STREAM_ID_NONE)
+	, _requests(a)
+	, _loaded(a)
+	, _exit(false)
+{
+	_thread.start([](void* thiz) { return ((TextureManager*)thiz)->run(); }, this);
+}
+
+TextureManager::~TextureManager()
+{
+	_exit = true;
+	_requests_condition.signal(); // Spurious wake to exit thread
+	_thread.stop();
+
+	while (!queue::empty(_loaded))
+	{
+		_allocator->deallocate(queue::front(_loaded).data);
+		queue::pop_front(_loaded);
+	}
+}
+
+u32 TextureManager::resident_size(const TextureResource* tr)
+{
+	return texture_resource::mips_size(tr, tr->resident_mip);
+}
+
+u32 TextureManager::evict(u32 bytes)
+{
+	u32 freed = 0;
+
+	while (freed < bytes)
+	{
+		// Find the least recently used texture with streamed mips.
+		TextureResource* lru = NULL;
+
+		auto cur = hash_map::begin(_textures);
+		auto end = hash_map::end(_textures);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(_textures, cur);
+
+			TextureResource* tr = cur->second;
+			if (tr->resident_mip < tr->low_mip
+				&& tr->last_used != _frame
+				&& (lru == NULL || tr->last_used < lru->last_used)
+				)
+				lru = tr;
+		}
+
+		if (lru == NULL)
+			break;
+
+		const u32 old_size = resident_size(lru);
+		bgfx::destroy(lru->handle);
+		lru->handle = texture_resource::create(lru, lru->low_mip, lru->data);
+		lru->resident_mip = lru->low_mip;
+
+		const u32 new_size = resident_size(lru);
+		_memory_used -= old_size - new_size;
+		freed += old_size - new_size;
+	}
+
+	return freed;
+}
+
+void TextureManager::online(StringId64 id, ResourceManager& rm)
+{
+	TextureResource* tr = (TextureResource*)rm.get(RESOURCE_TYPE_TEXTURE, id);
+	tr->handle       = texture_resource::create(tr, tr->low_mip, tr->data);
+	tr->resident_mip = tr->low_mip;
+	tr->stream_id    = STREAM_ID_NONE;
+	tr->last_used    = _frame;
+
+	_memory_used += resident_size(tr);
+	hash_map::set(_textures, id, tr);
+}
+
+void TextureManager::offline(StringId64 id, ResourceManager& rm)
+{
+	TextureResource* tr = (TextureResource*)rm.get(RESOURCE_TYPE_TEXTURE, id);
+	bgfx::destroy(tr->handle);
+
+	// Pending stream requests are discarded once they complete.
+	_memory_used -= resident_size(tr);
+	hash_map::remove(_textures, id);
+}
+
+void TextureManager::set_budget(u32 bytes)
+{
+	_budget = bytes;
+}
+
+u32 TextureManager::memory_used() const
+{
+	return _memory_used;
+}
+
+void TextureManager::update(MaterialManager& mm)
+{
+	++_frame;
+
+	// Complete loaded requests
+	{
+		TempAllocator1024 ta;
+		Array<StreamRequest> loaded(ta);
+		{
+			ScopedMutex sm(_loaded_mutex);
+			while (!queue::empty(_loaded))
+			{
+				array::push_back(loaded, queue::front(_loaded));
+				queue::pop_front(_loaded);
+			}
+		}
+
+		for (u32 i = 0; i < array::size(loaded); ++i)
+		{
+			const StreamRequest& sr = loaded[i];
+			_memory_reserved -= sr.reserved;
+
+			TextureResource* tr = hash_map::get(_textures, sr.id, (TextureResource*)NULL);
+			if (tr == NULL || tr->stream_id != sr.stream_id)
+			{
+				// The texture has been unloaded in the meantime.
+				_allocator->deallocate(sr.data);
+				continue;
+			}
+
+			if (sr.data == NULL || sr.size != texture_resource::mips_size(tr, 0))
+			{
+				_allocator->deallocate(sr.data);
+				tr->stream_id = STREAM_ID_UNAVAILABLE;
+				continue;
+			}
+
+			const u32 old_size = resident_size(tr);
+			bgfx::destroy(tr->handle);
+			tr->handle       = texture_resource::create(tr, 0, sr.data, release_mips, _allocator);
+			tr->resident_mip = 0;
+			tr->stream_id    = STREAM_ID_NONE;
+			_memory_used    += sr.size - old_size;
+		}
+	}
+
+	// Track which textures have been used
+	{
+		auto cur = hash_map::begin(mm._materials);
+		auto end = hash_map::end(mm._materials);
+		for (; cur != end; ++cur)
+		{
+			HASH_MAP_SKIP_HOLE(mm._materials, cur);
+
+			Material* mat = cur->second;
+			if (!mat->_used)
+				continue;
+
+			mat->_used = false;
+			for (u32 i = 0; i < mat->_resource->num_textures; ++i)
+			{
+				const TextureData* td = material_resource::texture_data(mat->_resource, i);
+				TextureResource* tr = hash_map::get(_textures, td->id, (TextureResource*)NULL);
+				if (tr != NULL)
+					tr->last_used = _frame;
+			}
+		}
+	}
+
+	// Stream the larger mips of the textures in use
+	auto cur = hash_map::begin(_textures);
+	auto end = hash_map::end(_textures);
+	for (; cur != end; ++cur)
+	{
+		HASH_MAP_SKIP_HOLE(_textures, cur);
+
+		TextureResource* tr = cur->second;
+		if (tr->last_used != _frame
+			|| tr->resident_mip == 0
+			|| tr->stream_id != STREAM_ID_NONE
+			)
+			continue;
+
+		const u32 needed = texture_resource::mips_size(tr, 0) - resident_size(tr);
+		const u32 total = _memory_used + _memory_reserved + needed;
+		if (total > _budget && evict(total - _budget) < total - _budget)
+			continue;
+
+		if (++_stream_id == STREAM_ID_UNAVAILABLE)
+			_stream_id = STREAM_ID_NONE + 1;
+
+		StreamRequest sr;
+		sr.id        = cur->first;
+		sr.stream_id = _stream_id;
+		sr.reserved  = needed;
+		sr.data      = NULL;
+		sr.size      = 0;
+
+		tr->stream_id     = _stream_id;
+		_memory_reserved += needed;
+
+		ScopedMutex sm(_mutex);
+		queue::push_back(_requests, sr);
+		_requests_condition.signal();
+	}
+}
+
+s32 TextureManager::run()
+{
+	while (1)
+	{
+		_mutex.lock();
+		while (queue::empty(_requests) && !_exit)
+			_requests_condition.wait(_mutex);
+
+		if (_exit)
+			break;
+
+		StreamRequest sr = queue::front(_requests);
+		queue::pop_front(_requests);
+		_mutex.unlock();
+
+		TempAllocator128 ta;
+		DynamicString path(ta);
+		destination_path(path, resource_id(RESOURCE_TYPE_TEXTURE, sr.id));
+
+		File* file = _filesystem->open(path.c_str(), FileOpenMode::READ);
+		if (file->is_open())
+		{
+			BinaryReader br(*file);
+
+			u32 version;
+			u32 format;
+			u32 width;
+			u32 height;
+			u32 num_mips;
+			u32 size;
+			br.read(version);
+			br.read(format);
+			br.read(width);
+			br.read(height);
+			br.read(num_mips);
+			br.read(size);
+
+			TextureMip mips[32];
+			if (version == RESOURCE_HEADER(RESOURCE_VERSION_TEXTURE)
+				&& num_mips > 0
+				&& num_mips <= countof(mips)
+				)
+			{
+				br.read(mips, sizeof(TextureMip)*num_mips);
+
+				// Mips are stored from the smallest to the largest.
+				sr.data = _allocator->allocate(size);
+				sr.size = size;
+				for (u32 i = num_mips; i-- > 0;)
+					br.read((char*)sr.data + size - mips[i].offset - mips[i].size, mips[i].size);
+			}
+		}
+		_filesystem->close(*file);
+
+		ScopedMutex sm(_loaded_mutex);
+		queue::push_back(_loaded, sr);
+	}
+
+	_mutex.unlock();
+	return 0;
+}
+
+} // namespace crown
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2012-2020 Daniele Bartolini and individual contributors.
+ * License: https://github.com/dbartolini/crown/blob/master/LICENSE
+ */
+
+#pragma once
+
+#include "core/containers/types.h"
+#include "core/filesystem/types.h"
+#include "core/memory/types.h"
+#include "core/strings/string_id.h"
+#include "core/thread/condition_variable.h"
+#include "core/thread/mutex.h"
+#include "core/thread/thread.h"
+#include "core/types.h"
+#include "resource/types.h"
+#include "world/types.h"
+
+namespace crown
+{
+/// Manages textures' GPU memory.
+///
+/// Textures are created with their low mips only. Larger mips of the textures
+/// in use are streamed in a background thread while keeping the total GPU
+/// memory below a budget by evicting the larger mips of the least recently
+/// used textures.
+///
+/// @ingroup World
+struct TextureManager
+{
+	struct StreamRequest
+	{
+		StringId64 id;
+		u32 stream_id;
+		u32 reserved; ///< GPU memory reserved for the request.
+		void* data;
+		u32 size;
+	};
+
+	Allocator* _allocator;
+	Filesystem* _filesystem;
+	HashMap<StringId64, TextureResource*> _textures;
+	u32 _budget;
+	u32 _memory_used;
+	u32 _memory_reserved;
+	u32 _frame;
+	u32 _stream_id;
+
+	Queue<StreamRequest> _requests;
+	Queue<StreamRequest> _loaded;
+	Thread _thread;
+	Mutex _mutex;
+	ConditionVariable _requests_condition;
+	Mutex _loaded_mutex;
+	bool _exit;
+
+	/// Do not call explicitly.
+	s32 run();
+
+	/// Returns the GPU memory used by the resident mips of @a tr.
+	u32 resident_size(const TextureResource* tr);
+
+	/// Evicts the larger mips of the least recently used textures until
+	/// @a bytes have been freed. Returns the number of bytes freed.
+	u32 evict(u32 bytes);
+
+	/// Reads mips from @a data_filesystem.
+	TextureManager(Allocator& a, Filesystem& data_filesystem);
+
+	///
+	~TextureManager();
+
+	///
+	void online(StringId64 id, ResourceManager& rm);
+
+	///
+	void offline(StringId64 id, ResourceManager& rm);
+
+	/// Sets the maximum GPU memory in @a bytes used by textures.
+	/// @note
+	/// Textures are always created with their low mips resident.
+	void set_budget(u32 bytes);
+
+	/// Returns the GPU memory in bytes used by textures.
+	u32 memory_used() const;
+
+	/// Streams the larger mips of the textures used by the materials of @a mm
+	/// bound since last update and completes the requests that have been loaded.
+	void update(MaterialManager& mm);
+};
+
+} // namespace crown
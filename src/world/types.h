@@ -26,6 +26,7 @@ struct SceneGraph;
 struct ScriptWorld;
 struct ShaderManager;
 struct SoundWorld;
+struct TextureManager;
 struct UnitManager;
 struct World;
 
@@ -109,7 +110,9 @@ struct ActorFlags
 		LOCK_TRANSLATION_Z = 1 << 2,
 		LOCK_ROTATION_X    = 1 << 3,
 		LOCK_ROTATION_Y    = 1 << 4,
-		LOCK_ROTATION_Z    = 1 << 5
+		LOCK_ROTATION_Z    = 1 << 5,
+		REPORT_COLLISIONS  = 1 << 6, ///< Post touch begin and touch end events.
+		REPORT_CONTACTS    = 1 << 7  ///< Also post one touching event per update.
 	};
 };
 
@@ -202,7 +205,6 @@ struct EventType
 
 		PHYSICS_COLLISION,
 		PHYSICS_TRIGGER,
-		PHYSICS_TRANSFORM,
 
 		COUNT
 	};
@@ -393,11 +395,27 @@ struct BoxShape
 
 struct HeightfieldShape
 {
-	u32 width;
-	u32 length;
-	f32 height_scale;
-	f32 height_min;
-	f32 height_max;
+	u32 width;         ///< Number of samples along the X axis.
+	u32 length;        ///< Number of samples along the Z axis.
+	f32 height_scale;  ///< Height of one quantization step.
+	f32 height_min;    ///< Lowest representable height in collider-space.
+	f32 height_max;    ///< Highest representable height in collider-space.
+	Vector2 cell_size; ///< Distance between two samples along the X and Z axes.
+};
+
+/// Quantized BVH of a mesh collider. Unlike Bullet's in-place serialized
+/// BVH, its layout does not depend on the pointer size of the platform.
+struct MeshBvh
+{
+	Vector3 aabb_min;
+	Vector3 aabb_max;
+	Vector3 quantization;
+	u32 num_nodes;
+	u32 num_subtrees;
+	u32 cur_node_index;
+	u32 traversal_mode;
+//	btQuantizedBvhNodeData nodes[num_nodes]
+//	btBvhSubtreeInfoData subtrees[num_subtrees]
 };
 
 struct ColliderDesc
@@ -448,6 +466,37 @@ struct RaycastHit
 	ActorInstance actor; ///< The actor that was hit.
 };
 
+struct RaycastQuery
+{
+	Vector3 from; ///< In world-space.
+	Vector3 dir;  ///< In world-space.
+	f32 len;      ///< Length of the ray.
+};
+
+struct SweepQuery
+{
+	u32 type;             ///< ColliderType::Enum, either SPHERE or BOX.
+	Vector3 from;         ///< In world-space.
+	Vector3 half_extents; ///< Box half extents or sphere radius in x.
+	Vector3 dir;          ///< In world-space.
+	f32 len;              ///< Length of the sweep.
+};
+
+struct OverlapHit
+{
+	UnitId unit;         ///< The unit that overlaps.
+	ActorInstance actor; ///< The actor that overlaps.
+};
+
+struct OverlapQuery
+{
+	u32 type;             ///< ColliderType::Enum, either SPHERE or BOX.
+	Vector3 center;       ///< In world-space.
+	Quaternion rotation;  ///< In world-space. Ignored by spheres.
+	Vector3 half_extents; ///< Box half extents or sphere radius in x.
+	bool exact;           ///< Whether to test the actual shapes instead of their bounds only.
+};
+
 struct UnitSpawnedEvent
 {
 	UnitId unit; ///< The unit spawned.
@@ -466,7 +515,7 @@ struct PhysicsCollisionEvent
 {
 	enum Type { TOUCH_BEGIN, TOUCHING, TOUCH_END } type;
 	UnitId units[2];
-	ActorInstance actors[2];
+	ActorInstance actors[2]; ///< Invalid in TOUCH_END events if the actor has been destroyed.
 	Vector3 position;        ///< In world-space.
 	Vector3 normal;          ///< In world-space.
 	float distance;          ///< Separation distance
@@ -474,15 +523,11 @@ struct PhysicsCollisionEvent
 
 struct PhysicsTriggerEvent
 {
-	enum Type { TOUCH_BEGIN, TOUCHING, TOUCH_END } type;
-	ActorInstance trigger;
-	ActorInstance other;
-};
-
-struct PhysicsTransformEvent
-{
-	UnitId unit_id;
-	Matrix4x4 world;
+	enum Type { TRIGGER_ENTER, TRIGGER_LEAVE } type;
+	UnitId trigger_unit;
+	UnitId other_unit;
+	ActorInstance trigger;   ///< The trigger.
+	ActorInstance other;     ///< The actor that entered or left the trigger. Invalid if it has been destroyed.
 };
 
 } // namespace crown
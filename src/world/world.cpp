@@ -12,6 +12,7 @@
 #include "core/memory/temp_allocator.inl"
 #include "core/strings/string_id.inl"
 #include "lua/lua_environment.h"
+#include "resource/resource_id.h"
 #include "resource/resource_manager.h"
 #include "resource/unit_resource.h"
 #include "world/animation_state_machine.h"
@@ -54,7 +55,7 @@ World::World(Allocator& a, ResourceManager& rm, ShaderManager& sm, MaterialManag
 	_lines = create_debug_line(true);
 	_scene_graph   = CE_NEW(*_allocator, SceneGraph)(*_allocator, um);
 	_render_world  = CE_NEW(*_allocator, RenderWorld)(*_allocator, rm, sm, mm, um);
-	_physics_world = CE_NEW(*_allocator, PhysicsWorld)(*_allocator, rm, um, *_lines);
+	_physics_world = CE_NEW(*_allocator, PhysicsWorld)(*_allocator, rm, um, *_scene_graph, *_lines);
 	_sound_world   = CE_NEW(*_allocator, SoundWorld)(*_allocator);
 	_script_world  = CE_NEW(*_allocator, ScriptWorld)(*_allocator, um, rm, env, *this);
 	_animation_state_machine = CE_NEW(*_allocator, AnimationStateMachine)(*_allocator, rm, um);
@@ -99,7 +100,7 @@ UnitId World::spawn_unit(StringId64 name, const Vector3& pos, const Quaternion&
 {
 	const UnitResource* ur = (const UnitResource*)_resource_manager->get(RESOURCE_TYPE_UNIT, name);
 	UnitId id = _unit_manager->create();
-	spawn_units(*this, *ur, pos, rot, scl, &id);
+	spawn_units(*this, *ur, pos, rot, scl, &id, resource_id(RESOURCE_TYPE_UNIT, name));
 	return id;
 }
 
@@ -215,15 +216,6 @@ void World::update_scene(f32 dt)
 
 			switch (eh->type)
 			{
-			case EventType::PHYSICS_TRANSFORM:
-				{
-					const PhysicsTransformEvent& ptev = *(PhysicsTransformEvent*)data;
-					const TransformInstance ti = _scene_graph->instances(ptev.unit_id);
-					if (is_valid(ti)) // User code may have destroyed the actor
-						_scene_graph->set_world_pose_and_rescale(ti, ptev.world);
-				}
-				break;
-
 			case EventType::PHYSICS_COLLISION:
 				{
 					const PhysicsCollisionEvent& pcev = *(PhysicsCollisionEvent*)data;
@@ -232,6 +224,10 @@ void World::update_scene(f32 dt)
 				break;
 
 			case EventType::PHYSICS_TRIGGER:
+				{
+					const PhysicsTriggerEvent& ptev = *(PhysicsTriggerEvent*)data;
+					script_world::trigger(*_script_world, ptev);
+				}
 				break;
 
 			default:
@@ -242,6 +238,8 @@ void World::update_scene(f32 dt)
 		array::clear(events);
 	}
 
+	script_world::dispatch_events(*_script_world);
+
 	array::clear(changed_units);
 	array::clear(changed_world);
 	_scene_graph->get_changed(changed_units, changed_world);
@@ -252,7 +250,7 @@ void World::update_scene(f32 dt)
 		, array::begin(changed_world)
 		);
 
-	_sound_world->update();
+	_sound_world->update(dt);
 
 	_gui_buffer.reset();
 
@@ -482,15 +480,15 @@ Vector3 World::camera_world_to_screen(UnitId unit, const Vector3& pos)
 	return screen;
 }
 
-SoundInstanceId World::play_sound(const SoundResource& sr, const bool loop, const f32 volume, const Vector3& pos, const f32 range)
+SoundInstanceId World::play_sound(const SoundResource& sr, const bool loop, const f32 volume, const Vector3& pos, const f32 range, const u8 priority)
 {
-	return _sound_world->play(sr, loop, volume, range, pos);
+	return _sound_world->play(sr, loop, volume, range, pos, priority);
 }
 
-SoundInstanceId World::play_sound(StringId64 name, const bool loop, const f32 volume, const Vector3& pos, const f32 range)
+SoundInstanceId World::play_sound(StringId64 name, const bool loop, const f32 volume, const Vector3& pos, const f32 range, const u8 priority)
 {
 	const SoundResource* sr = (const SoundResource*)_resource_manager->get(RESOURCE_TYPE_SOUND, name);
-	return play_sound(*sr, loop, volume, pos, range);
+	return play_sound(*sr, loop, volume, pos, range, priority);
 }
 
 void World::stop_sound(SoundInstanceId id)
@@ -554,7 +552,7 @@ Level* World::load_level(StringId64 name, const Vector3& pos, const Quaternion&
 {
 	const LevelResource* lr = (const LevelResource*)_resource_manager->get(RESOURCE_TYPE_LEVEL, name);
 
-	Level* level = CE_NEW(*_allocator, Level)(*_allocator, *_unit_manager, *this, *lr);
+	Level* level = CE_NEW(*_allocator, Level)(*_allocator, *_unit_manager, *this, name, *lr);
 	level->load(pos, rot);
 
 	list::add(level->_node, _levels);
@@ -583,7 +581,7 @@ void World::post_level_loaded_event()
 	event_stream::write(_events, EventType::LEVEL_LOADED, ev);
 }
 
-void spawn_units(World& w, const UnitResource& ur, const Vector3& pos, const Quaternion& rot, const Vector3& scl, const UnitId* unit_lookup)
+void spawn_units(World& w, const UnitResource& ur, const Vector3& pos, const Quaternion& rot, const Vector3& scl, const UnitId* unit_lookup, StringId64 resource)
 {
 	SceneGraph* scene_graph = w._scene_graph;
 	RenderWorld* render_world = w._render_world;
@@ -627,7 +625,7 @@ void spawn_units(World& w, const UnitResource& ur, const Vector3& pos, const Qua
 			{
 				Matrix4x4 tm = scene_graph->world_pose(unit_lookup[unit_index[i]]);
 				Vector3 scl = scale(tm);
-				physics_world->collider_create(unit_lookup[unit_index[i]], cd, scl);
+				physics_world->collider_create(unit_lookup[unit_index[i]], cd, scl, resource, i);
 				cd = (ColliderDesc*)((char*)(cd + 1) + cd->size);
 			}
 		}
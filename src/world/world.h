@@ -165,11 +165,12 @@ struct World
 	/// Renders the world using @a view.
 	void render(const Matrix4x4& view);
 
-	SoundInstanceId play_sound(const SoundResource& sr, bool loop = false, f32 volume = 1.0f, const Vector3& position = VECTOR3_ZERO, f32 range = 50.0f);
+	SoundInstanceId play_sound(const SoundResource& sr, bool loop = false, f32 volume = 1.0f, const Vector3& position = VECTOR3_ZERO, f32 range = 50.0f, u8 priority = 128);
 
 	/// Plays the sound with the given @a name at the given @a position, with the given
 	/// @a volume and @a range. @a loop controls whether the sound must loop or not.
-	SoundInstanceId play_sound(StringId64 name, const bool loop, const f32 volume, const Vector3& pos, const f32 range);
+	/// Sounds with higher @a priority keep their voice when too many are audible.
+	SoundInstanceId play_sound(StringId64 name, const bool loop, const f32 volume, const Vector3& pos, const f32 range, const u8 priority = 128);
 
 	/// Stops the sound with the given @a id.
 	void stop_sound(SoundInstanceId id);
@@ -211,6 +212,6 @@ struct World
 	void post_level_loaded_event();
 };
 
-void spawn_units(World& w, const UnitResource& ur, const Vector3& pos, const Quaternion& rot, const Vector3& scl, const UnitId* unit_lookup);
+void spawn_units(World& w, const UnitResource& ur, const Vector3& pos, const Quaternion& rot, const Vector3& scl, const UnitId* unit_lookup, StringId64 resource);
 
 } // namespace crown